@@ -0,0 +1,661 @@
+/* Chain stores - catalog
+ *
+ * Desc:
+ *   Implementation of the catalog. See catalog.hh.
+ *   While loading, the lines are only interned and collected in the order
+ * of the file. freeze() then sorts them once by chain, store and product
+ * (keeping the last line of each) and builds all the vectors from the
+ * sorted lines. Input files written by an exporter often come sorted by
+ * chain, store and product already: load() checks the order line by line
+ * and freeze() skips the sort if no line was out of order. The lines of
+ * a store share its chain and store names, so those are compared with
+ * the previous line before the dictionary is asked.
+ *   With load_lazy the chains not read yet are only names: freeze() puts
+ * them among the chains without stores. Reading a chain makes lines of
+ * the frozen offers again, adds the lines of the chain and freezes all
+ * of them once more; as few chains are read one by one, this costs less
+ * than keeping every vector open for insertions.
+ *
+ * Program author
+ * Name: Ruowen Liu
+ * Student number: -
+ * UserID: -
+ * E-Mail: ruowen.liu@tuni.fi
+ * */
+
+#include "catalog.hh"
+#include "sharded.hh"
+#include "compressed.hh"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <numeric>
+
+namespace {
+
+const std::uint32_t NOT_A_PRODUCT = UINT32_MAX;
+
+//the order of prices in the indexes: cheapest first, out of stock last
+bool price_before(double a, double b){
+    if((a == -1.0) != (b == -1.0)){return b == -1.0;}
+    return a < b;
+}
+
+/* Move an element whose key has just changed to its place in a range
+ * that was sorted before the change; the elements between the old and
+ * the new place shift by one */
+template <typename Iterator, typename Less>
+void move_to_place(Iterator first, Iterator last, Iterator element,
+                   Less less){
+    if(element + 1 != last and less(*(element + 1), *element)){
+        Iterator place = std::lower_bound(element + 1, last, *element, less);
+        std::rotate(element, element + 1, place);
+    }
+    else if(element != first and less(*element, *(element - 1))){
+        Iterator place = std::upper_bound(first, element, *element, less);
+        std::rotate(place, element, element + 1);
+    }
+}
+
+//- - - - - - searching the name vectors (sorted by rank) - - - - - -
+template <typename Iterator>
+bool find_name(Iterator first, Iterator last, NameId id,
+               const std::vector<std::uint32_t>& rank, Iterator& found){
+    //a name interned (e.g. by another catalog) after the ranks were made
+    if(id >= rank.size()){
+        found = last;
+        return false;
+    }
+    found = std::lower_bound(first, last, id,
+                             [&rank](NameId a, NameId b){
+        return rank[a] < rank[b];
+    });
+    return found != last and *found == id;
+}
+
+} // namespace
+
+bool parse_price(std::string_view text, double& price){
+    //sign for identifing the out-of-stock status
+    if(text == "out-of-stock"){
+        price = -1.0;
+        return true;
+    }
+    //like stod, the rest of the field after the number is not looked at
+    return read_number(text, price) != 0;
+}
+
+//- - - - - - Dictionary - - - - - -
+NameId Dictionary::intern(std::string_view name){
+    auto found = ids_.find(name);
+    if(found != ids_.end()){return found->second;}
+    NameId id = 0;
+    if(not free_.empty()){
+        id = free_.back();
+        free_.pop_back();
+        texts_[id] = std::string(name);
+        names_[id] = texts_[id];
+    }
+    else{
+        id = static_cast<NameId>(names_.size());
+        texts_.emplace_back(name);
+        names_.push_back(texts_.back());
+        holds_.push_back(0);
+    }
+    ids_.emplace(names_[id], id);
+    return id;
+}
+
+bool Dictionary::find(std::string_view name, NameId& id) const {
+    auto found = ids_.find(name);
+    if(found == ids_.end()){return false;}
+    id = found->second;
+    return true;
+}
+
+void Dictionary::clear(){
+    ids_.clear();
+    names_.clear();
+    texts_.clear();
+    holds_.clear();
+    free_.clear();
+}
+
+void Dictionary::collect(){
+    if(std::all_of(holds_.begin(), holds_.end(),
+                   [](std::uint32_t holds){ return holds == 0; })){
+        clear();
+        return;
+    }
+    free_.clear();
+    //from the end, thus the lowest ids are given first
+    for(NameId id = static_cast<NameId>(names_.size()); id-- > 0;){
+        if(holds_[id] != 0){continue;}
+        //not collected already
+        auto found = ids_.find(names_[id]);
+        if(found != ids_.end() and found->second == id){ids_.erase(found);}
+        std::string().swap(texts_[id]);
+        names_[id] = {};
+        free_.push_back(id);
+    }
+}
+
+//- - - - - - CatalogShare - - - - - -
+std::shared_ptr<Assortment> CatalogShare::assortment(
+        std::vector<Offer>&& offers){
+    std::size_t hash = offers.size();
+    for(auto& offer:offers){
+        std::uint64_t priceBits = 0;
+        std::memcpy(&priceBits, &offer.price, sizeof(priceBits));
+        hash = (hash * 0x9E3779B97F4A7C15ull + offer.product)
+                * 0x9E3779B97F4A7C15ull + priceBits;
+    }
+    auto [first, last] = assortments_.equal_range(hash);
+    for(auto known = first; known != last;){
+        std::shared_ptr<Assortment> shared = known->second.lock();
+        //the catalogs using it have been loaded again or destroyed
+        if(not shared){
+            known = assortments_.erase(known);
+            continue;
+        }
+        bool equal = std::equal(shared->offers.begin(), shared->offers.end(),
+                                offers.begin(), offers.end(),
+                                [](const Offer& a, const Offer& b){
+            return a.product == b.product and a.price == b.price;
+        });
+        if(equal){return shared;}
+        ++known;
+    }
+    auto made = std::make_shared<Assortment>();
+    made->offers = std::move(offers);
+    //by price, out of stock last; equal prices stay in the order of names
+    made->priced = made->offers;
+    std::stable_sort(made->priced.begin(), made->priced.end(),
+                     [](const Offer& a, const Offer& b){
+        return price_before(a.price, b.price);
+    });
+    assortments_.emplace(hash, made);
+    return made;
+}
+
+//- - - - - - Catalog: loading - - - - - -
+Catalog::Catalog(std::shared_ptr<CatalogShare> share)
+    : share_(std::move(share)){
+    clear();
+}
+
+LoadStatus Catalog::load(const std::string& path){
+    clear();
+    Dictionary& names = share_->names;
+    std::vector<Row> rows;
+    bool sorted = true;
+    auto collect = [this, &names, &rows, &sorted](
+            const std::vector<RowFields>& lines){
+        for(auto& line:lines){
+            double price = -1.0;
+            if(not parse_price(line.price, price)){return false;}
+            if(rows.empty()){
+                rows.push_back({names.intern(line.chain),
+                                names.intern(line.store),
+                                names.intern(line.product), price});
+                continue;
+            }
+            const Row& previous = rows.back();
+            NameId chain = line.chain == names.name(previous.chain)
+                    ? previous.chain : names.intern(line.chain);
+            NameId store = chain == previous.chain
+                    and line.store == names.name(previous.store)
+                    ? previous.store : names.intern(line.store);
+            Row row = {chain, store, names.intern(line.product), price};
+            sorted = sorted and not before(row, previous);
+            rows.push_back(row);
+        }
+        return true;
+    };
+    LoadStatus status = load_input(path, collect);
+    if(status != LoadStatus::SUCCESS){
+        clear();
+        return status;
+    }
+    freeze(rows, sorted);
+    return LoadStatus::SUCCESS;
+}
+
+void Catalog::assign(const ShardedStore& store){
+    clear();
+    Dictionary& names = share_->names;
+    std::vector<Row> rows;
+    for(std::size_t shard = 0; shard < store.shard_count(); ++shard){
+        store.read_shard(shard, [&names, &rows](std::string_view chain,
+                                                std::string_view storeName,
+                                                std::string_view product,
+                                                double price){
+            rows.push_back({names.intern(chain), names.intern(storeName),
+                            names.intern(product), price});
+        });
+    }
+    freeze(rows, false);
+}
+
+LoadStatus Catalog::load_lazy(const std::string& path){
+    clear();
+    if(std::filesystem::is_directory(path) or is_compressed_feed(path)){
+        return load(path);
+    }
+    ChainIndex index;
+    std::string indexPath = chain_index_path(path);
+    if(not read_chain_index(indexPath, index) or not is_current(index, path)){
+        LoadStatus status = build_chain_index(path, index);
+        if(status != LoadStatus::SUCCESS){return status;}
+        //without the sidecar, the next start sweeps the file again
+        write_chain_index(indexPath, index);
+    }
+    for(auto& chain:index.chains){
+        share_->names.intern(chain.first);
+    }
+    lazyPath_ = path;
+    unread_ = std::move(index);
+    std::vector<Row> rows;
+    freeze(rows, true);
+    return LoadStatus::SUCCESS;
+}
+
+LoadStatus Catalog::load_chain(std::string_view chainName){
+    auto found = unread_.chains.find(chainName);
+    if(found == unread_.chains.end()){return LoadStatus::SUCCESS;}
+    ChainIndex wanted;
+    wanted.fileSize = unread_.fileSize;
+    wanted.fileTime = unread_.fileTime;
+    wanted.chains.insert(unread_.chains.extract(found));
+    return read_chains(wanted, false);
+}
+
+LoadStatus Catalog::load_all_chains(){
+    if(unread_.chains.empty()){return LoadStatus::SUCCESS;}
+    ChainIndex wanted;
+    std::swap(wanted, unread_);
+    //many chains: their ranges would cover most of the file anyway
+    return read_chains(wanted, true);
+}
+
+LoadStatus Catalog::read_chains(const ChainIndex& wanted, bool wholeFile){
+    Dictionary& names = share_->names;
+    if(not is_current(wanted, lazyPath_)){
+        clear();
+        return LoadStatus::FILE_CHANGED;
+    }
+    std::vector<Row> rows = frozen_rows();
+    auto collect = [&names, &rows, &wanted](
+            std::uint64_t, const char*, std::size_t,
+            const std::vector<RowFields>& lines){
+        for(auto& line:lines){
+            //a range can hold lines of other chains too
+            if(wanted.chains.find(line.chain) == wanted.chains.end()){
+                continue;
+            }
+            double price = -1.0;
+            if(not parse_price(line.price, price)){return false;}
+            rows.push_back({names.intern(line.chain),
+                            names.intern(line.store),
+                            names.intern(line.product), price});
+        }
+        return true;
+    };
+    std::vector<ByteRange> ranges;
+    if(wholeFile){ranges.push_back({0, UINT64_MAX});}
+    else{
+        for(auto& chain:wanted.chains){
+            ranges.insert(ranges.end(), chain.second.begin(),
+                          chain.second.end());
+        }
+    }
+    for(auto& range:ranges){
+        LoadStatus status = load_file_blocks(lazyPath_, range.begin,
+                                             range.end, collect);
+        if(status != LoadStatus::SUCCESS){
+            clear();
+            return status;
+        }
+    }
+    clear_frozen();
+    freeze(rows, false);
+    return LoadStatus::SUCCESS;
+}
+
+std::vector<Catalog::Row> Catalog::frozen_rows() const {
+    std::vector<Row> rows;
+    rows.reserve(columns_.price.size());
+    for(std::size_t row = 0; row < columns_.price.size(); ++row){
+        rows.push_back({chainNames_[columns_.chain[row]],
+                        storeNames_[columns_.store[row]],
+                        productNames_[columns_.product[row]],
+                        columns_.price[row]});
+    }
+    return rows;
+}
+
+Catalog::~Catalog(){
+    clear();
+}
+
+void Catalog::clear(){
+    lazyPath_.clear();
+    unread_ = ChainIndex();
+    clear_frozen();
+    //a dictionary shared with other catalogs keeps the names they hold
+    share_->names.collect();
+}
+
+void Catalog::clear_frozen(){
+    hold_names(false);
+    rank_.clear();
+    chainNames_.clear();
+    chainStoreBegin_.assign(1, 0);
+    storeNames_.clear();
+    storeChains_.clear();
+    storeOfferBegin_.assign(1, 0);
+    assortments_.clear();
+    productNames_.clear();
+    productOfferBegin_.assign(1, 0);
+    storeOffers_.clear();
+    columns_ = OfferColumns();
+}
+
+bool Catalog::before(const Row& a, const Row& b) const {
+    const Dictionary& names = share_->names;
+    if(a.chain != b.chain){return names.name(a.chain) < names.name(b.chain);}
+    if(a.store != b.store){return names.name(a.store) < names.name(b.store);}
+    return a.product != b.product
+            and names.name(a.product) < names.name(b.product);
+}
+
+void Catalog::freeze(std::vector<Row>& rows, bool sorted){
+    const Dictionary& names = share_->names;
+    //byRank[r] - the name with rank r
+    std::vector<NameId> byRank(names.size());
+    std::iota(byRank.begin(), byRank.end(), 0);
+    std::sort(byRank.begin(), byRank.end(), [&names](NameId a, NameId b){
+        return names.name(a) < names.name(b);
+    });
+    rank_.assign(names.size(), 0);
+    for(std::uint32_t r = 0; r < byRank.size(); ++r){
+        rank_[byRank[r]] = r;
+    }
+
+    /* Sort the lines by the ranks instead of the names; stable, thus
+     * the last line of a chain, store and product stays the last one */
+    for(auto& row:rows){
+        row = {rank_[row.chain], rank_[row.store], rank_[row.product],
+               row.price};
+    }
+    if(not sorted){
+        std::stable_sort(rows.begin(), rows.end(),
+                         [](const Row& a, const Row& b){
+            if(a.chain != b.chain){return a.chain < b.chain;}
+            if(a.store != b.store){return a.store < b.store;}
+            return a.product < b.product;
+        });
+    }
+
+    //chains, stores and offers in one walk over the sorted lines; the
+    //chains not read yet are put in their places without stores
+    auto start_chain = [this](NameId chain){
+        if(not chainNames_.empty()){
+            chainStoreBegin_.push_back(
+                        static_cast<std::uint32_t>(storeNames_.size()));
+        }
+        chainNames_.push_back(chain);
+    };
+    auto unread = unread_.chains.begin();
+    auto start_unread_chains = [this, &names, &unread, &start_chain](
+            std::string_view before, bool toTheEnd){
+        for(; unread != unread_.chains.end()
+            and (toTheEnd or unread->first < before); ++unread){
+            NameId chain = 0;
+            names.find(unread->first, chain);
+            start_chain(chain);
+        }
+    };
+    std::vector<bool> isProduct(names.size(), false);
+    std::vector<Offer> offers;
+    for(std::size_t i = 0; i < rows.size(); ++i){
+        const Row& row = rows[i];
+        //a later line of the same product rewrites this one
+        if(i + 1 < rows.size() and rows[i + 1].chain == row.chain
+                and rows[i + 1].store == row.store
+                and rows[i + 1].product == row.product){
+            continue;
+        }
+        bool newChain = chainNames_.empty()
+                or rank_[chainNames_.back()] != row.chain;
+        if(newChain){
+            start_unread_chains(names.name(byRank[row.chain]), false);
+            start_chain(byRank[row.chain]);
+        }
+        if(newChain or rank_[storeNames_.back()] != row.store){
+            if(not storeNames_.empty()){
+                storeOfferBegin_.push_back(
+                            static_cast<std::uint32_t>(offers.size()));
+            }
+            storeNames_.push_back(byRank[row.store]);
+            storeChains_.push_back(
+                        static_cast<ChainId>(chainNames_.size() - 1));
+        }
+        offers.push_back({byRank[row.product], row.price});
+        isProduct[byRank[row.product]] = true;
+    }
+    start_unread_chains({}, true);
+    chainStoreBegin_.push_back(static_cast<std::uint32_t>(storeNames_.size()));
+    storeOfferBegin_.push_back(static_cast<std::uint32_t>(offers.size()));
+    std::vector<Row>().swap(rows);
+
+    //the assortment of every store, shared with the equal ones
+    assortments_.reserve(storeNames_.size());
+    for(std::size_t store = 0; store < storeNames_.size(); ++store){
+        assortments_.push_back(share_->assortment(std::vector<Offer>(
+                offers.begin() + storeOfferBegin_[store],
+                offers.begin() + storeOfferBegin_[store + 1])));
+    }
+
+    //products, and the stores of every product (counting sort)
+    std::vector<std::uint32_t> productOf(names.size(), NOT_A_PRODUCT);
+    for(NameId id:byRank){
+        if(isProduct[id]){
+            productOf[id] = static_cast<std::uint32_t>(productNames_.size());
+            productNames_.push_back(id);
+        }
+    }
+    productOfferBegin_.assign(productNames_.size() + 1, 0);
+    for(auto& offer:offers){
+        ++productOfferBegin_[productOf[offer.product] + 1];
+    }
+    std::partial_sum(productOfferBegin_.begin(), productOfferBegin_.end(),
+                     productOfferBegin_.begin());
+    storeOffers_.resize(offers.size());
+    std::vector<std::uint32_t> filled(productOfferBegin_.begin(),
+                                      productOfferBegin_.end() - 1);
+    //the columns are filled in the same walk
+    columns_.chain.reserve(offers.size());
+    columns_.store.reserve(offers.size());
+    columns_.product.reserve(offers.size());
+    columns_.price.reserve(offers.size());
+    for(std::size_t chain = 0; chain < chainNames_.size(); ++chain){
+        for(std::uint32_t store = chainStoreBegin_[chain];
+            store < chainStoreBegin_[chain + 1]; ++store){
+            for(std::uint32_t i = storeOfferBegin_[store];
+                i < storeOfferBegin_[store + 1]; ++i){
+                std::uint32_t product = productOf[offers[i].product];
+                storeOffers_[filled[product]++] = {chainNames_[chain],
+                                                   storeNames_[store],
+                                                   offers[i].price};
+                columns_.chain.push_back(static_cast<ChainId>(chain));
+                columns_.store.push_back(store);
+                columns_.product.push_back(product);
+                columns_.price.push_back(offers[i].price);
+            }
+        }
+    }
+    //cheapest first, out of stock last; the stores stay in their order
+    for(std::size_t product = 0; product < productNames_.size(); ++product){
+        std::stable_sort(storeOffers_.begin() + productOfferBegin_[product],
+                         storeOffers_.begin() + productOfferBegin_[product + 1],
+                         [](const StoreOffer& a, const StoreOffer& b){
+            return price_before(a.price, b.price);
+        });
+    }
+    hold_names(true);
+}
+
+void Catalog::hold_names(bool hold){
+    Dictionary& names = share_->names;
+    for(const std::vector<NameId>* used:{&chainNames_, &storeNames_,
+                                         &productNames_}){
+        for(NameId id:*used){
+            if(hold){names.hold(id);}
+            else{names.release(id);}
+        }
+    }
+}
+
+//- - - - - - Catalog: queries - - - - - -
+Span<NameId> Catalog::chains() const {
+    return {chainNames_.data(), chainNames_.data() + chainNames_.size()};
+}
+
+bool Catalog::find_chain(std::string_view chainName, ChainId& chain) const {
+    NameId id = 0;
+    if(not share_->names.find(chainName, id)){return false;}
+    std::vector<NameId>::const_iterator found;
+    if(not find_name(chainNames_.begin(), chainNames_.end(), id, rank_,
+                     found)){
+        return false;
+    }
+    chain = static_cast<ChainId>(found - chainNames_.begin());
+    return true;
+}
+
+Span<NameId> Catalog::stores(ChainId chain) const {
+    return {storeNames_.data() + chainStoreBegin_[chain],
+            storeNames_.data() + chainStoreBegin_[chain + 1]};
+}
+
+bool Catalog::find_store(ChainId chain, std::string_view storeName,
+                         StoreId& store) const {
+    NameId id = 0;
+    if(not share_->names.find(storeName, id)){return false;}
+    auto first = storeNames_.begin() + chainStoreBegin_[chain];
+    auto last = storeNames_.begin() + chainStoreBegin_[chain + 1];
+    std::vector<NameId>::const_iterator found;
+    if(not find_name(first, last, id, rank_, found)){return false;}
+    store = static_cast<StoreId>(found - storeNames_.begin());
+    return true;
+}
+
+Span<Offer> Catalog::selection(StoreId store) const {
+    const std::vector<Offer>& offers = assortments_[store]->offers;
+    return {offers.data(), offers.data() + offers.size()};
+}
+
+Span<Offer> Catalog::price_range(StoreId store, double lowest,
+                                 double highest) const {
+    const std::vector<Offer>& priced = assortments_[store]->priced;
+    const Offer* first = priced.data();
+    const Offer* last = priced.data() + priced.size();
+    //only the in-stock prefix: a limit of -1.0 is a price, not out of stock
+    last = std::partition_point(first, last, [](const Offer& offer){
+        return offer.price != -1.0;
+    });
+    first = std::lower_bound(first, last, lowest,
+                             [](const Offer& offer, double price){
+        return offer.price < price;
+    });
+    last = std::upper_bound(first, last, highest,
+                            [](double price, const Offer& offer){
+        return price < offer.price;
+    });
+    return {first, last};
+}
+
+Span<NameId> Catalog::products() const {
+    return {productNames_.data(),
+            productNames_.data() + productNames_.size()};
+}
+
+bool Catalog::find_product(std::string_view productName,
+                           ProductId& product) const {
+    NameId id = 0;
+    if(not share_->names.find(productName, id)){return false;}
+    std::vector<NameId>::const_iterator found;
+    if(not find_name(productNames_.begin(), productNames_.end(), id, rank_,
+                     found)){
+        return false;
+    }
+    product = static_cast<ProductId>(found - productNames_.begin());
+    return true;
+}
+
+CheapestOffers Catalog::cheapest(ProductId product) const {
+    const StoreOffer* first = storeOffers_.data() + productOfferBegin_[product];
+    const StoreOffer* last = storeOffers_.data()
+            + productOfferBegin_[product + 1];
+    //sorted by price, out of stock last
+    if(first == last or first->price == -1.0){return {-1.0, {}};}
+    double lowest = first->price;
+    const StoreOffer* tiedEnd = std::find_if(first, last,
+                                             [lowest](const StoreOffer& offer){
+        return offer.price != lowest;
+    });
+    return {lowest, {first, tiedEnd}};
+}
+
+//- - - - - - Catalog: updates - - - - - -
+bool Catalog::update_price(StoreId store, ProductId product, double price,
+                           double& oldPrice){
+    NameId productName = productNames_[product];
+    auto byName = [this](const Offer& a, const Offer& b){
+        return rank_[a.product] < rank_[b.product];
+    };
+    const std::vector<Offer>& offers = assortments_[store]->offers;
+    auto found = std::lower_bound(offers.begin(), offers.end(),
+                                  Offer{productName, 0.0}, byName);
+    if(found == offers.end() or found->product != productName){return false;}
+    oldPrice = found->price;
+    if(oldPrice == price){return true;}
+    std::size_t place = static_cast<std::size_t>(found - offers.begin());
+    //copy on write: other stores, maybe of other catalogs, keep the old one
+    std::shared_ptr<Assortment>& assortment = assortments_[store];
+    if(assortment.use_count() > 1){
+        assortment = std::make_shared<Assortment>(*assortment);
+    }
+    assortment->offers[place].price = price;
+    //the rows of the store in the columns are in the order of its offers
+    columns_.price[storeOfferBegin_[store] + place] = price;
+
+    //the price index of the store: by price, then by name
+    auto byPrice = [this](const Offer& a, const Offer& b){
+        if(a.price != b.price){return price_before(a.price, b.price);}
+        return rank_[a.product] < rank_[b.product];
+    };
+    auto pricedFirst = assortment->priced.begin();
+    auto pricedLast = assortment->priced.end();
+    auto priced = std::lower_bound(pricedFirst, pricedLast,
+                                   Offer{productName, oldPrice}, byPrice);
+    priced->price = price;
+    move_to_place(pricedFirst, pricedLast, priced, byPrice);
+
+    //the stores of the product: by price, then by chain and store
+    auto byStore = [this](const StoreOffer& a, const StoreOffer& b){
+        if(a.price != b.price){return price_before(a.price, b.price);}
+        if(a.chain != b.chain){return rank_[a.chain] < rank_[b.chain];}
+        return rank_[a.store] < rank_[b.store];
+    };
+    auto storesFirst = storeOffers_.begin() + productOfferBegin_[product];
+    auto storesLast = storeOffers_.begin() + productOfferBegin_[product + 1];
+    StoreOffer old = {chainNames_[storeChains_[store]], storeNames_[store],
+                      oldPrice};
+    auto storeOffer = std::lower_bound(storesFirst, storesLast, old, byStore);
+    storeOffer->price = price;
+    move_to_place(storesFirst, storesLast, storeOffer, byStore);
+    return true;
+}
@@ -0,0 +1,324 @@
+/* Chain stores - catalog
+ *
+ * Desc:
+ *   The data of the input file in a form that can be queried in-process,
+ * without printing anything. This is the library part of the program
+ * (see catalog.pri); main.cpp is only a command line front end for it.
+ *   Every chain, store and product name is stored once, in a dictionary,
+ * and the catalog refers to it with a NameId. Several catalogs can share
+ * the dictionary (see CatalogShare); each one holds the names it uses,
+ * and the names no catalog holds any more are dropped when a catalog is
+ * loaded again or destroyed. After loading, the catalog is frozen
+ * into sorted vectors:
+ *   chains         - by name; each one has a range of stores
+ *   stores         - by chain, then by name; each one has an assortment
+ *                    (shared by the stores with equal offers)
+ *   offers         - the products of a store, by name (selection)
+ *   priced offers  - the products of a store, by price (out of stock
+ *                    last) and then by name (range, under)
+ *   products       - by name; each one has a range of store offers
+ *   store offers   - the stores selling a product, by price (out of stock
+ *                    last) and then by chain and store (cheapest)
+ * The ranges are kept as vectors of begin positions: the range of
+ * element i is [begin[i], begin[i + 1]).
+ *   For scans over all offers, the offers are also kept as columns
+ * (OfferColumns).
+ * The queries return Spans pointing into these vectors. They stay valid
+ * until the catalog is loaded again (or a chain is read, see load_lazy);
+ * update_price changes the prices in them, and the order of the priced
+ * offers and store offers.
+ *   A price of -1.0 means out of stock, as in the input file handling.
+ *
+ * Program author
+ * Name: Ruowen Liu
+ * Student number: -
+ * UserID: -
+ * E-Mail: ruowen.liu@tuni.fi
+ * */
+
+#ifndef CATALOG_HH
+#define CATALOG_HH
+
+#include "loader.hh"
+#include "chainindex.hh"
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+class ShardedStore;
+
+using NameId = std::uint32_t;
+//position of a chain, store or product in the frozen vectors
+using ChainId = std::uint32_t;
+using StoreId = std::uint32_t;
+using ProductId = std::uint32_t;
+
+/**
+ * @brief The Span class - a read-only view of consecutive elements
+ */
+template <typename T>
+class Span {
+public:
+    Span() = default;
+    Span(const T* first, const T* last) : first_(first), last_(last) {}
+
+    const T* begin() const { return first_; }
+    const T* end() const { return last_; }
+    std::size_t size() const { return static_cast<std::size_t>(last_ - first_); }
+    bool empty() const { return first_ == last_; }
+    const T& operator[](std::size_t i) const { return first_[i]; }
+
+private:
+    const T* first_ = nullptr;
+    const T* last_ = nullptr;
+};
+
+/**
+ * @brief The Dictionary class - every name stored once;
+ *        ids are given in the order the names are first seen, and the
+ *        ids of collected names are given again
+ */
+class Dictionary {
+public:
+    NameId intern(std::string_view name);
+    //false if the name has never been interned (or has been collected)
+    bool find(std::string_view name, NameId& id) const;
+    std::string_view name(NameId id) const { return names_[id]; }
+    //the number of ids given, collected ones included
+    std::size_t size() const { return names_.size(); }
+    void clear();
+
+    //a catalog holds the names it uses, once for every use
+    void hold(NameId id) { ++holds_[id]; }
+    void release(NameId id) { --holds_[id]; }
+    //forget the names no catalog holds, e.g. those of a catalog loaded
+    //again; their ids are given to the next new names
+    void collect();
+
+private:
+    //a deque never moves its elements, thus the views stay valid
+    std::deque<std::string> texts_;
+    std::vector<std::string_view> names_;
+    std::unordered_map<std::string_view, NameId> ids_;
+    std::vector<std::uint32_t> holds_;
+    std::vector<NameId> free_;
+};
+
+//a product of a store
+struct Offer {
+    NameId product;
+    double price;
+};
+
+//a store selling a product
+struct StoreOffer {
+    NameId chain;
+    NameId store;
+    double price;
+};
+
+//the offers of a store, by name and by price (out of stock last, equal
+//prices by name); equal ones are shared, see CatalogShare
+struct Assortment {
+    std::vector<Offer> offers;
+    std::vector<Offer> priced;
+};
+
+/**
+ * @brief The CatalogShare class - what the catalogs loaded in one process
+ *        (e.g. one per region) can share: one dictionary for the names of
+ *        all of them, and the assortments equal in several stores. A
+ *        store whose price changes gets a copy of its assortment first
+ *        if the assortment is shared (copy on write).
+ */
+class CatalogShare {
+public:
+    Dictionary names;
+
+    /**
+     * @brief assortment - the assortment of the given offers: one in use
+     *        with the same offers and prices, or else a new one
+     * @param offers     - the offers of a store, by name
+     */
+    std::shared_ptr<Assortment> assortment(std::vector<Offer>&& offers);
+
+private:
+    //by a hash of the offers; the ones no longer used are removed when met
+    std::unordered_multimap<std::size_t, std::weak_ptr<Assortment>>
+            assortments_;
+};
+
+/* All the offers of the catalog as columns, in the order of chains,
+ * stores and products; row i of every column is the same offer. The
+ * strings are dictionary encoded: a chain, store or product is its
+ * position in the frozen vectors (see query.hh). */
+struct OfferColumns {
+    std::vector<ChainId> chain;
+    std::vector<StoreId> store;
+    std::vector<ProductId> product;
+    std::vector<double> price;
+};
+
+/**
+ * @brief parse_price - read a price field of the input
+ * @param text        - e.g. "2.50", or "out-of-stock"
+ * @param price       - the price, -1.0 for out of stock
+ * @return false if the text is not a price
+ */
+bool parse_price(std::string_view text, double& price);
+
+//the answer of cheapest: the lowest price (-1.0 if out of stock
+//everywhere) and the stores selling the product at that price
+struct CheapestOffers {
+    double price;
+    Span<StoreOffer> stores;
+};
+
+class Catalog {
+public:
+    //share: what to share with other catalogs; a new one if not given
+    explicit Catalog(std::shared_ptr<CatalogShare> share
+                     = std::make_shared<CatalogShare>());
+    //the names held in the dictionary are released
+    ~Catalog();
+    Catalog(const Catalog&) = delete;
+    Catalog& operator=(const Catalog&) = delete;
+
+    /**
+     * @brief load - read an input file (or a directory of them, or a
+     *        .gz/.zst file, see load_input in loader.hh) into the catalog;
+     *        a later line of the same chain, store and product rewrites
+     *        the price
+     * @param path - the input name
+     * @return SUCCESS, or the first problem found; the catalog is empty
+     *         after a failure
+     */
+    LoadStatus load(const std::string& path);
+    /**
+     * @brief assign - make the catalog of the offers in a sharded store
+     *        (see sharded.hh), which can be written at the same time
+     * @param store  - the store; each shard is read as it is at the moment
+     */
+    void assign(const ShardedStore& store);
+    /**
+     * @brief load_lazy - like load, but only find out where the lines of
+     *        every chain are (see chainindex.hh, the sidecar is used and
+     *        written if possible); the lines of a chain are read when
+     *        load_chain or load_all_chains first needs them. Until then the
+     *        chain has no stores, and the products of its lines are not in
+     *        the catalog. Directories and .gz/.zst files are loaded at once.
+     * @param path      - the input name
+     * @return SUCCESS, or the first problem found
+     */
+    LoadStatus load_lazy(const std::string& path);
+    /**
+     * @brief load_chain - read the lines of a chain, if not read yet; the
+     *        ids and Spans given before are not valid after that
+     * @param chainName  - the chain; nothing is done for an unknown name
+     * @return SUCCESS, or the first problem found; the catalog is empty
+     *         after a failure
+     */
+    LoadStatus load_chain(std::string_view chainName);
+    //read the lines of all the chains not read yet (see load_chain)
+    LoadStatus load_all_chains();
+
+    std::string_view name(NameId id) const { return share_->names.name(id); }
+
+    //- - chains and stores - -
+    //the chain names, in alphabetical order
+    Span<NameId> chains() const;
+    bool find_chain(std::string_view chainName, ChainId& chain) const;
+    //the store names of a chain, in alphabetical order
+    Span<NameId> stores(ChainId chain) const;
+    bool find_store(ChainId chain, std::string_view storeName,
+                    StoreId& store) const;
+    //the products of a store, in alphabetical order
+    Span<Offer> selection(StoreId store) const;
+    //the in-stock products of a store priced in [lowest, highest],
+    //cheapest first (equal prices in alphabetical order)
+    Span<Offer> price_range(StoreId store, double lowest,
+                            double highest) const;
+
+    //- - products - -
+    //the product names, in alphabetical order
+    Span<NameId> products() const;
+    bool find_product(std::string_view productName,
+                      ProductId& product) const;
+    CheapestOffers cheapest(ProductId product) const;
+
+    //- - columns, and names of the positions used in them - -
+    const OfferColumns& columns() const { return columns_; }
+    NameId chain_name(ChainId chain) const { return chainNames_[chain]; }
+    NameId store_name(StoreId store) const { return storeNames_[store]; }
+    NameId product_name(ProductId product) const {
+        return productNames_[product];
+    }
+    ChainId store_chain(StoreId store) const { return storeChains_[store]; }
+    std::size_t store_count() const { return storeNames_.size(); }
+
+    //- - updates - -
+    /**
+     * @brief update_price - change the price of a product in a store; the
+     *        offer moves to its new place in the price indexes, nothing
+     *        else is rebuilt
+     * @param store        - the store
+     * @param product      - the product
+     * @param price        - the new price, -1.0 for out of stock
+     * @param oldPrice     - the price before the update
+     * @return false if the store doesn't have the product (new offers
+     *         need the catalog to be loaded again)
+     */
+    bool update_price(StoreId store, ProductId product, double price,
+                      double& oldPrice);
+
+private:
+    //one line of the input file, in the order of the file
+    struct Row {
+        NameId chain;
+        NameId store;
+        NameId product;
+        double price;
+    };
+
+    void clear();
+    //empty the frozen vectors only; their names are released, not
+    //collected
+    void clear_frozen();
+    //hold or release the names of the frozen vectors in the dictionary
+    void hold_names(bool hold);
+    //true if line a comes before line b by chain, store and product
+    bool before(const Row& a, const Row& b) const;
+    //sorted: the lines are in the order of before() already
+    void freeze(std::vector<Row>& rows, bool sorted);
+    //the offers in the frozen vectors as lines, to be frozen again
+    std::vector<Row> frozen_rows() const;
+    //read the lines of the given chains from the file of load_lazy
+    LoadStatus read_chains(const ChainIndex& wanted, bool wholeFile);
+
+    std::shared_ptr<CatalogShare> share_;
+    //with load_lazy: the input file, and the chains not read yet
+    std::string lazyPath_;
+    ChainIndex unread_;
+    //rank_[id] - place of the name in the alphabetical order of all names
+    std::vector<std::uint32_t> rank_;
+
+    std::vector<NameId> chainNames_;
+    std::vector<std::uint32_t> chainStoreBegin_;
+    std::vector<NameId> storeNames_;
+    std::vector<ChainId> storeChains_;
+    //the rows of every store in the columns
+    std::vector<std::uint32_t> storeOfferBegin_;
+    std::vector<std::shared_ptr<Assortment>> assortments_;
+    std::vector<NameId> productNames_;
+    std::vector<std::uint32_t> productOfferBegin_;
+    std::vector<StoreOffer> storeOffers_;
+    OfferColumns columns_;
+};
+
+#endif // CATALOG_HH
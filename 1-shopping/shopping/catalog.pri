@@ -0,0 +1,43 @@
+# The catalog library: loading the input and the queries, no printing.
+# Included by shopping.pro (the command line front end) and by
+# shoppingcatalog.pro (a static library for programs embedding the
+# catalog).
+
+CONFIG += c++17
+CONFIG += thread
+
+INCLUDEPATH += $$PWD
+
+SOURCES += \
+        $$PWD/catalog.cpp \
+        $$PWD/scanner.cpp \
+        $$PWD/loader.cpp \
+        $$PWD/compressed.cpp \
+        $$PWD/query.cpp \
+        $$PWD/export.cpp \
+        $$PWD/watch.cpp \
+        $$PWD/sharded.cpp \
+        $$PWD/chainindex.cpp
+
+HEADERS += \
+        $$PWD/catalog.hh \
+        $$PWD/scanner.hh \
+        $$PWD/loader.hh \
+        $$PWD/compressed.hh \
+        $$PWD/query.hh \
+        $$PWD/export.hh \
+        $$PWD/watch.hh \
+        $$PWD/sharded.hh \
+        $$PWD/chainindex.hh
+
+# Compressed input feeds: .gz needs zlib, .zst needs libzstd.
+# Without them the loader reports such files as unopenable.
+CONFIG += link_pkgconfig
+packagesExist(zlib) {
+    DEFINES += HAVE_ZLIB
+    PKGCONFIG += zlib
+}
+packagesExist(libzstd) {
+    DEFINES += HAVE_ZSTD
+    PKGCONFIG += libzstd
+}
@@ -0,0 +1,140 @@
+/* Chain stores - chain index
+ *
+ * Desc:
+ *   Implementation of the chain index. See chainindex.hh.
+ *   The sidecar is a text file:
+ *     # shopping chain index 2
+ *     <file size> <time of change>
+ *     <chain>;<begin>-<end>;<begin>-<end>...
+ *   with one line per chain. A chain name has no ';' in it, as in the
+ * input file.
+ *
+ * Program author
+ * Name: Ruowen Liu
+ * Student number: -
+ * UserID: -
+ * E-Mail: ruowen.liu@tuni.fi
+ * */
+
+#include "chainindex.hh"
+#include "catalog.hh"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <system_error>
+
+namespace {
+
+//2: the prices are checked too; older sidecars are made again
+const char* const HEADER = "# shopping chain index 2";
+const char* const SUFFIX = ".chainidx";
+//reading this much of other chains is cheaper than another seek
+const std::uint64_t MERGE_GAP = std::uint64_t(256) << 10;
+
+//the size and the time of change of a file; false if there is no file
+bool file_identity(const std::string& path, std::uint64_t& size,
+                   std::int64_t& time){
+    std::error_code error;
+    size = std::filesystem::file_size(path, error);
+    if(error){return false;}
+    auto changed = std::filesystem::last_write_time(path, error);
+    if(error){return false;}
+    time = static_cast<std::int64_t>(changed.time_since_epoch().count());
+    return true;
+}
+
+} // namespace
+
+LoadStatus build_chain_index(const std::string& path, ChainIndex& index){
+    index = ChainIndex();
+    if(not file_identity(path, index.fileSize, index.fileTime)){
+        return LoadStatus::CANNOT_OPEN;
+    }
+    auto record = [&index](std::uint64_t offset, const char* block,
+                           std::size_t size,
+                           const std::vector<RowFields>& rows){
+        //the ranges of the chain of the lines being passed, and its name
+        std::vector<ByteRange>* ranges = nullptr;
+        std::string_view chain;
+        for(auto& row:rows){
+            //a bad price must not wait for the chain to be read
+            double price = -1.0;
+            if(not parse_price(row.price, price)){return false;}
+            if(ranges != nullptr and row.chain == chain){continue;}
+            std::uint64_t lineBegin = offset
+                    + static_cast<std::uint64_t>(row.chain.data() - block);
+            if(ranges != nullptr){ranges->back().end = lineBegin;}
+            chain = row.chain;
+            auto found = index.chains.find(chain);
+            if(found == index.chains.end()){
+                found = index.chains.emplace(std::string(chain),
+                                             std::vector<ByteRange>()).first;
+            }
+            ranges = &found->second;
+            if(ranges->empty() or ranges->back().end + MERGE_GAP < lineBegin){
+                ranges->push_back({lineBegin, lineBegin});
+            }
+        }
+        if(ranges != nullptr){ranges->back().end = offset + size;}
+        return true;
+    };
+    return load_file_blocks(path, 0, UINT64_MAX, record);
+}
+
+bool is_current(const ChainIndex& index, const std::string& path){
+    std::uint64_t size = 0;
+    std::int64_t time = 0;
+    return file_identity(path, size, time) and size == index.fileSize
+            and time == index.fileTime;
+}
+
+std::string chain_index_path(const std::string& path){
+    return path + SUFFIX;
+}
+
+bool is_chain_index_path(const std::string& path){
+    std::size_t length = std::strlen(SUFFIX);
+    return path.size() >= length
+            and path.compare(path.size() - length, length, SUFFIX) == 0;
+}
+
+bool read_chain_index(const std::string& indexPath, ChainIndex& index){
+    index = ChainIndex();
+    std::ifstream file(indexPath);
+    std::string line;
+    if(not std::getline(file, line) or line != HEADER){return false;}
+    if(not (file >> index.fileSize >> index.fileTime)){return false;}
+    std::getline(file, line);
+    while(std::getline(file, line)){
+        std::stringstream fields(line);
+        std::string chain;
+        std::getline(fields, chain, ';');
+        std::vector<ByteRange>& ranges = index.chains[chain];
+        ByteRange range = {0, 0};
+        char dash = ' ';
+        while(fields >> range.begin >> dash >> range.end){
+            if(dash != '-' or range.end < range.begin){return false;}
+            ranges.push_back(range);
+            //the ';' between the ranges
+            fields.ignore(1);
+        }
+        if(chain.empty() or ranges.empty()){return false;}
+    }
+    return true;
+}
+
+bool write_chain_index(const std::string& indexPath, const ChainIndex& index){
+    std::ofstream file(indexPath);
+    file << HEADER << '\n' << index.fileSize << ' ' << index.fileTime << '\n';
+    for(auto& [chain, ranges]:index.chains){
+        file << chain;
+        for(auto& range:ranges){
+            file << ';' << range.begin << '-' << range.end;
+        }
+        file << '\n';
+    }
+    file.close();
+    return not file.fail();
+}
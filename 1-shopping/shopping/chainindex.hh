@@ -0,0 +1,79 @@
+/* Chain stores - chain index
+ *
+ * Desc:
+ *   Where the lines of every chain are in a plain input file, so that
+ * the catalog can read the lines of one chain only (see
+ * Catalog::load_lazy). The index is made with one sweep of the scanner
+ * over the file, which also checks every line and its price, but nothing
+ * is interned or sorted. The lines of a chain are kept as byte ranges; two ranges
+ * less than MERGE_GAP bytes apart are merged, thus a range can also hold
+ * lines of other chains, which the reader has to skip.
+ *   The index can be saved next to the input file (a sidecar, e.g.
+ * products.csv.chainidx). The sidecar tells the size and the time of
+ * change of the input file it was made of; it is not used for a file
+ * that has changed since.
+ *
+ * Program author
+ * Name: Ruowen Liu
+ * Student number: -
+ * UserID: -
+ * E-Mail: ruowen.liu@tuni.fi
+ * */
+
+#ifndef CHAININDEX_HH
+#define CHAININDEX_HH
+
+#include "loader.hh"
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+//the bytes [begin, end) of the input file; whole lines
+struct ByteRange {
+    std::uint64_t begin;
+    std::uint64_t end;
+};
+
+struct ChainIndex {
+    //the input file the index was made of, as it was then
+    std::uint64_t fileSize = 0;
+    std::int64_t fileTime = 0;
+    //the ranges of every chain, in the order of the file
+    std::map<std::string, std::vector<ByteRange>, std::less<>> chains;
+};
+
+/**
+ * @brief build_chain_index - sweep through a plain input file and
+ *        record the ranges of every chain
+ * @param path              - the input file
+ * @param index             - the result
+ * @return SUCCESS, or the first problem found (the same as load_file)
+ */
+LoadStatus build_chain_index(const std::string& path, ChainIndex& index);
+
+/**
+ * @brief is_current - tell if the input file is still the one the
+ *        index was made of (same size and time of change)
+ */
+bool is_current(const ChainIndex& index, const std::string& path);
+
+//the name of the sidecar of an input file
+std::string chain_index_path(const std::string& path);
+//true for the name of a sidecar (load_directory skips them)
+bool is_chain_index_path(const std::string& path);
+
+/**
+ * @brief read_chain_index - read a sidecar
+ * @param indexPath        - the sidecar
+ * @param index            - the result
+ * @return false if the sidecar can't be read or is not a chain index
+ */
+bool read_chain_index(const std::string& indexPath, ChainIndex& index);
+
+//false if the sidecar can't be written
+bool write_chain_index(const std::string& indexPath, const ChainIndex& index);
+
+#endif // CHAININDEX_HH
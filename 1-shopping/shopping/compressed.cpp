@@ -0,0 +1,304 @@
+/* Chain stores - compressed feed loader
+ *
+ * Desc:
+ *   Implementation of the decompress-parse-consume pipeline.
+ *   See compressed.hh.
+ *   The ring has a fixed amount of slots which are used in turn, thus
+ * buffer number k is always in slot k % RING_SLOTS and the consumer only
+ * has to wait for the next slot to become parsed to keep the order.
+ *
+ * Program author
+ * Name: Ruowen Liu
+ * Student number: -
+ * UserID: -
+ * E-Mail: ruowen.liu@tuni.fi
+ * */
+
+#include "compressed.hh"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+namespace {
+
+const std::size_t RING_SLOTS = 8;
+const std::size_t SLOT_SIZE = std::size_t(1) << 20;
+
+enum class SlotState {
+    FREE,
+    FILLED,
+    PARSED
+};
+
+struct Slot {
+    std::vector<char> data;
+    std::size_t size = 0;
+    std::vector<RowFields> rows;
+    bool valid = true;
+    SlotState state = SlotState::FREE;
+};
+
+struct Pipeline {
+    std::vector<Slot> slots{RING_SLOTS};
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::deque<Slot*> toParse;
+    //amount of buffers the decompressor has filled in total
+    std::size_t filledCount = 0;
+    bool decompressionDone = false;
+    bool corrupt = false;
+    bool cancelled = false;
+};
+
+/* The source of decompressed bytes: read up to size bytes,
+ * return the amount read, 0 at the end, -1 on a corrupt stream. */
+class Decompressor {
+public:
+    virtual ~Decompressor() = default;
+    virtual long read(char* buffer, std::size_t size) = 0;
+};
+
+#ifdef HAVE_ZLIB
+class GzipDecompressor : public Decompressor {
+public:
+    explicit GzipDecompressor(gzFile file) : file_(file) {
+        gzbuffer(file_, 256 * 1024);
+    }
+    ~GzipDecompressor() override {
+        gzclose(file_);
+    }
+    long read(char* buffer, std::size_t size) override {
+        //gzread takes an unsigned int amount
+        unsigned part = static_cast<unsigned>(
+                    std::min<std::size_t>(size, 1u << 30));
+        int got = gzread(file_, buffer, part);
+        //a truncated stream also ends with 0, but leaves an error behind
+        int error = Z_OK;
+        if(got == 0){gzerror(file_, &error);}
+        return (got < 0 or error != Z_OK) ? -1 : got;
+    }
+private:
+    gzFile file_;
+};
+#endif
+
+#ifdef HAVE_ZSTD
+class ZstdDecompressor : public Decompressor {
+public:
+    explicit ZstdDecompressor(std::FILE* file)
+        : file_(file), stream_(ZSTD_createDStream()),
+          input_(ZSTD_DStreamInSize()) {
+        ZSTD_initDStream(stream_);
+    }
+    ~ZstdDecompressor() override {
+        ZSTD_freeDStream(stream_);
+        std::fclose(file_);
+    }
+    long read(char* buffer, std::size_t size) override {
+        ZSTD_outBuffer out = {buffer, size, 0};
+        while(out.pos == 0){
+            if(inBuffer_.pos == inBuffer_.size){
+                std::size_t got = std::fread(input_.data(), 1,
+                                             input_.size(), file_);
+                if(got == 0){
+                    //the stream must not stop in the middle of a frame
+                    return lastResult_ == 0 ? 0 : -1;
+                }
+                inBuffer_ = {input_.data(), got, 0};
+            }
+            lastResult_ = ZSTD_decompressStream(stream_, &out, &inBuffer_);
+            if(ZSTD_isError(lastResult_)){return -1;}
+        }
+        return static_cast<long>(out.pos);
+    }
+private:
+    std::FILE* file_;
+    ZSTD_DStream* stream_;
+    std::vector<char> input_;
+    ZSTD_inBuffer inBuffer_ = {nullptr, 0, 0};
+    std::size_t lastResult_ = 0;
+};
+#endif
+
+bool ends_with(const std::string& text, const std::string& end){
+    return text.size() >= end.size()
+            and text.compare(text.size() - end.size(), end.size(), end) == 0;
+}
+
+//nullptr when the file can't be opened or the format isn't supported
+std::unique_ptr<Decompressor> open_decompressor(const std::string& path){
+#ifdef HAVE_ZLIB
+    if(ends_with(path, ".gz")){
+        gzFile file = gzopen(path.c_str(), "rb");
+        if(file){return std::make_unique<GzipDecompressor>(file);}
+    }
+#endif
+#ifdef HAVE_ZSTD
+    if(ends_with(path, ".zst")){
+        std::FILE* file = std::fopen(path.c_str(), "rb");
+        if(file){return std::make_unique<ZstdDecompressor>(file);}
+    }
+#endif
+    (void)path;
+    return nullptr;
+}
+
+//- - - - - - the decompressing thread - - - - - -
+void decompress(Pipeline& pipeline, Decompressor& source){
+    //the unfinished last line of the previous buffer
+    std::vector<char> carry;
+    bool atEnd = false;
+    while(not atEnd){
+        Slot& slot = pipeline.slots[pipeline.filledCount % RING_SLOTS];
+        {
+            std::unique_lock<std::mutex> lock(pipeline.mutex);
+            pipeline.changed.wait(lock, [&pipeline, &slot]{
+                return pipeline.cancelled or slot.state == SlotState::FREE;
+            });
+            if(pipeline.cancelled){return;}
+        }
+        if(slot.data.size() < SLOT_SIZE){slot.data.resize(SLOT_SIZE);}
+        std::copy(carry.begin(), carry.end(), slot.data.begin());
+        std::size_t filled = carry.size();
+        carry.clear();
+
+        //fill the slot; grow it if one line doesn't fit
+        std::size_t usable = 0;
+        while(true){
+            while(filled < slot.data.size()){
+                long got = source.read(slot.data.data() + filled,
+                                       slot.data.size() - filled);
+                if(got < 0){
+                    std::lock_guard<std::mutex> lock(pipeline.mutex);
+                    pipeline.corrupt = true;
+                    pipeline.decompressionDone = true;
+                    pipeline.changed.notify_all();
+                    return;
+                }
+                if(got == 0){
+                    atEnd = true;
+                    break;
+                }
+                filled += static_cast<std::size_t>(got);
+            }
+            if(atEnd){
+                usable = filled;
+                break;
+            }
+            auto filledEnd = slot.data.rend()
+                    - static_cast<std::ptrdiff_t>(filled);
+            auto lastBreak = std::find(filledEnd, slot.data.rend(), '\n');
+            if(lastBreak != slot.data.rend()){
+                usable = static_cast<std::size_t>(slot.data.rend()
+                                                  - lastBreak);
+                break;
+            }
+            slot.data.resize(slot.data.size() * 2);
+        }
+        carry.assign(slot.data.begin() + static_cast<std::ptrdiff_t>(usable),
+                     slot.data.begin() + static_cast<std::ptrdiff_t>(filled));
+        slot.size = usable;
+
+        std::lock_guard<std::mutex> lock(pipeline.mutex);
+        slot.state = SlotState::FILLED;
+        pipeline.toParse.push_back(&slot);
+        ++pipeline.filledCount;
+        if(atEnd){pipeline.decompressionDone = true;}
+        pipeline.changed.notify_all();
+    }
+}
+
+//- - - - - - parser threads - - - - - -
+void parse_slots(Pipeline& pipeline){
+    StructuralIndex index;
+    while(true){
+        Slot* slot = nullptr;
+        {
+            std::unique_lock<std::mutex> lock(pipeline.mutex);
+            pipeline.changed.wait(lock, [&pipeline]{
+                return pipeline.cancelled or not pipeline.toParse.empty()
+                        or pipeline.decompressionDone;
+            });
+            if(pipeline.cancelled or pipeline.toParse.empty()){return;}
+            slot = pipeline.toParse.front();
+            pipeline.toParse.pop_front();
+        }
+        slot->rows.clear();
+        slot->valid = scan_rows(slot->data.data(), slot->size,
+                                index, slot->rows);
+        std::lock_guard<std::mutex> lock(pipeline.mutex);
+        slot->state = SlotState::PARSED;
+        pipeline.changed.notify_all();
+    }
+}
+
+} // namespace
+
+bool is_compressed_feed(const std::string& path){
+    return ends_with(path, ".gz") or ends_with(path, ".zst");
+}
+
+LoadStatus load_compressed(const std::string& path,
+                           const RowConsumer& consume){
+    std::unique_ptr<Decompressor> source = open_decompressor(path);
+    if(not source){return LoadStatus::CANNOT_OPEN;}
+
+    Pipeline pipeline;
+    std::thread decompressor(decompress, std::ref(pipeline),
+                             std::ref(*source));
+    unsigned parserAmount = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<std::thread> parsers;
+    for(unsigned i = 0; i < parserAmount; ++i){
+        parsers.emplace_back(parse_slots, std::ref(pipeline));
+    }
+
+    LoadStatus status = LoadStatus::SUCCESS;
+    for(std::size_t consumed = 0; ; ++consumed){
+        Slot& slot = pipeline.slots[consumed % RING_SLOTS];
+        {
+            std::unique_lock<std::mutex> lock(pipeline.mutex);
+            pipeline.changed.wait(lock, [&pipeline, &slot, consumed]{
+                return slot.state == SlotState::PARSED
+                        or (pipeline.decompressionDone
+                            and consumed == pipeline.filledCount);
+            });
+            //everything decompressed has been consumed
+            if(slot.state != SlotState::PARSED){
+                if(pipeline.corrupt){status = LoadStatus::CANNOT_OPEN;}
+                break;
+            }
+        }
+        if(not slot.valid or not consume(slot.rows)){
+            status = LoadStatus::ERRONEOUS_LINE;
+        }
+        std::lock_guard<std::mutex> lock(pipeline.mutex);
+        slot.state = SlotState::FREE;
+        if(status != LoadStatus::SUCCESS){pipeline.cancelled = true;}
+        pipeline.changed.notify_all();
+        if(status != LoadStatus::SUCCESS){break;}
+    }
+    {
+        //let the threads out of their waits
+        std::lock_guard<std::mutex> lock(pipeline.mutex);
+        pipeline.cancelled = true;
+        pipeline.changed.notify_all();
+    }
+    decompressor.join();
+    for(auto& parser:parsers){
+        parser.join();
+    }
+    return status;
+}
@@ -0,0 +1,47 @@
+/* Chain stores - compressed feed loader
+ *
+ * Desc:
+ *   Reads an input file compressed with gzip (.gz) or zstd (.zst) without
+ * writing the decompressed data anywhere. One thread decompresses the
+ * stream into a ring of buffers, each cut after its last complete line.
+ * Parser threads run scan_rows on the filled buffers while the
+ * decompression goes on, and the calling thread takes the parsed rows
+ * buffer by buffer in the original order, then gives the buffer back to
+ * the ring.
+ *   gzip support needs zlib (HAVE_ZLIB) and zstd support needs libzstd
+ * (HAVE_ZSTD); see shopping.pro.
+ *
+ * Program author
+ * Name: Ruowen Liu
+ * Student number: -
+ * UserID: -
+ * E-Mail: ruowen.liu@tuni.fi
+ * */
+
+#ifndef COMPRESSED_HH
+#define COMPRESSED_HH
+
+#include "loader.hh"
+
+#include <string>
+
+/**
+ * @brief is_compressed_feed - tell from the file name extension whether
+ *        the file should be read through load_compressed
+ * @param path               - the input file name
+ * @return true for names ending with ".gz" or ".zst"
+ */
+bool is_compressed_feed(const std::string& path);
+
+/**
+ * @brief load_compressed - decompress, parse and consume a compressed
+ *        input file as a pipeline
+ * @param path            - the compressed file
+ * @param consume         - receives the rows, in the order of the file
+ * @return SUCCESS, or the first problem found; a format this build
+ *         can't decompress or a corrupt stream is CANNOT_OPEN
+ */
+LoadStatus load_compressed(const std::string& path,
+                           const RowConsumer& consume);
+
+#endif // COMPRESSED_HH
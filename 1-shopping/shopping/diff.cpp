@@ -0,0 +1,554 @@
+/* Chain stores - catalog diff
+ *
+ * Desc:
+ *   Implementation of the catalog diff. See diff.hh.
+ *   The work goes in three phases:
+ *   1) both files are loaded one after the other; every row goes to the
+ *      partition of its chain. When the rows in memory reach RUN_BUDGET,
+ *      each partition sorts its rows and writes them out as a run file.
+ *      The rows left at the end of a file stay in memory as its last run.
+ *   2) every partition (in parallel) merges the runs of the old and of
+ *      the new file and walks the two sorted streams side by side,
+ *      writing the changes to a file of its own.
+ *   3) the changes of the partitions are printed chain by chain, in the
+ *      alphabetical order of the chains.
+ *   The runs of one file are numbered in the order they were made, thus
+ *   among rows with the same chain, store and product the one in the
+ *   latest run is the latest one of the file (inside a run only the last
+ *   one is kept).
+ *
+ * Program author
+ * Name: Ruowen Liu
+ * Student number: -
+ * UserID: -
+ * E-Mail: ruowen.liu@tuni.fi
+ * */
+
+#include "diff.hh"
+#include "loader.hh"
+
+#include <algorithm>
+#include <charconv>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <queue>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+namespace {
+
+//the rows of one file kept in memory (all partitions together)
+const std::size_t RUN_BUDGET = std::size_t(64) << 20;
+const std::size_t ARENA_BLOCK = std::size_t(1) << 20;
+const std::size_t WRITE_CHUNK = std::size_t(1) << 20;
+
+const int OLD_FILE = 0;
+const int NEW_FILE = 1;
+
+//one row of an input file; -1.0 is out of stock
+struct Offer {
+    std::string_view chain;
+    std::string_view store;
+    std::string_view product;
+    double price;
+};
+
+int compare_keys(const Offer& a, const Offer& b){
+    if(int order = a.chain.compare(b.chain)){return order;}
+    if(int order = a.store.compare(b.store)){return order;}
+    return a.product.compare(b.product);
+}
+
+bool key_less(const Offer& a, const Offer& b){
+    return compare_keys(a, b) < 0;
+}
+
+bool read_price_field(std::string_view text, double& price){
+    if(text == "out-of-stock"){
+        price = -1.0;
+        return true;
+    }
+    //the same rule as parse_price of the catalog
+    return read_number(text, price) != 0;
+}
+
+//shortest text which reads back to the same double
+void append_price_field(std::string& buffer, double price){
+    if(price == -1.0){
+        buffer.append("out-of-stock");
+        return;
+    }
+    char digits[64];
+    auto result = std::to_chars(digits, digits + sizeof(digits), price);
+    buffer.append(digits, result.ptr);
+}
+
+//the texts of the rows in memory; the views stay valid until clear()
+class Arena {
+public:
+    std::string_view copy(std::string_view text){
+        if(blocks_.empty() or used_ + text.size() > blockSize_){
+            blockSize_ = std::max(ARENA_BLOCK, text.size());
+            blocks_.emplace_back(new char[blockSize_]);
+            used_ = 0;
+        }
+        char* start = blocks_.back().get() + used_;
+        std::copy(text.begin(), text.end(), start);
+        used_ += text.size();
+        return {start, text.size()};
+    }
+    void clear(){
+        blocks_.clear();
+        used_ = 0;
+        blockSize_ = 0;
+    }
+private:
+    std::vector<std::unique_ptr<char[]> > blocks_;
+    std::size_t used_ = 0;
+    std::size_t blockSize_ = 0;
+};
+
+//sorted rows, one per chain, store and product
+struct Run {
+    //empty ==> the run is in memory
+    std::string path;
+    std::vector<Offer> offers;
+    Arena texts;
+};
+
+//the rows of one file belonging to one partition
+struct SortedFile {
+    std::vector<Offer> pending;
+    Arena pendingTexts;
+    std::vector<std::unique_ptr<Run> > runs;
+};
+
+//where the changes of one chain are in the changes file of a partition
+struct ChainSpan {
+    std::string chain;
+    std::size_t partition;
+    std::streamoff begin;
+    std::streamoff end;
+};
+
+struct Partition {
+    SortedFile files[2];
+    std::string changesPath;
+    std::vector<ChainSpan> spans;
+    bool writeFailed = false;
+};
+
+class TempDirectory {
+public:
+    TempDirectory(){
+        std::error_code error;
+        auto base = std::filesystem::temp_directory_path(error);
+        if(error){return;}
+        for(int attempt = 0; attempt < 100; ++attempt){
+            auto candidate = base / ("shopping-diff-"
+                                     + std::to_string(getpid()) + "-"
+                                     + std::to_string(attempt));
+            if(std::filesystem::create_directory(candidate, error)){
+                path_ = candidate;
+                return;
+            }
+        }
+    }
+    ~TempDirectory(){
+        std::error_code error;
+        if(not path_.empty()){std::filesystem::remove_all(path_, error);}
+    }
+    bool created() const {
+        return not path_.empty();
+    }
+    std::string file(const std::string& name) const {
+        return (path_ / name).string();
+    }
+private:
+    std::filesystem::path path_;
+};
+
+//run work(i) for every partition i, each on its own thread
+void for_each_partition(std::size_t amount,
+                        const std::function<void(std::size_t)>& work){
+    std::vector<std::thread> workers;
+    for(std::size_t i = 1; i < amount; ++i){
+        workers.emplace_back(work, i);
+    }
+    work(0);
+    for(auto& worker:workers){
+        worker.join();
+    }
+}
+
+//sort the pending rows and keep only the last one of each key
+void sort_pending(SortedFile& file, Run& run){
+    std::stable_sort(file.pending.begin(), file.pending.end(), key_less);
+    for(std::size_t i = 0; i < file.pending.size(); ++i){
+        if(i + 1 < file.pending.size()
+                and compare_keys(file.pending[i], file.pending[i + 1]) == 0){
+            continue;
+        }
+        run.offers.push_back(file.pending[i]);
+    }
+    file.pending.clear();
+}
+
+//phase 1: sorted runs
+bool write_run(SortedFile& file, const std::string& path){
+    if(file.pending.empty()){return true;}
+    auto run = std::make_unique<Run>();
+    sort_pending(file, *run);
+    std::ofstream runFile(path, std::ios::binary);
+    std::string buffer;
+    for(auto& offer:run->offers){
+        buffer.append(offer.chain).push_back(';');
+        buffer.append(offer.store).push_back(';');
+        buffer.append(offer.product).push_back(';');
+        append_price_field(buffer, offer.price);
+        buffer.push_back('\n');
+        if(buffer.size() >= WRITE_CHUNK){
+            runFile.write(buffer.data(),
+                          static_cast<std::streamsize>(buffer.size()));
+            buffer.clear();
+        }
+    }
+    runFile.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+    run->offers.clear();
+    run->offers.shrink_to_fit();
+    file.pendingTexts.clear();
+    run->path = path;
+    file.runs.push_back(std::move(run));
+    return static_cast<bool>(runFile);
+}
+
+void keep_in_memory(SortedFile& file){
+    auto run = std::make_unique<Run>();
+    sort_pending(file, *run);
+    //the views of the offers point into these texts
+    run->texts = std::move(file.pendingTexts);
+    file.pendingTexts.clear();
+    file.runs.push_back(std::move(run));
+}
+
+class RunCursor {
+public:
+    explicit RunCursor(const Run& run) : run_(run) {
+        if(not run_.path.empty()){file_.open(run_.path, std::ios::binary);}
+    }
+    //move to the next offer; false at the end of the run
+    bool next(){
+        if(run_.path.empty()){
+            if(position_ == run_.offers.size()){return false;}
+            current_ = run_.offers[position_++];
+            return true;
+        }
+        if(not std::getline(file_, line_)){return false;}
+        //the run files are written by write_run, thus always well formed
+        std::string_view line = line_;
+        std::size_t first = line.find(';');
+        std::size_t second = line.find(';', first + 1);
+        std::size_t third = line.find(';', second + 1);
+        current_.chain = line.substr(0, first);
+        current_.store = line.substr(first + 1, second - first - 1);
+        current_.product = line.substr(second + 1, third - second - 1);
+        read_price_field(line.substr(third + 1), current_.price);
+        return true;
+    }
+    const Offer& offer() const {
+        return current_;
+    }
+private:
+    const Run& run_;
+    std::size_t position_ = 0;
+    std::ifstream file_;
+    std::string line_;
+    Offer current_ = {};
+};
+
+//phase 2: the runs of one file merged into one sorted stream
+class RunMerger {
+public:
+    explicit RunMerger(const std::vector<std::unique_ptr<Run> >& runs)
+        : heap_(HeapOrder{&cursors_}) {
+        for(auto& run:runs){
+            cursors_.push_back(std::make_unique<RunCursor>(*run));
+            if(cursors_.back()->next()){heap_.push(cursors_.size() - 1);}
+        }
+    }
+    //move to the next key; false at the end
+    bool next(){
+        if(heap_.empty()){return false;}
+        std::size_t first = heap_.top();
+        heap_.pop();
+        const Offer& offer = cursors_[first]->offer();
+        chain_.assign(offer.chain);
+        store_.assign(offer.store);
+        product_.assign(offer.product);
+        current_ = {chain_, store_, product_, offer.price};
+        advance(first);
+        //the same key in a later run rewrites the price
+        while(not heap_.empty()
+              and compare_keys(cursors_[heap_.top()]->offer(),
+                               current_) == 0){
+            std::size_t later = heap_.top();
+            heap_.pop();
+            current_.price = cursors_[later]->offer().price;
+            advance(later);
+        }
+        return true;
+    }
+    const Offer& offer() const {
+        return current_;
+    }
+private:
+    //the smallest key on top; of equal keys, the earliest run
+    struct HeapOrder {
+        const std::vector<std::unique_ptr<RunCursor> >* cursors;
+        bool operator()(std::size_t a, std::size_t b) const {
+            int order = compare_keys((*cursors)[a]->offer(),
+                                     (*cursors)[b]->offer());
+            return order != 0 ? order > 0 : a > b;
+        }
+    };
+    void advance(std::size_t cursor){
+        if(cursors_[cursor]->next()){heap_.push(cursor);}
+    }
+
+    std::vector<std::unique_ptr<RunCursor> > cursors_;
+    std::priority_queue<std::size_t, std::vector<std::size_t>, HeapOrder>
+            heap_;
+    std::string chain_;
+    std::string store_;
+    std::string product_;
+    Offer current_ = {};
+};
+
+/* the changes file line:
+ * change;chain;store;product;old price;new price
+ * a price missing from one of the files is empty */
+class ChangeWriter {
+public:
+    ChangeWriter(Partition& partition, std::size_t partitionNumber)
+        : partition_(partition), partitionNumber_(partitionNumber),
+          file_(partition.changesPath, std::ios::binary) {}
+    void write(const char* change, const Offer& offer,
+               const double* oldPrice, const double* newPrice){
+        if(offer.chain != chain_){
+            close_span();
+            chain_.assign(offer.chain);
+            spanBegin_ = written_;
+        }
+        std::size_t start = buffer_.size();
+        buffer_.append(change).push_back(';');
+        buffer_.append(offer.chain).push_back(';');
+        buffer_.append(offer.store).push_back(';');
+        buffer_.append(offer.product).push_back(';');
+        if(oldPrice){append_price_field(buffer_, *oldPrice);}
+        buffer_.push_back(';');
+        if(newPrice){append_price_field(buffer_, *newPrice);}
+        buffer_.push_back('\n');
+        written_ += static_cast<std::streamoff>(buffer_.size() - start);
+        if(buffer_.size() >= WRITE_CHUNK){flush();}
+    }
+    //false if the file couldn't be written
+    bool finish(){
+        close_span();
+        flush();
+        file_.close();
+        return not file_.fail();
+    }
+private:
+    void close_span(){
+        if(written_ > spanBegin_){
+            partition_.spans.push_back({chain_, partitionNumber_,
+                                        spanBegin_, written_});
+        }
+    }
+    void flush(){
+        file_.write(buffer_.data(),
+                    static_cast<std::streamsize>(buffer_.size()));
+        buffer_.clear();
+    }
+
+    Partition& partition_;
+    std::size_t partitionNumber_;
+    std::ofstream file_;
+    std::string buffer_;
+    std::string chain_;
+    std::streamoff spanBegin_ = 0;
+    std::streamoff written_ = 0;
+};
+
+void compare_partition(Partition& partition, std::size_t partitionNumber){
+    RunMerger oldOffers(partition.files[OLD_FILE].runs);
+    RunMerger newOffers(partition.files[NEW_FILE].runs);
+    ChangeWriter changes(partition, partitionNumber);
+    bool hasOld = oldOffers.next();
+    bool hasNew = newOffers.next();
+    while(hasOld or hasNew){
+        int order = not hasOld ? 1
+                  : not hasNew ? -1
+                  : compare_keys(oldOffers.offer(), newOffers.offer());
+        if(order < 0){
+            changes.write("removed", oldOffers.offer(),
+                          &oldOffers.offer().price, nullptr);
+            hasOld = oldOffers.next();
+            continue;
+        }
+        if(order > 0){
+            changes.write("added", newOffers.offer(),
+                          nullptr, &newOffers.offer().price);
+            hasNew = newOffers.next();
+            continue;
+        }
+        double oldPrice = oldOffers.offer().price;
+        double newPrice = newOffers.offer().price;
+        const char* change = nullptr;
+        if(oldPrice == -1.0 and newPrice != -1.0){change = "in-stock";}
+        else if(oldPrice != -1.0 and newPrice == -1.0){
+            change = "out-of-stock";
+        }
+        else if(oldPrice != newPrice){change = "repriced";}
+        if(change){
+            changes.write(change, newOffers.offer(), &oldPrice, &newPrice);
+        }
+        hasOld = oldOffers.next();
+        hasNew = newOffers.next();
+    }
+    if(not changes.finish()){partition.writeFailed = true;}
+}
+
+//phase 3: print the changes of one chain
+void print_span(const ChainSpan& span, std::ifstream& changes, Output& out){
+    changes.clear();
+    changes.seekg(span.begin);
+    std::string line;
+    std::streamoff position = span.begin;
+    while(position < span.end and std::getline(changes, line)){
+        position += static_cast<std::streamoff>(line.size()) + 1;
+        std::string_view fields[6];
+        std::string_view rest = line;
+        for(int i = 0; i < 5; ++i){
+            std::size_t separator = rest.find(';');
+            fields[i] = rest.substr(0, separator);
+            rest.remove_prefix(separator + 1);
+        }
+        fields[5] = rest;
+        out.row_begin();
+        out.field("change", fields[0]);
+        out.field("chain", fields[1]);
+        out.field("store", fields[2]);
+        out.field("product", fields[3]);
+        double price = -1.0;
+        if(not fields[4].empty() and read_price_field(fields[4], price)){
+            out.price_field("old_price", price);
+        }
+        if(not fields[5].empty() and read_price_field(fields[5], price)){
+            out.price_field("new_price", price);
+        }
+        out.row_end();
+    }
+}
+
+} // namespace
+
+bool diff_catalogs(const std::string& oldPath, const std::string& newPath,
+                   Output& out){
+    TempDirectory temp;
+    if(not temp.created()){
+        out.error("diff", "Error: the temporary files cannot be written");
+        return false;
+    }
+    std::size_t partitionAmount =
+            std::max(1u, std::thread::hardware_concurrency());
+    std::vector<Partition> partitions(partitionAmount);
+    for(std::size_t i = 0; i < partitionAmount; ++i){
+        partitions[i].changesPath = temp.file("changes-" + std::to_string(i));
+    }
+    std::size_t runsWritten = 0;
+    bool writeFailed = false;
+
+    //phase 1, for both files
+    const std::string* paths[2] = {&oldPath, &newPath};
+    for(int side = OLD_FILE; side <= NEW_FILE; ++side){
+        std::size_t pendingBytes = 0;
+        auto spill = [&](){
+            for_each_partition(partitionAmount,
+                               [&](std::size_t i){
+                std::string path = temp.file(
+                            "run-" + std::to_string(runsWritten + i));
+                if(not write_run(partitions[i].files[side], path)){
+                    partitions[i].writeFailed = true;
+                }
+            });
+            runsWritten += partitionAmount;
+            pendingBytes = 0;
+        };
+        auto collect = [&](const std::vector<RowFields>& rows){
+            for(auto& row:rows){
+                double price = -1.0;
+                if(not read_price_field(row.price, price)){return false;}
+                std::size_t partition = std::hash<std::string_view>()(
+                            row.chain) % partitionAmount;
+                SortedFile& file = partitions[partition].files[side];
+                file.pending.push_back({file.pendingTexts.copy(row.chain),
+                                        file.pendingTexts.copy(row.store),
+                                        file.pendingTexts.copy(row.product),
+                                        price});
+                pendingBytes += sizeof(Offer) + row.chain.size()
+                        + row.store.size() + row.product.size();
+            }
+            if(pendingBytes >= RUN_BUDGET){spill();}
+            return true;
+        };
+        LoadStatus status = load_input(*paths[side], collect);
+        if(status == LoadStatus::CANNOT_OPEN){
+            out.error("diff", "Error: the input file cannot be opened");
+            return false;
+        }
+        if(status == LoadStatus::ERRONEOUS_LINE){
+            out.error("diff", "Error: the input file has an erroneous line");
+            return false;
+        }
+        for_each_partition(partitionAmount, [&](std::size_t i){
+            keep_in_memory(partitions[i].files[side]);
+        });
+    }
+
+    //phase 2
+    for_each_partition(partitionAmount, [&](std::size_t i){
+        compare_partition(partitions[i], i);
+    });
+    std::vector<ChainSpan> spans;
+    for(auto& partition:partitions){
+        writeFailed = writeFailed or partition.writeFailed;
+        spans.insert(spans.end(), partition.spans.begin(),
+                     partition.spans.end());
+    }
+    if(writeFailed){
+        out.error("diff", "Error: the temporary files cannot be written");
+        return false;
+    }
+
+    //phase 3; a chain is always in one partition only
+    std::sort(spans.begin(), spans.end(),
+              [](const ChainSpan& a, const ChainSpan& b){
+        return a.chain < b.chain;
+    });
+    std::vector<std::ifstream> changes;
+    for(auto& partition:partitions){
+        changes.emplace_back(partition.changesPath, std::ios::binary);
+    }
+    out.begin("diff");
+    for(auto& span:spans){
+        print_span(span, changes[span.partition], out);
+    }
+    out.end();
+    return true;
+}
@@ -0,0 +1,46 @@
+/* Chain stores - catalog diff
+ *
+ * Desc:
+ *   Compares two input files (e.g. yesterday's and today's feed) and
+ * prints what changed, one line per (chain, store, product):
+ *   added        - only in the new file
+ *   removed      - only in the old file
+ *   repriced     - in stock in both, with a different price
+ *   out-of-stock - in stock before, out of stock now
+ *   in-stock     - out of stock before, in stock now
+ * followed by chain, store, product and the old and/or new price. The
+ * lines come in the order of chain, store and product.
+ *   Like when the program loads its input, a later line of the same
+ * chain, store and product rewrites an earlier one in the same file.
+ *   The files don't have to fit in memory: the rows are collected into
+ * sorted runs which are written to temporary files when the memory
+ * budget is used up, then the runs of each file are merged. The rows
+ * are spread over partitions by chain; the partitions are merged and
+ * compared in parallel.
+ *
+ * Program author
+ * Name: Ruowen Liu
+ * Student number: -
+ * UserID: -
+ * E-Mail: ruowen.liu@tuni.fi
+ * */
+
+#ifndef DIFF_HH
+#define DIFF_HH
+
+#include "output.hh"
+
+#include <string>
+
+/**
+ * @brief diff_catalogs - print the changes from the old input to the new
+ * @param oldPath       - the old input (a file, directory or .gz/.zst
+ *                        file, see load_input in loader.hh)
+ * @param newPath       - the new input
+ * @param out           - where the changes and the error messages go
+ * @return false if either input can't be read
+ */
+bool diff_catalogs(const std::string& oldPath, const std::string& newPath,
+                   Output& out);
+
+#endif // DIFF_HH
@@ -0,0 +1,530 @@
+/* Chain stores - columnar export
+ *
+ * Desc:
+ *   Implementation of the Arrow export. See export.hh.
+ *   An Arrow IPC file is
+ *     "ARROW1", 2 bytes of padding,
+ *     messages: the schema, a dictionary batch per dictionary and the
+ *               record batches, then an end-of-stream marker,
+ *     the footer (the schema again and the places of the batches),
+ *     the size of the footer (int32), "ARROW1".
+ * A message is 0xFFFFFFFF, the size of its metadata (int32), the metadata
+ * and the body with the data buffers. The metadata and the footer are
+ * flatbuffers (see Schema.fbs, Message.fbs and File.fbs of the Arrow
+ * format); FlatBuilder writes just the part of flatbuffers they need.
+ *
+ * Program author
+ * Name: Ruowen Liu
+ * Student number: -
+ * UserID: -
+ * E-Mail: ruowen.liu@tuni.fi
+ * */
+
+#include "export.hh"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <string_view>
+#include <vector>
+
+#include <unistd.h>
+
+namespace {
+
+const std::size_t BATCH_ROWS = std::size_t(1) << 20;
+//of the buffers in the file
+const std::size_t BUFFER_ALIGNMENT = 64;
+
+//- - - - - - values from the Arrow format definition - - - - - -
+const std::uint64_t METADATA_V5 = 4;
+//members of the union MessageHeader
+const std::uint64_t HEADER_SCHEMA = 1;
+const std::uint64_t HEADER_DICTIONARY_BATCH = 2;
+const std::uint64_t HEADER_RECORD_BATCH = 3;
+//members of the union Type
+const std::uint64_t TYPE_UTF8 = 5;
+const std::uint64_t TYPE_DECIMAL = 7;
+
+const std::uint64_t PRICE_PRECISION = 18;
+const std::uint64_t PRICE_SCALE = 2;
+//the largest price in cents with PRICE_PRECISION digits
+const double PRICE_LIMIT = 1e18 - 1;
+
+const char MAGIC[] = "ARROW1";
+const std::size_t MAGIC_SIZE = 6;
+
+//- - - - - - structs of the format, laid out as in flatbuffers - - - - - -
+struct FieldNode {
+    std::int64_t length;
+    std::int64_t nullCount;
+};
+
+struct BufferSpec {
+    std::int64_t offset;
+    std::int64_t length;
+};
+
+//the place of a message in the file
+struct Block {
+    std::int64_t offset;
+    std::int32_t metaDataLength;
+    std::int32_t padding;
+    std::int64_t bodyLength;
+};
+
+static_assert(sizeof(FieldNode) == 16 and sizeof(BufferSpec) == 16
+              and sizeof(Block) == 24, "flatbuffers struct layout");
+
+/**
+ * @brief The FlatBuilder class - writes a flatbuffer front to back: every
+ *        table is preceded by its vtable and followed by the objects it
+ *        refers to, thus all the offsets point forward as required
+ */
+class FlatBuilder {
+public:
+    //writes an object and returns its position
+    using Writer = std::function<std::uint32_t(FlatBuilder&)>;
+
+    //a field of a table: a scalar of 1, 2, 4 or 8 bytes, or an object
+    struct Field {
+        std::uint16_t id;
+        std::size_t size;
+        std::uint64_t value;
+        Writer object;
+    };
+    static Field scalar(std::uint16_t id, std::size_t size,
+                        std::uint64_t value){
+        return {id, size, value, nullptr};
+    }
+    static Field object(std::uint16_t id, Writer writer){
+        return {id, 4, 0, std::move(writer)};
+    }
+
+    //the flatbuffer with root as its root table, padded to 8 bytes
+    std::string finish(const Writer& root){
+        bytes_.assign(4, '\0');
+        patch_offset(0, root(*this));
+        align(8);
+        return std::move(bytes_);
+    }
+
+    std::uint32_t table(std::vector<Field> fields){
+        std::uint16_t slots = 0;
+        for(auto& field:fields){
+            slots = std::max(slots, static_cast<std::uint16_t>(field.id + 1));
+        }
+        align(2);
+        std::size_t vtable = bytes_.size();
+        bytes_.append(4 + 2 * slots, '\0');
+        put_at(vtable, 4 + 2 * slots, 2);
+
+        align(8);
+        std::size_t table = bytes_.size();
+        put(static_cast<std::uint32_t>(table - vtable), 4);
+        //the biggest fields first, for the least padding
+        std::stable_sort(fields.begin(), fields.end(),
+                         [](const Field& a, const Field& b){
+            return a.size > b.size;
+        });
+        std::vector<std::size_t> slotsOfObjects;
+        for(auto& field:fields){
+            align(field.size);
+            put_at(vtable + 4 + 2 * field.id, bytes_.size() - table, 2);
+            if(field.object){slotsOfObjects.push_back(bytes_.size());}
+            put(field.value, field.size);
+        }
+        put_at(vtable + 2, bytes_.size() - table, 2);
+
+        std::size_t i = 0;
+        for(auto& field:fields){
+            if(field.object){patch_offset(slotsOfObjects[i++],
+                                          field.object(*this));}
+        }
+        return static_cast<std::uint32_t>(table);
+    }
+
+    std::uint32_t string(std::string_view text){
+        align(4);
+        std::size_t position = bytes_.size();
+        put(text.size(), 4);
+        bytes_.append(text);
+        bytes_.push_back('\0');
+        return static_cast<std::uint32_t>(position);
+    }
+
+    //a vector of FieldNode, BufferSpec or Block
+    template <typename T>
+    std::uint32_t structs(const std::vector<T>& elements){
+        //the elements (after the length) start at a multiple of 8
+        while((bytes_.size() + 4) % 8 != 0){bytes_.push_back('\0');}
+        std::size_t position = bytes_.size();
+        put(elements.size(), 4);
+        bytes_.append(reinterpret_cast<const char*>(elements.data()),
+                      elements.size() * sizeof(T));
+        return static_cast<std::uint32_t>(position);
+    }
+
+    std::uint32_t tables(const std::vector<Writer>& elements){
+        align(4);
+        std::size_t position = bytes_.size();
+        put(elements.size(), 4);
+        bytes_.append(4 * elements.size(), '\0');
+        for(std::size_t i = 0; i < elements.size(); ++i){
+            patch_offset(position + 4 + 4 * i, elements[i](*this));
+        }
+        return static_cast<std::uint32_t>(position);
+    }
+
+private:
+    void align(std::size_t alignment){
+        while(bytes_.size() % alignment != 0){bytes_.push_back('\0');}
+    }
+    //the numbers are in the byte order of the machine
+    void put(std::uint64_t value, std::size_t size){
+        bytes_.append(size, '\0');
+        put_at(bytes_.size() - size, value, size);
+    }
+    void put_at(std::size_t position, std::uint64_t value, std::size_t size){
+        if(size == 1){bytes_[position] = static_cast<char>(value);}
+        else if(size == 2){store(position, static_cast<std::uint16_t>(value));}
+        else if(size == 4){store(position, static_cast<std::uint32_t>(value));}
+        else{store(position, value);}
+    }
+    template <typename T>
+    void store(std::size_t position, T value){
+        std::memcpy(&bytes_[position], &value, sizeof(T));
+    }
+    void patch_offset(std::size_t slot, std::uint32_t target){
+        put_at(slot, target - slot, 4);
+    }
+
+    std::string bytes_;
+};
+
+using Writer = FlatBuilder::Writer;
+using Field = FlatBuilder::Field;
+
+bool little_endian(){
+    const std::uint16_t one = 1;
+    unsigned char first = 0;
+    std::memcpy(&first, &one, 1);
+    return first == 1;
+}
+
+//- - - - - - the schema - - - - - -
+Writer field_writer(std::string_view name, bool nullable,
+                    std::uint64_t typeType, Writer type, Writer dictionary){
+    return [=](FlatBuilder& builder){
+        std::vector<Field> fields = {
+            FlatBuilder::object(0, [name](FlatBuilder& b){
+                return b.string(name);
+            }),
+            FlatBuilder::scalar(1, 1, nullable),
+            FlatBuilder::scalar(2, 1, typeType),
+            FlatBuilder::object(3, type),
+            //the readers require the children, even when there are none
+            FlatBuilder::object(5, [](FlatBuilder& b){return b.tables({});}),
+        };
+        if(dictionary){fields.push_back(FlatBuilder::object(4, dictionary));}
+        return builder.table(std::move(fields));
+    };
+}
+
+Writer dictionary_field(std::string_view name, std::uint64_t dictionaryId){
+    Writer utf8 = [](FlatBuilder& b){return b.table({});};
+    Writer encoding = [dictionaryId](FlatBuilder& b){
+        return b.table({
+            FlatBuilder::scalar(0, 8, dictionaryId),
+            FlatBuilder::object(1, [](FlatBuilder& b){
+                //int32 indices
+                return b.table({FlatBuilder::scalar(0, 4, 32),
+                                FlatBuilder::scalar(1, 1, 1)});
+            }),
+            //the dictionaries are sorted
+            FlatBuilder::scalar(2, 1, 1),
+        });
+    };
+    return field_writer(name, false, TYPE_UTF8, utf8, encoding);
+}
+
+Writer schema_writer(){
+    return [](FlatBuilder& builder){
+        Writer decimal = [](FlatBuilder& b){
+            return b.table({FlatBuilder::scalar(0, 4, PRICE_PRECISION),
+                            FlatBuilder::scalar(1, 4, PRICE_SCALE),
+                            FlatBuilder::scalar(2, 4, 128)});
+        };
+        std::vector<Writer> fields = {
+            dictionary_field("chain", 0),
+            dictionary_field("store", 1),
+            dictionary_field("product", 2),
+            field_writer("price", true, TYPE_DECIMAL, decimal, nullptr),
+        };
+        return builder.table({
+            FlatBuilder::scalar(0, 2, little_endian() ? 0 : 1),
+            FlatBuilder::object(1, [fields](FlatBuilder& b){
+                return b.tables(fields);
+            }),
+        });
+    };
+}
+
+//- - - - - - messages - - - - - -
+//a buffer of a message body
+struct BodyBuffer {
+    const void* data;
+    std::size_t length;
+};
+
+std::size_t padded(std::size_t size, std::size_t alignment){
+    return (size + alignment - 1) / alignment * alignment;
+}
+
+//the RecordBatch table describing a body
+Writer record_batch_writer(std::int64_t length,
+                           const std::vector<FieldNode>& nodes,
+                           const std::vector<BodyBuffer>& buffers){
+    std::vector<BufferSpec> specs;
+    std::int64_t offset = 0;
+    for(auto& buffer:buffers){
+        auto bufferLength = static_cast<std::int64_t>(buffer.length);
+        specs.push_back({offset, bufferLength});
+        offset += static_cast<std::int64_t>(padded(buffer.length,
+                                                   BUFFER_ALIGNMENT));
+    }
+    return [length, nodes, specs](FlatBuilder& builder){
+        return builder.table({
+            FlatBuilder::scalar(0, 8, static_cast<std::uint64_t>(length)),
+            FlatBuilder::object(1, [nodes](FlatBuilder& b){
+                return b.structs(nodes);
+            }),
+            FlatBuilder::object(2, [specs](FlatBuilder& b){
+                return b.structs(specs);
+            }),
+        });
+    };
+}
+
+/**
+ * @brief The ArrowWriter class - writes the parts of the file and keeps
+ *        account of where the batches went, for the footer
+ */
+class ArrowWriter {
+public:
+    explicit ArrowWriter(const std::string& path)
+        : file_(path, std::ios::binary | std::ios::trunc) {
+        write(MAGIC, MAGIC_SIZE);
+        pad();
+    }
+
+    bool good() const { return file_.good(); }
+
+    void schema(){
+        message(HEADER_SCHEMA, schema_writer(), {});
+    }
+
+    void dictionary(std::uint64_t id,
+                    const std::vector<std::string_view>& names){
+        std::vector<std::int32_t> offsets = {0};
+        std::string data;
+        for(auto name:names){
+            data.append(name);
+            offsets.push_back(static_cast<std::int32_t>(data.size()));
+        }
+        auto length = static_cast<std::int64_t>(names.size());
+        //no validity bitmap: nothing is null
+        std::vector<BodyBuffer> buffers = {
+            {nullptr, 0},
+            {offsets.data(), offsets.size() * sizeof(std::int32_t)},
+            {data.data(), data.size()},
+        };
+        Writer batch = record_batch_writer(length, {{length, 0}}, buffers);
+        Writer header = [id, batch](FlatBuilder& builder){
+            return builder.table({FlatBuilder::scalar(0, 8, id),
+                                  FlatBuilder::object(1, batch)});
+        };
+        dictionaries_.push_back(message(HEADER_DICTIONARY_BATCH, header,
+                                        buffers));
+    }
+
+    void record_batch(std::int64_t length, const std::vector<FieldNode>& nodes,
+                      const std::vector<BodyBuffer>& buffers){
+        recordBatches_.push_back(message(HEADER_RECORD_BATCH,
+                                         record_batch_writer(length, nodes,
+                                                             buffers),
+                                         buffers));
+    }
+
+    bool finish(){
+        //end of the stream
+        const std::uint32_t endOfStream[2] = {0xFFFFFFFF, 0};
+        write(endOfStream, sizeof(endOfStream));
+        std::vector<Block> dictionaries = dictionaries_;
+        std::vector<Block> recordBatches = recordBatches_;
+        std::string footer = FlatBuilder().finish([&](FlatBuilder& builder){
+            return builder.table({
+                FlatBuilder::scalar(0, 2, METADATA_V5),
+                FlatBuilder::object(1, schema_writer()),
+                FlatBuilder::object(2, [&](FlatBuilder& b){
+                    return b.structs(dictionaries);
+                }),
+                FlatBuilder::object(3, [&](FlatBuilder& b){
+                    return b.structs(recordBatches);
+                }),
+            });
+        });
+        write(footer.data(), footer.size());
+        auto footerSize = static_cast<std::int32_t>(footer.size());
+        write(&footerSize, sizeof(footerSize));
+        write(MAGIC, MAGIC_SIZE);
+        file_.close();
+        return not file_.fail();
+    }
+
+private:
+    Block message(std::uint64_t headerType, const Writer& header,
+                  const std::vector<BodyBuffer>& buffers){
+        std::uint64_t bodyLength = 0;
+        for(auto& buffer:buffers){
+            bodyLength += padded(buffer.length, BUFFER_ALIGNMENT);
+        }
+        std::string metadata = FlatBuilder().finish([&](FlatBuilder& b){
+            return b.table({
+                FlatBuilder::scalar(0, 2, METADATA_V5),
+                FlatBuilder::scalar(1, 1, headerType),
+                FlatBuilder::object(2, header),
+                FlatBuilder::scalar(3, 8, bodyLength),
+            });
+        });
+        /* The metadata is padded so that the body starts at a multiple
+         * of BUFFER_ALIGNMENT in the file, thus the buffers do too */
+        std::size_t metadataEnd = position_ + 8 + metadata.size();
+        std::size_t gap = padded(metadataEnd, BUFFER_ALIGNMENT) - metadataEnd;
+        auto metadataSize = static_cast<std::uint32_t>(metadata.size() + gap);
+        Block block = {static_cast<std::int64_t>(position_),
+                       static_cast<std::int32_t>(8 + metadataSize), 0,
+                       static_cast<std::int64_t>(bodyLength)};
+        const std::uint32_t prefix[2] = {0xFFFFFFFF, metadataSize};
+        write(prefix, sizeof(prefix));
+        write(metadata.data(), metadata.size());
+        write(ZEROS, gap);
+        for(auto& buffer:buffers){
+            write(buffer.data, buffer.length);
+            write(ZEROS, padded(buffer.length, BUFFER_ALIGNMENT)
+                  - buffer.length);
+        }
+        return block;
+    }
+
+    void write(const void* data, std::size_t size){
+        if(size == 0){return;}
+        file_.write(static_cast<const char*>(data),
+                    static_cast<std::streamsize>(size));
+        position_ += size;
+    }
+    void pad(){
+        write(ZEROS, padded(position_, 8) - position_);
+    }
+
+    static const char ZEROS[BUFFER_ALIGNMENT];
+
+    std::ofstream file_;
+    std::uint64_t position_ = 0;
+    std::vector<Block> dictionaries_;
+    std::vector<Block> recordBatches_;
+};
+
+const char ArrowWriter::ZEROS[BUFFER_ALIGNMENT] = {};
+
+std::vector<std::string_view> names_of(const Catalog& catalog,
+                                       Span<NameId> ids){
+    std::vector<std::string_view> names;
+    names.reserve(ids.size());
+    for(auto id:ids){names.push_back(catalog.name(id));}
+    return names;
+}
+
+} // namespace
+
+ExportStatus export_arrow(const Catalog& catalog, const std::string& path){
+    const OfferColumns& columns = catalog.columns();
+    const std::size_t offerCount = columns.price.size();
+    for(double price:columns.price){
+        if(std::fabs(price) * 100 > PRICE_LIMIT){
+            return ExportStatus::PRICE_TOO_LARGE;
+        }
+    }
+
+    //the store dictionary has every name once; storeIndex maps a StoreId
+    std::vector<std::string_view> storeNames;
+    for(StoreId store = 0; store < catalog.store_count(); ++store){
+        storeNames.push_back(catalog.name(catalog.store_name(store)));
+    }
+    std::vector<std::string_view> storeDictionary = storeNames;
+    std::sort(storeDictionary.begin(), storeDictionary.end());
+    storeDictionary.erase(std::unique(storeDictionary.begin(),
+                                      storeDictionary.end()),
+                          storeDictionary.end());
+    std::vector<std::int32_t> storeIndex;
+    for(auto name:storeNames){
+        storeIndex.push_back(static_cast<std::int32_t>(
+                                 std::lower_bound(storeDictionary.begin(),
+                                                  storeDictionary.end(), name)
+                                 - storeDictionary.begin()));
+    }
+
+    ArrowWriter writer(path);
+    writer.schema();
+    writer.dictionary(0, names_of(catalog, catalog.chains()));
+    writer.dictionary(1, storeDictionary);
+    writer.dictionary(2, names_of(catalog, catalog.products()));
+
+    std::vector<std::int32_t> stores;
+    std::vector<std::uint8_t> validity;
+    std::vector<std::int64_t> prices;
+    for(std::size_t first = 0; first < offerCount and writer.good();
+        first += BATCH_ROWS){
+        const std::size_t length = std::min(BATCH_ROWS, offerCount - first);
+        stores.resize(length);
+        validity.assign((length + 7) / 8, 0);
+        //decimal128: the cents as the low half, the sign as the high half
+        prices.assign(2 * length, 0);
+        std::int64_t nullCount = 0;
+        for(std::size_t i = 0; i < length; ++i){
+            stores[i] = storeIndex[columns.store[first + i]];
+            double price = columns.price[first + i];
+            if(price == -1.0){
+                ++nullCount;
+                continue;
+            }
+            validity[i / 8] |= static_cast<std::uint8_t>(1u << (i % 8));
+            std::int64_t cents = std::llround(price * 100);
+            prices[2 * i] = cents;
+            prices[2 * i + 1] = cents < 0 ? -1 : 0;
+        }
+        auto rows = static_cast<std::int64_t>(length);
+        std::vector<FieldNode> nodes = {{rows, 0}, {rows, 0}, {rows, 0},
+                                        {rows, nullCount}};
+        //the chain and product codes are the dictionary indices as such
+        std::vector<BodyBuffer> buffers = {
+            {nullptr, 0},
+            {columns.chain.data() + first, length * sizeof(ChainId)},
+            {nullptr, 0},
+            {stores.data(), length * sizeof(std::int32_t)},
+            {nullptr, 0},
+            {columns.product.data() + first, length * sizeof(ProductId)},
+            {validity.data(), nullCount == 0 ? 0 : validity.size()},
+            {prices.data(), prices.size() * sizeof(std::int64_t)},
+        };
+        writer.record_batch(rows, nodes, buffers);
+    }
+    if(not writer.good() or not writer.finish()){
+        ::unlink(path.c_str());
+        return ExportStatus::CANNOT_WRITE;
+    }
+    return ExportStatus::SUCCESS;
+}
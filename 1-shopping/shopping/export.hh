@@ -0,0 +1,53 @@
+/* Chain stores - columnar export
+ *
+ * Desc:
+ *   Writes the offers of a catalog as an Apache Arrow IPC file (the
+ * "Feather v2" format), which analytics tools can open with e.g.
+ * pyarrow.ipc.open_file or memory-map and scan without parsing. The
+ * file is written directly: the Arrow library is not needed.
+ *   The file has one row per offer, in the order of chains, stores and
+ * products, and four columns:
+ *   chain    - dictionary<int32, utf8>, the chain names
+ *   store    - dictionary<int32, utf8>, the store names (a store name
+ *              found in several chains is in the dictionary once)
+ *   product  - dictionary<int32, utf8>, the product names
+ *   price    - decimal128(18, 2), the price in cents; null when out of
+ *              stock
+ * The dictionaries are in alphabetical order. The rows are split into
+ * record batches of at most 2^20 rows, and every buffer starts at a
+ * multiple of 64 bytes, as the Arrow format recommends for memory
+ * mapping.
+ *   The numbers are written in the byte order of the machine, which is
+ * recorded in the schema; Arrow readers expect little endian (x86, ARM).
+ *
+ * Program author
+ * Name: Ruowen Liu
+ * Student number: -
+ * UserID: -
+ * E-Mail: ruowen.liu@tuni.fi
+ * */
+
+#ifndef EXPORT_HH
+#define EXPORT_HH
+
+#include "catalog.hh"
+
+#include <string>
+
+//the result of an export
+enum class ExportStatus {
+    SUCCESS,
+    CANNOT_WRITE,
+    //a price does not fit 18 digits in cents
+    PRICE_TOO_LARGE
+};
+
+/**
+ * @brief export_arrow - write the offers of a catalog to an Arrow IPC file
+ * @param catalog      - the catalog exported
+ * @param path         - the file written; an existing file is replaced
+ * @return SUCCESS, or the problem found; a partly written file is removed
+ */
+ExportStatus export_arrow(const Catalog& catalog, const std::string& path);
+
+#endif // EXPORT_HH
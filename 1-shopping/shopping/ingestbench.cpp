@@ -0,0 +1,141 @@
+/* Chain stores - ingestion benchmark
+ *
+ * Desc:
+ *   Measures how writing into the sharded store (see sharded.hh) scales
+ * with the number of writer threads. The input file is read into memory
+ * and cut into batches of rows once; then for 1, 2, ... N threads a new
+ * store is written by the threads, each taking the next unwritten batch
+ * until none is left, like writers of several feeds would.
+ *   Usage: ingestbench <input file> [N threads] [rows per batch]
+ * N defaults to the number of hardware threads. At the end the catalog
+ * built from the store of the single writer is compared with the catalog
+ * loaded from the file (with several writers, the order of the rows
+ * rewriting the same offer is not the order of the file).
+ *
+ * Program author
+ * Name: Ruowen Liu
+ * Student number: -
+ * UserID: -
+ * E-Mail: ruowen.liu@tuni.fi
+ * */
+
+#include "catalog.hh"
+#include "sharded.hh"
+#include "scanner.hh"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+const size_t DEFAULT_BATCH_ROWS = 4096;
+
+//true if the two catalogs have the same offers
+bool same_offers(const Catalog& a, const Catalog& b){
+    const OfferColumns& columnsA = a.columns();
+    const OfferColumns& columnsB = b.columns();
+    if(columnsA.price.size() != columnsB.price.size()){return false;}
+    for(size_t row = 0; row < columnsA.price.size(); ++row){
+        if(a.name(a.chain_name(columnsA.chain[row]))
+                != b.name(b.chain_name(columnsB.chain[row]))
+                or a.name(a.store_name(columnsA.store[row]))
+                != b.name(b.store_name(columnsB.store[row]))
+                or a.name(a.product_name(columnsA.product[row]))
+                != b.name(b.product_name(columnsB.product[row]))
+                or columnsA.price[row] != columnsB.price[row]){
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]){
+    if(argc < 2 or argc > 4){
+        cerr << "Usage: " << argv[0]
+             << " <input file> [N threads] [rows per batch]" << endl;
+        return EXIT_FAILURE;
+    }
+    string path = argv[1];
+    size_t maxThreads = max(1u, thread::hardware_concurrency());
+    size_t batchRows = DEFAULT_BATCH_ROWS;
+    if(argc > 2){maxThreads = max(1, stoi(argv[2]));}
+    if(argc > 3){batchRows = static_cast<size_t>(max(1, stoi(argv[3])));}
+
+    ifstream file(path, ios::binary);
+    if(!file){
+        cerr << "Error: the input file cannot be opened" << endl;
+        return EXIT_FAILURE;
+    }
+    stringstream contents;
+    contents << file.rdbuf();
+    string data = contents.str();
+    StructuralIndex index;
+    vector<RowFields> rows;
+    if(!scan_rows(data.data(), data.size(), index, rows)){
+        cerr << "Error: the input file has an erroneous line" << endl;
+        return EXIT_FAILURE;
+    }
+    vector<vector<RowFields>> batches;
+    for(size_t first = 0; first < rows.size(); first += batchRows){
+        size_t last = min(rows.size(), first + batchRows);
+        batches.emplace_back(rows.begin() + first, rows.begin() + last);
+    }
+    cout << rows.size() << " rows in " << batches.size() << " batches, "
+         << "hardware threads: " << thread::hardware_concurrency() << endl;
+    cout << "threads  seconds  rows/s      speedup" << endl;
+
+    double singleSeconds = 0.0;
+    unique_ptr<ShardedStore> singleStore;
+    for(size_t threadCount = 1; threadCount <= maxThreads; ++threadCount){
+        auto store = make_unique<ShardedStore>();
+        atomic<size_t> nextBatch(0);
+        atomic<bool> failed(false);
+        auto start = chrono::steady_clock::now();
+        vector<thread> writers;
+        for(size_t t = 0; t < threadCount; ++t){
+            writers.emplace_back([&](){
+                for(size_t batch = nextBatch++; batch < batches.size();
+                    batch = nextBatch++){
+                    if(!store->apply(batches[batch])){failed = true;}
+                }
+            });
+        }
+        for(auto& writer:writers){writer.join();}
+        double seconds = chrono::duration<double>(
+                    chrono::steady_clock::now() - start).count();
+        if(failed){
+            cerr << "Error: the input file has an erroneous line" << endl;
+            return EXIT_FAILURE;
+        }
+        if(threadCount == 1){
+            singleSeconds = seconds;
+            singleStore = move(store);
+        }
+        char line[80];
+        snprintf(line, sizeof(line), "%7zu  %7.3f  %10.0f  %6.2f",
+                 threadCount, seconds, rows.size() / seconds,
+                 singleSeconds / seconds);
+        cout << line << endl;
+    }
+
+    Catalog fromStore;
+    fromStore.assign(*singleStore);
+    Catalog fromFile;
+    fromFile.load(path);
+    cout << "catalog from the store matches the file: "
+         << (same_offers(fromStore, fromFile) ? "yes" : "NO") << endl;
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,10 @@
+TEMPLATE = app
+CONFIG += console c++17
+CONFIG -= app_bundle
+CONFIG -= qt
+CONFIG += thread
+
+include(catalog.pri)
+
+SOURCES += \
+        ingestbench.cpp
@@ -0,0 +1,560 @@
+/* Chain stores - catalog directory loader
+ *
+ * Desc:
+ *   Implementation of the concurrent directory loader. See loader.hh.
+ *   Three kinds of threads take part:
+ *   - one reader thread issues the reads (io_uring, or a few blocking
+ *     pread threads as the fallback),
+ *   - parser threads run scan_rows on every file that has been read,
+ *   - the calling thread hands the parsed rows to the consumer in file
+ *     name order and frees each buffer after that.
+ *
+ * Program author
+ * Name: Ruowen Liu
+ * Student number: -
+ * UserID: -
+ * E-Mail: ruowen.liu@tuni.fi
+ * */
+
+#include "loader.hh"
+#include "chainindex.hh"
+#include "compressed.hh"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#define LOADER_IO_URING 1
+#endif
+
+namespace {
+
+//the amount of reads kept in flight at the same time
+const unsigned QUEUE_DEPTH = 64;
+//one read request is never longer than this
+const std::size_t MAX_READ = std::size_t(1) << 30;
+//the reader stops starting new files when this much is waiting for parsing
+const std::size_t BUFFER_BUDGET = std::size_t(256) << 20;
+//scan_rows indexes with 32-bit offsets: a file is swept in pieces of this
+const std::size_t MAX_SCAN = std::size_t(1) << 30;
+
+const char* usedBackend = "threads";
+
+struct CatalogFile {
+    std::string path;
+    int fd = -1;
+    std::size_t size = 0;
+    std::size_t done = 0;
+    std::vector<char> data;
+    std::vector<RowFields> rows;
+    bool cannotRead = false;
+    bool valid = true;
+    bool ready = false;
+    //.gz/.zst: left to load_compressed when its turn comes, not read here
+    bool compressed = false;
+};
+
+//everything the reader, the parsers and the consumer share
+struct LoadState {
+    std::vector<CatalogFile> files;
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::deque<CatalogFile*> toParse;
+    std::size_t bufferedBytes = 0;
+    bool readingDone = false;
+    std::atomic<bool> cancelled{false};
+
+    //a file has been read completely (or failed): give it to the parsers
+    void hand_over(CatalogFile& file){
+        if(file.fd >= 0){
+            ::close(file.fd);
+            file.fd = -1;
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        toParse.push_back(&file);
+        changed.notify_all();
+    }
+
+    //wait until there is room in the buffer budget; false when cancelled
+    bool wait_for_budget(){
+        std::unique_lock<std::mutex> lock(mutex);
+        changed.wait(lock, [this]{
+            return cancelled or bufferedBytes < BUFFER_BUDGET;
+        });
+        return not cancelled;
+    }
+};
+
+/* open the file and allocate its buffer;
+ * false means the file can't be read at all */
+bool prepare(LoadState& state, CatalogFile& file){
+    //nothing to read, thus size 0: the file goes to the parsers as empty
+    if(file.compressed){return true;}
+    file.fd = ::open(file.path.c_str(), O_RDONLY | O_CLOEXEC);
+    struct stat info;
+    if(file.fd < 0 or ::fstat(file.fd, &info) != 0){
+        file.cannotRead = true;
+        return false;
+    }
+    file.size = static_cast<std::size_t>(info.st_size);
+    file.data.resize(file.size);
+    std::lock_guard<std::mutex> lock(state.mutex);
+    state.bufferedBytes += file.size;
+    return true;
+}
+
+//- - - - - - fallback reader: blocking pread on a few threads - - - - - -
+void read_with_threads(LoadState& state){
+    std::atomic<std::size_t> nextFile{0};
+    auto read_files = [&state, &nextFile]{
+        while(not state.cancelled){
+            /* a file is taken only when there is room for it: the files
+             * are consumed in order, thus an earlier file must never wait
+             * for the budget a later one holds */
+            if(not state.wait_for_budget()){return;}
+            std::size_t i = nextFile++;
+            if(i >= state.files.size()){return;}
+            CatalogFile& file = state.files[i];
+            if(prepare(state, file)){
+                while(file.done < file.size){
+                    ssize_t got = ::pread(
+                                file.fd, file.data.data() + file.done,
+                                std::min(file.size - file.done, MAX_READ),
+                                static_cast<off_t>(file.done));
+                    if(got < 0){
+                        file.cannotRead = true;
+                        break;
+                    }
+                    //the file got shorter after fstat
+                    if(got == 0){
+                        file.data.resize(file.done);
+                        break;
+                    }
+                    file.done += static_cast<std::size_t>(got);
+                }
+            }
+            state.hand_over(file);
+        }
+    };
+    unsigned readers = std::min<unsigned>(
+                4, static_cast<unsigned>(state.files.size()));
+    std::vector<std::thread> threads;
+    for(unsigned i = 0; i < readers; ++i){
+        threads.emplace_back(read_files);
+    }
+    for(auto& thread:threads){
+        thread.join();
+    }
+}
+
+#ifdef LOADER_IO_URING
+//- - - - - - io_uring reader - - - - - -
+/* A minimal io_uring wrapper on top of the raw system calls,
+ * thus liburing is not needed. */
+class Uring {
+public:
+    ~Uring(){
+        if(sqRing_ != MAP_FAILED){::munmap(sqRing_, sqRingSize_);}
+        if(cqRing_ != MAP_FAILED and cqRing_ != sqRing_){
+            ::munmap(cqRing_, cqRingSize_);
+        }
+        if(sqes_ != MAP_FAILED){
+            ::munmap(sqes_, params_.sq_entries * sizeof(io_uring_sqe));
+        }
+        if(fd_ >= 0){::close(fd_);}
+    }
+
+    //false if the kernel (or a sandbox) doesn't allow io_uring
+    bool init(unsigned entries){
+        std::memset(&params_, 0, sizeof(params_));
+        fd_ = static_cast<int>(
+                    ::syscall(__NR_io_uring_setup, entries, &params_));
+        if(fd_ < 0){return false;}
+
+        sqRingSize_ = params_.sq_off.array
+                + params_.sq_entries * sizeof(unsigned);
+        cqRingSize_ = params_.cq_off.cqes
+                + params_.cq_entries * sizeof(io_uring_cqe);
+        bool singleMmap = params_.features & IORING_FEAT_SINGLE_MMAP;
+        if(singleMmap){
+            sqRingSize_ = cqRingSize_ = std::max(sqRingSize_, cqRingSize_);
+        }
+        sqRing_ = ::mmap(nullptr, sqRingSize_, PROT_READ | PROT_WRITE,
+                         MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQ_RING);
+        if(sqRing_ == MAP_FAILED){return false;}
+        cqRing_ = singleMmap ? sqRing_
+                             : ::mmap(nullptr, cqRingSize_,
+                                      PROT_READ | PROT_WRITE,
+                                      MAP_SHARED | MAP_POPULATE, fd_,
+                                      IORING_OFF_CQ_RING);
+        if(cqRing_ == MAP_FAILED){return false;}
+        sqes_ = ::mmap(nullptr, params_.sq_entries * sizeof(io_uring_sqe),
+                       PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                       fd_, IORING_OFF_SQES);
+        if(sqes_ == MAP_FAILED){return false;}
+
+        char* sq = static_cast<char*>(sqRing_);
+        char* cq = static_cast<char*>(cqRing_);
+        sqTail_ = reinterpret_cast<unsigned*>(sq + params_.sq_off.tail);
+        sqMask_ = *reinterpret_cast<unsigned*>(sq + params_.sq_off.ring_mask);
+        sqArray_ = reinterpret_cast<unsigned*>(sq + params_.sq_off.array);
+        cqHead_ = reinterpret_cast<unsigned*>(cq + params_.cq_off.head);
+        cqTail_ = reinterpret_cast<unsigned*>(cq + params_.cq_off.tail);
+        cqMask_ = *reinterpret_cast<unsigned*>(cq + params_.cq_off.ring_mask);
+        cqes_ = reinterpret_cast<io_uring_cqe*>(cq + params_.cq_off.cqes);
+        return true;
+    }
+
+    //queue one read; it is sent to the kernel by submit_and_wait
+    void queue_read(int fd, char* buffer, unsigned length,
+                    std::uint64_t offset, std::uint64_t userData){
+        unsigned tail = *sqTail_;
+        unsigned slot = tail & sqMask_;
+        io_uring_sqe& sqe = static_cast<io_uring_sqe*>(sqes_)[slot];
+        std::memset(&sqe, 0, sizeof(sqe));
+        sqe.opcode = IORING_OP_READ;
+        sqe.fd = fd;
+        sqe.addr = reinterpret_cast<std::uint64_t>(buffer);
+        sqe.len = length;
+        sqe.off = offset;
+        sqe.user_data = userData;
+        sqArray_[slot] = slot;
+        __atomic_store_n(sqTail_, tail + 1, __ATOMIC_RELEASE);
+        ++toSubmit_;
+    }
+
+    //send the queued reads and wait for at least one completion
+    bool submit_and_wait(){
+        int result = static_cast<int>(
+                    ::syscall(__NR_io_uring_enter, fd_, toSubmit_, 1,
+                              IORING_ENTER_GETEVENTS, nullptr, 0));
+        if(result < 0 and errno != EINTR){return false;}
+        if(result > 0){toSubmit_ -= static_cast<unsigned>(result);}
+        return true;
+    }
+
+    //take one completion if there is any
+    bool next_completion(io_uring_cqe& completion){
+        unsigned head = *cqHead_;
+        if(head == __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE)){
+            return false;
+        }
+        completion = cqes_[head & cqMask_];
+        __atomic_store_n(cqHead_, head + 1, __ATOMIC_RELEASE);
+        return true;
+    }
+
+private:
+    int fd_ = -1;
+    io_uring_params params_;
+    void* sqRing_ = MAP_FAILED;
+    void* cqRing_ = MAP_FAILED;
+    void* sqes_ = MAP_FAILED;
+    std::size_t sqRingSize_ = 0;
+    std::size_t cqRingSize_ = 0;
+    unsigned* sqTail_ = nullptr;
+    unsigned sqMask_ = 0;
+    unsigned* sqArray_ = nullptr;
+    unsigned* cqHead_ = nullptr;
+    unsigned* cqTail_ = nullptr;
+    unsigned cqMask_ = 0;
+    io_uring_cqe* cqes_ = nullptr;
+    unsigned toSubmit_ = 0;
+};
+
+//ask for the rest of the file
+void queue_rest(Uring& ring, CatalogFile& file, std::size_t index){
+    unsigned length = static_cast<unsigned>(
+                std::min(file.size - file.done, MAX_READ));
+    ring.queue_read(file.fd, file.data.data() + file.done, length,
+                    file.done, index);
+}
+
+//false if io_uring can't be used; nothing has been read in that case
+bool read_with_uring(LoadState& state){
+    Uring ring;
+    if(not ring.init(QUEUE_DEPTH)){return false;}
+
+    std::size_t nextFile = 0;
+    unsigned inFlight = 0;
+    /* After a cancel no new reads are started, but the ones in flight
+     * must still complete: the kernel writes to the buffers until then. */
+    while(inFlight > 0
+            or (not state.cancelled and nextFile < state.files.size())){
+        //keep the queue full, as long as the buffer budget allows
+        while(not state.cancelled and inFlight < QUEUE_DEPTH
+                and nextFile < state.files.size()){
+            {
+                std::unique_lock<std::mutex> lock(state.mutex);
+                if(state.bufferedBytes >= BUFFER_BUDGET){
+                    //nothing to wait for from the kernel ==> wait parsers
+                    if(inFlight > 0){break;}
+                    state.changed.wait(lock, [&state]{
+                        return state.cancelled
+                                or state.bufferedBytes < BUFFER_BUDGET;
+                    });
+                    if(state.cancelled){break;}
+                }
+            }
+            CatalogFile& file = state.files[nextFile];
+            if(prepare(state, file) and file.size > 0){
+                queue_rest(ring, file, nextFile);
+                ++inFlight;
+            }
+            //empty or unreadable files need no reading
+            else{
+                state.hand_over(file);
+            }
+            ++nextFile;
+        }
+        if(inFlight == 0){continue;}
+        if(not ring.submit_and_wait()){
+            //the ring broke down in the middle: give up on the rest
+            state.cancelled = true;
+            for(auto& file:state.files){
+                if(file.fd >= 0){
+                    file.cannotRead = true;
+                    state.hand_over(file);
+                }
+            }
+            return true;
+        }
+        io_uring_cqe completion;
+        while(ring.next_completion(completion)){
+            std::size_t index = static_cast<std::size_t>(
+                        completion.user_data);
+            CatalogFile& file = state.files[index];
+            if(completion.res < 0){
+                file.cannotRead = true;
+            }
+            //the file got shorter after fstat
+            else if(completion.res == 0){
+                file.data.resize(file.done);
+            }
+            else{
+                file.done += static_cast<std::size_t>(completion.res);
+                //a short read: ask again for the rest
+                if(file.done < file.size and not state.cancelled){
+                    queue_rest(ring, file, index);
+                    continue;
+                }
+            }
+            --inFlight;
+            state.hand_over(file);
+        }
+    }
+    return true;
+}
+#endif
+
+//- - - - - - parser threads - - - - - -
+/* scan_rows on the whole file, in pieces of at most MAX_SCAN bytes each
+ * ending after a line break; false if erroneous, or if a line alone is
+ * longer than a piece */
+bool scan_file(const std::vector<char>& data, StructuralIndex& index,
+               std::vector<RowFields>& rows){
+    const char* begin = data.data();
+    const char* end = begin + data.size();
+    while(static_cast<std::size_t>(end - begin) > MAX_SCAN){
+        auto pieceEnd = std::reverse_iterator<const char*>(begin + MAX_SCAN);
+        auto lastBreak = std::find(pieceEnd,
+                                   std::reverse_iterator<const char*>(begin),
+                                   '\n');
+        if(lastBreak.base() == begin){return false;}
+        std::size_t size = static_cast<std::size_t>(lastBreak.base() - begin);
+        if(not scan_rows(begin, size, index, rows)){return false;}
+        begin += size;
+    }
+    return scan_rows(begin, static_cast<std::size_t>(end - begin), index,
+                     rows);
+}
+
+void parse_files(LoadState& state){
+    StructuralIndex index;
+    while(true){
+        CatalogFile* file = nullptr;
+        {
+            std::unique_lock<std::mutex> lock(state.mutex);
+            state.changed.wait(lock, [&state]{
+                return state.cancelled or not state.toParse.empty()
+                        or state.readingDone;
+            });
+            if(state.cancelled or state.toParse.empty()){return;}
+            file = state.toParse.front();
+            state.toParse.pop_front();
+        }
+        if(not file->cannotRead){
+            file->valid = scan_file(file->data, index, file->rows);
+        }
+        std::lock_guard<std::mutex> lock(state.mutex);
+        file->ready = true;
+        state.changed.notify_all();
+    }
+}
+
+} // namespace
+
+LoadStatus load_directory(const std::string& path,
+                          const RowConsumer& consume){
+    LoadState state;
+    std::error_code error;
+    for(auto& entry:std::filesystem::directory_iterator(path, error)){
+        //the sidecar of a file loaded with --lazy is not catalog text
+        if(entry.is_regular_file(error)
+                and not is_chain_index_path(entry.path().string())){
+            state.files.push_back({});
+            state.files.back().path = entry.path().string();
+            state.files.back().compressed = is_compressed_feed(
+                        state.files.back().path);
+        }
+    }
+    if(error){return LoadStatus::CANNOT_OPEN;}
+    //directory order is arbitrary; the loading order must not be
+    std::sort(state.files.begin(), state.files.end(),
+              [](const CatalogFile& a, const CatalogFile& b){
+        return a.path < b.path;
+    });
+
+    std::thread reader([&state]{
+#ifdef LOADER_IO_URING
+        if(read_with_uring(state)){
+            usedBackend = "io_uring";
+        }
+        else{
+            usedBackend = "threads";
+            read_with_threads(state);
+        }
+#else
+        usedBackend = "threads";
+        read_with_threads(state);
+#endif
+        std::lock_guard<std::mutex> lock(state.mutex);
+        state.readingDone = true;
+        state.changed.notify_all();
+    });
+    unsigned parserAmount = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<std::thread> parsers;
+    for(unsigned i = 0; i < parserAmount; ++i){
+        parsers.emplace_back(parse_files, std::ref(state));
+    }
+
+    //hand the files to the consumer in order, as soon as each is parsed
+    LoadStatus status = LoadStatus::SUCCESS;
+    for(auto& file:state.files){
+        {
+            std::unique_lock<std::mutex> lock(state.mutex);
+            state.changed.wait(lock, [&file]{return file.ready;});
+        }
+        if(file.cannotRead){status = LoadStatus::CANNOT_OPEN;}
+        //decompressed and parsed here, while the next files are read
+        else if(file.compressed){status = load_compressed(file.path, consume);}
+        else if(not file.valid or not consume(file.rows)){
+            status = LoadStatus::ERRONEOUS_LINE;
+        }
+        //the rows point into the data, thus both go at the same time
+        std::vector<char>().swap(file.data);
+        std::vector<RowFields>().swap(file.rows);
+        std::lock_guard<std::mutex> lock(state.mutex);
+        state.bufferedBytes -= file.size;
+        if(status != LoadStatus::SUCCESS){state.cancelled = true;}
+        state.changed.notify_all();
+        if(status != LoadStatus::SUCCESS){break;}
+    }
+
+    reader.join();
+    for(auto& parser:parsers){
+        parser.join();
+    }
+    return status;
+}
+
+LoadStatus load_file_blocks(const std::string& path, std::uint64_t begin,
+                            std::uint64_t end, const BlockConsumer& consume){
+    std::ifstream file(path, std::ios::binary);
+    if(not file){return LoadStatus::CANNOT_OPEN;}
+    if(begin != 0){file.seekg(static_cast<std::streamoff>(begin));}
+    const std::size_t blockSize = std::size_t(1) << 20;
+    std::vector<char> buffer(blockSize);
+    //amount of bytes of an unfinished line carried over from last block
+    std::size_t carried = 0;
+    //position of the buffer in the file
+    std::uint64_t offset = begin;
+    StructuralIndex index;
+    std::vector<RowFields> rows;
+    while(true){
+        std::size_t wanted = buffer.size() - carried;
+        std::uint64_t left = end - offset - carried;
+        if(left < wanted){wanted = static_cast<std::size_t>(left);}
+        file.read(buffer.data() + carried,
+                  static_cast<std::streamsize>(wanted));
+        std::size_t filled = carried + static_cast<std::size_t>(file.gcount());
+        bool atEnd = not file or offset + filled == end;
+        //only complete lines are scanned, unless the file has ended
+        std::size_t usable = filled;
+        if(not atEnd){
+            auto filledEnd = buffer.rend()
+                    - static_cast<std::ptrdiff_t>(filled);
+            auto lastBreak = std::find(filledEnd, buffer.rend(), '\n');
+            //one line longer than the buffer ==> make the buffer bigger
+            if(lastBreak == buffer.rend()){
+                carried = filled;
+                buffer.resize(buffer.size() * 2);
+                continue;
+            }
+            usable = static_cast<std::size_t>(buffer.rend() - lastBreak);
+        }
+        rows.clear();
+        if(not scan_rows(buffer.data(), usable, index, rows)
+                or not consume(offset, buffer.data(), usable, rows)){
+            return LoadStatus::ERRONEOUS_LINE;
+        }
+        if(atEnd){break;}
+        //move the unfinished line to the front of the buffer
+        carried = filled - usable;
+        offset += usable;
+        std::copy(buffer.begin() + static_cast<std::ptrdiff_t>(usable),
+                  buffer.begin() + static_cast<std::ptrdiff_t>(filled),
+                  buffer.begin());
+    }
+    return LoadStatus::SUCCESS;
+}
+
+LoadStatus load_file(const std::string& path, const RowConsumer& consume){
+    return load_file_blocks(path, 0, UINT64_MAX,
+                            [&consume](std::uint64_t, const char*,
+                                       std::size_t,
+                                       const std::vector<RowFields>& rows){
+        return consume(rows);
+    });
+}
+
+LoadStatus load_input(const std::string& path, const RowConsumer& consume){
+    /* a catalog split into many files: read them all concurrently;
+     * a compressed feed: decompress and parse at the same time */
+    if(std::filesystem::is_directory(path)){
+        return load_directory(path, consume);
+    }
+    if(is_compressed_feed(path)){
+        return load_compressed(path, consume);
+    }
+    return load_file(path, consume);
+}
+
+const char* loader_backend(){
+    return usedBackend;
+}
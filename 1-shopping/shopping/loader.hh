@@ -0,0 +1,101 @@
+/* Chain stores - catalog directory loader
+ *
+ * Desc:
+ *   When the catalog is split into many files (e.g. one per store), the
+ * files of the directory are read concurrently instead of one after the
+ * other. On Linux the reads are issued through io_uring; where io_uring
+ * is not available a small pool of reader threads is used instead.
+ *   A file that has been read completely is handed to a pool of parser
+ * threads right away, so reading and parsing overlap. The parsed rows are
+ * given back to the caller one file at a time, in the alphabetical order
+ * of the file names, thus a later file rewrites the prices of an earlier
+ * one the same way as a later line of a single file does.
+ *
+ * Program author
+ * Name: Ruowen Liu
+ * Student number: -
+ * UserID: -
+ * E-Mail: ruowen.liu@tuni.fi
+ * */
+
+#ifndef LOADER_HH
+#define LOADER_HH
+
+#include "scanner.hh"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+//the result of loading a directory
+enum class LoadStatus {
+    SUCCESS,
+    CANNOT_OPEN,
+    ERRONEOUS_LINE,
+    //the file changed after its chain index was made (see chainindex.hh)
+    FILE_CHANGED
+};
+
+/* Called on the calling thread for the rows of each file in turn.
+ * Returning false stops the loading (the rows were not acceptable). */
+using RowConsumer = std::function<bool(const std::vector<RowFields>& rows)>;
+
+/**
+ * @brief load_directory - read and parse all the regular files
+ *        of a directory concurrently (not the .chainidx sidecars); a
+ *        .gz/.zst file goes through load_compressed in its turn
+ * @param path           - the directory
+ * @param consume        - receives the rows of every file, in file name order
+ * @return SUCCESS, or the first problem found
+ */
+LoadStatus load_directory(const std::string& path,
+                          const RowConsumer& consume);
+
+/* Called for every block of complete lines read by load_file_blocks: the
+ * position of the block in the file, the block and the rows in it (views
+ * into the block). Returning false stops the loading. */
+using BlockConsumer = std::function<bool(std::uint64_t offset,
+                                         const char* block, std::size_t size,
+                                         const std::vector<RowFields>& rows)>;
+
+/**
+ * @brief load_file - read and parse one input file in big blocks, each
+ *        cut after its last line break and swept by scan_rows
+ * @param path      - the input file
+ * @param consume   - receives the rows of every block in turn
+ * @return SUCCESS, or the first problem found
+ */
+LoadStatus load_file(const std::string& path, const RowConsumer& consume);
+
+/**
+ * @brief load_file_blocks - like load_file, for the bytes [begin, end) of
+ *        the file only, which must start and end at line boundaries
+ *        (end can be past the end of the file)
+ * @param path      - the input file
+ * @param begin     - where to start reading
+ * @param end       - where to stop reading
+ * @param consume   - receives every block and its rows in turn
+ * @return SUCCESS, or the first problem found
+ */
+LoadStatus load_file_blocks(const std::string& path, std::uint64_t begin,
+                            std::uint64_t end, const BlockConsumer& consume);
+
+/**
+ * @brief load_input - read whatever the user named as the input: a
+ *        directory (load_directory), a .gz/.zst file (load_compressed,
+ *        see compressed.hh) or a plain file (load_file)
+ * @param path       - the input name
+ * @param consume    - receives the rows, in the order of the input
+ * @return SUCCESS, or the first problem found
+ */
+LoadStatus load_input(const std::string& path, const RowConsumer& consume);
+
+/**
+ * @brief loader_backend - name of the reading method the last
+ *        load_directory call used ("io_uring" or "threads")
+ */
+const char* loader_backend();
+
+#endif // LOADER_HH
@@ -0,0 +1,359 @@
+/* Chain stores - loader test
+ *
+ * Desc:
+ *   Checks that the concurrent ways of reading the input give the same
+ * rows, in the same order, as reading one plain file line by line does.
+ * The input is generated into a temporary directory: many files of very
+ * different sizes (some empty, some of several read blocks), and their
+ * concatenation as one plain file, which is the reference. The plain file
+ * is also compressed with gzip (when built with HAVE_ZLIB), to check the
+ * decompress/parse pipeline of compressed.hh, also for .gz files in a
+ * directory among plain ones. A directory must load the same after a file
+ * in it was loaded with --lazy, which writes a sidecar next to the file
+ * (see chainindex.hh). Last, the price ranges of a small catalog are
+ * checked with limits of -1 and below, as -1.0 is the price of the
+ * out-of-stock offers.
+ *   Usage: loadertest
+ * Every check prints "PASS <name>" or "FAIL <name>: <what differed>";
+ * the exit status is EXIT_FAILURE if any check failed.
+ *
+ * Program author
+ * Name: Ruowen Liu
+ * Student number: -
+ * UserID: -
+ * E-Mail: ruowen.liu@tuni.fi
+ * */
+
+#include "catalog.hh"
+#include "chainindex.hh"
+#include "loader.hh"
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+#include <algorithm>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+const size_t FILES = 150;
+//a few files are this big, more than one block of load_file
+const size_t BIG_FILE_ROWS = 120000;
+
+int failures = 0;
+
+void report(const string& name, bool passed, const string& what = ""){
+    if(passed){cout << "PASS " << name << endl;}
+    else{
+        cout << "FAIL " << name << ": " << what << endl;
+        ++failures;
+    }
+}
+
+//one random input line; the same seed gives the same lines
+string random_line(mt19937& random){
+    uniform_int_distribution<int> chain(0, 6);
+    uniform_int_distribution<int> store(0, 29);
+    uniform_int_distribution<int> product(0, 499);
+    uniform_int_distribution<int> cents(1, 2000);
+    string price = "out-of-stock";
+    if(random() % 10 != 0){
+        int value = cents(random);
+        price = to_string(value / 100) + "." + to_string(value % 100 / 10)
+                + to_string(value % 10);
+    }
+    return "Chain" + to_string(chain(random)) + ";Store"
+            + to_string(store(random)) + ";product" + to_string(product(random))
+            + ";" + price + "\n";
+}
+
+/* Write the files of the directory and their concatenation (in the order
+ * of the file names, the order load_directory gives them in) */
+void write_input(const filesystem::path& directory,
+                 const filesystem::path& concatenated){
+    mt19937 random(2024);
+    vector<string> contents(FILES);
+    for(size_t file = 0; file < FILES; ++file){
+        size_t rows = random() % 400;
+        if(file % 10 == 0){rows = 0;}
+        if(file % 37 == 5){rows = BIG_FILE_ROWS;}
+        for(size_t row = 0; row < rows; ++row){
+            contents[file] += random_line(random);
+        }
+    }
+    vector<string> names;
+    for(size_t file = 0; file < FILES; ++file){
+        //the names are not written in the order of the files
+        names.push_back("part" + to_string(1000 + (file * 7919) % FILES));
+    }
+    vector<size_t> order(FILES);
+    for(size_t file = 0; file < FILES; ++file){
+        ofstream(directory / names[file], ios::binary) << contents[file];
+        order[file] = file;
+    }
+    sort(order.begin(), order.end(), [&names](size_t a, size_t b){
+        return names[a] < names[b];
+    });
+    ofstream all(concatenated, ios::binary);
+    for(size_t file:order){all << contents[file];}
+}
+
+//the rows of an input, each as "chain;store;product;price"
+LoadStatus read_rows(const string& path, vector<string>& rows){
+    rows.clear();
+    return load_input(path, [&rows](const vector<RowFields>& lines){
+        for(auto& line:lines){
+            rows.push_back(string(line.chain) + ";" + string(line.store)
+                           + ";" + string(line.product) + ";"
+                           + string(line.price));
+        }
+        return true;
+    });
+}
+
+//where the two row lists first differ, "" if they are the same
+string first_difference(const vector<string>& rows,
+                        const vector<string>& expected){
+    for(size_t row = 0; row < rows.size() and row < expected.size(); ++row){
+        if(rows[row] != expected[row]){
+            return "row " + to_string(row) + " is " + rows[row]
+                    + ", expected " + expected[row];
+        }
+    }
+    if(rows.size() != expected.size()){
+        return to_string(rows.size()) + " rows, expected "
+                + to_string(expected.size());
+    }
+    return "";
+}
+
+//true if the two catalogs have the same offers (as in ingestbench)
+bool same_offers(const Catalog& a, const Catalog& b){
+    const OfferColumns& columnsA = a.columns();
+    const OfferColumns& columnsB = b.columns();
+    if(columnsA.price.size() != columnsB.price.size()){return false;}
+    for(size_t row = 0; row < columnsA.price.size(); ++row){
+        if(a.name(a.chain_name(columnsA.chain[row]))
+                != b.name(b.chain_name(columnsB.chain[row]))
+                or a.name(a.store_name(columnsA.store[row]))
+                != b.name(b.store_name(columnsB.store[row]))
+                or a.name(a.product_name(columnsA.product[row]))
+                != b.name(b.product_name(columnsB.product[row]))
+                or columnsA.price[row] != columnsB.price[row]){
+            return false;
+        }
+    }
+    return true;
+}
+
+//load_directory (concurrent reads and parsing) against the plain file
+void test_directory(const filesystem::path& directory,
+                    const vector<string>& expected, const string& plain){
+    vector<string> rows;
+    LoadStatus status = read_rows(directory.string(), rows);
+    string name = string("directory (") + loader_backend() + ")";
+    if(status != LoadStatus::SUCCESS){
+        report(name, false, "not loaded");
+        return;
+    }
+    report(name, first_difference(rows, expected).empty(),
+           first_difference(rows, expected));
+
+    Catalog fromDirectory;
+    Catalog fromFile;
+    bool loaded = fromDirectory.load(directory.string()) == LoadStatus::SUCCESS
+            and fromFile.load(plain) == LoadStatus::SUCCESS;
+    report("directory catalog", loaded and same_offers(fromDirectory,
+                                                       fromFile),
+           "the offers differ from the ones of the plain file");
+}
+
+#ifdef HAVE_ZLIB
+//write a file compressed with gzip; false if it can't be written
+bool write_gzip(const filesystem::path& plain, const string& compressed){
+    ifstream input(plain, ios::binary);
+    gzFile output = gzopen(compressed.c_str(), "wb");
+    if(output == nullptr){return false;}
+    vector<char> buffer(1 << 16);
+    while(input.read(buffer.data(), buffer.size()) or input.gcount() > 0){
+        gzwrite(output, buffer.data(), static_cast<unsigned>(input.gcount()));
+    }
+    return gzclose(output) == Z_OK;
+}
+#endif
+
+//a .gz of the plain file (many ring buffers of data) against the file
+void test_gzip(const filesystem::path& plain, const vector<string>& expected){
+#ifdef HAVE_ZLIB
+    string compressed = plain.string() + ".gz";
+    if(not write_gzip(plain, compressed)){
+        report("gzip", false, "cannot write " + compressed);
+        return;
+    }
+
+    vector<string> rows;
+    if(read_rows(compressed, rows) != LoadStatus::SUCCESS){
+        report("gzip", false, "not loaded");
+        return;
+    }
+    report("gzip", first_difference(rows, expected).empty(),
+           first_difference(rows, expected));
+#else
+    (void)plain;
+    (void)expected;
+    cout << "SKIP gzip: built without HAVE_ZLIB" << endl;
+#endif
+}
+
+//a directory of plain and .gz files against their plain concatenation
+void test_compressed_directory(const filesystem::path& root){
+#ifdef HAVE_ZLIB
+    filesystem::path directory = root / "mixed";
+    filesystem::create_directories(directory);
+    filesystem::path plain = root / "mixed.txt";
+    mt19937 random(11);
+    {
+        ofstream all(plain, ios::binary);
+        for(string name:{"part1", "part2.gz", "part3", "part4.gz"}){
+            filesystem::path part = directory / name;
+            string written = part.string();
+            if(name.size() > 3 and name.substr(name.size() - 3) == ".gz"){
+                part = root / "part.tmp";
+            }
+            {
+                ofstream file(part, ios::binary);
+                for(int row = 0; row < 30000; ++row){
+                    string line = random_line(random);
+                    file << line;
+                    all << line;
+                }
+            }
+            if(part.string() != written
+                    and not write_gzip(part, written)){
+                report("compressed in a directory", false,
+                       "cannot write " + written);
+                return;
+            }
+        }
+    }
+    vector<string> rows;
+    vector<string> expected;
+    if(read_rows(directory.string(), rows) != LoadStatus::SUCCESS
+            or read_rows(plain.string(), expected) != LoadStatus::SUCCESS){
+        report("compressed in a directory", false, "not loaded");
+        return;
+    }
+    report("compressed in a directory",
+           first_difference(rows, expected).empty(),
+           first_difference(rows, expected));
+#else
+    (void)root;
+    cout << "SKIP compressed in a directory: built without HAVE_ZLIB" << endl;
+#endif
+}
+
+//a directory holding a file loaded with --lazy, and thus its sidecar
+void test_lazy_directory(const filesystem::path& root){
+    filesystem::path directory = root / "lazy";
+    filesystem::create_directories(directory);
+    filesystem::path path = directory / "a.csv";
+    mt19937 random(7);
+    {
+        ofstream file(path, ios::binary);
+        for(int row = 0; row < 1000; ++row){file << random_line(random);}
+    }
+    Catalog lazy;
+    if(lazy.load_lazy(path.string()) != LoadStatus::SUCCESS
+            or not filesystem::exists(chain_index_path(path.string()))){
+        report("directory after a lazy load", false, "no sidecar written");
+        return;
+    }
+    Catalog fromDirectory;
+    Catalog fromFile;
+    LoadStatus status = fromDirectory.load(directory.string());
+    report("directory after a lazy load", status == LoadStatus::SUCCESS
+           and fromFile.load(path.string()) == LoadStatus::SUCCESS
+           and same_offers(fromDirectory, fromFile),
+           status == LoadStatus::SUCCESS ? "the offers differ"
+                                         : "the sidecar was loaded");
+}
+
+//the product names of a price range, as "name price" separated by ','
+string range_names(const Catalog& catalog, StoreId store, double lowest,
+                   double highest){
+    string names = "";
+    for(const Offer& offer:catalog.price_range(store, lowest, highest)){
+        names += (names.empty() ? "" : ",")
+                + string(catalog.name(offer.product)) + " "
+                + to_string(offer.price).substr(0, 4);
+    }
+    return names;
+}
+
+//price limits of -1 and below: -1.0 stands for out of stock only in data
+void test_price_limits(const filesystem::path& root){
+    filesystem::path path = root / "limits.txt";
+    ofstream(path, ios::binary) << "Prisma;Kaleva;milk;0.95\n"
+                                   "Prisma;Kaleva;bread;1.20\n"
+                                   "Prisma;Kaleva;juice;out-of-stock\n";
+    Catalog catalog;
+    ChainId chain = 0;
+    StoreId store = 0;
+    if(catalog.load(path.string()) != LoadStatus::SUCCESS
+            or not catalog.find_chain("Prisma", chain)
+            or not catalog.find_store(chain, "Kaleva", store)){
+        report("price limits", false, "not loaded");
+        return;
+    }
+    struct Case {double lowest; double highest; string expected;};
+    vector<Case> cases = {
+        {0.0, -1.0, ""}, {-5.0, -1.0, ""}, {-1.0, -1.0, ""},
+        {-1.0, 5.0, "milk 0.95,bread 1.20"}, {-5.0, 1.0, "milk 0.95"},
+        {0.95, 1.20, "milk 0.95,bread 1.20"}, {1.0, 100.0, "bread 1.20"}};
+    for(const Case& limits:cases){
+        string names = range_names(catalog, store, limits.lowest,
+                                   limits.highest);
+        ostringstream name;
+        name << "price limits " << limits.lowest << " " << limits.highest;
+        report(name.str(), names == limits.expected,
+               "got \"" + names + "\", expected \"" + limits.expected + "\"");
+    }
+}
+
+} // namespace
+
+int main(){
+    filesystem::path root = filesystem::temp_directory_path()
+            / "shopping-loadertest";
+    filesystem::remove_all(root);
+    filesystem::path directory = root / "parts";
+    filesystem::create_directories(directory);
+    filesystem::path plain = root / "all.txt";
+    write_input(directory, plain);
+
+    //the reference: one plain file, read block by block on this thread
+    vector<string> expected;
+    if(read_rows(plain.string(), expected) != LoadStatus::SUCCESS){
+        report("plain file", false, "not loaded");
+    }
+    else{
+        test_directory(directory, expected, plain.string());
+        test_gzip(plain, expected);
+    }
+    test_compressed_directory(root);
+    test_lazy_directory(root);
+    test_price_limits(root);
+
+    filesystem::remove_all(root);
+    return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -6,14 +6,33 @@
  * chain_store;store_location;product_name;product_price.
  * The program checks if each line consists of the abovementioned four
  * data fields.
- *   The data written in the file is collected into an appropriate data
- * structure consisting of STL containers and structs. After that the user
- * can make searches for the data structure by using the commands
- * chains, stores, selection, cheapest, and products. These commands
- * have a varying number of parameters, and the program checks if the
- * user gave a correct number of parameters and if the given parameters
- * (chain store, store location, product name) can be found from the data
- * structure.
+ *   The data written in the file is collected into a catalog (see
+ * catalog.hh, which can also be used without this front end). After that
+ * the user can make searches for the catalog by using the commands
+ * chains, stores, selection, cheapest, cheapest-all, products, range,
+ * and under, and ask other questions with the command query (see
+ * query.hh). The command export writes the catalog to a file for
+ * analytics tools (see export.hh).
+ *   The commands watch, update and apply keep the catalog up to date
+ * and tell when a watched product gets cheap or back in stock (see
+ * watch.hh).
+ *   The command load reads another input file (e.g. of another region)
+ * into a catalog of its own, and use switches between the catalogs; the
+ * first one is called default. The catalogs share their names and the
+ * equal assortments of their stores (see CatalogShare in catalog.hh).
+ * Started with --format=json or --format=tsv, the results are printed
+ * for other programs instead of people (see output.hh).
+ * Started with --diff <old file> <new file>, the program prints the
+ * changes between two input files instead (see diff.hh).
+ * Started with --record <log file>, the commands are also written to a
+ * log for the replay tool (see querylog.hh).
+ * Started with --lazy, only the places of the chains in the input file
+ * are found before the first prompt; the lines of a chain are read when
+ * a command first needs them (see Catalog::load_lazy).
+ * These commands have a varying number of parameters, and the program
+ * checks if the user gave a correct number of parameters and if the given
+ * parameters (chain store, store location, product name) can be found
+ * from the catalog.
  *   The program terminates with the command quit.
  *
  * Program author
@@ -27,39 +46,50 @@
  * */
 
 #include <iostream>
-#include <fstream>
 #include <sstream>
-#include <cstring>
 #include <iomanip>
-#include <map>
+#include <string>
 #include <vector>
-#include <set>
-#include <algorithm>
+#include <map>
+#include <memory>
+
+#include "catalog.hh"
+#include "output.hh"
+#include "diff.hh"
+#include "query.hh"
+#include "export.hh"
+#include "watch.hh"
+#include "querylog.hh"
 
 using namespace std;
 
-struct Product {
-    string product_name;
-    double price;
-};
-/* The data structure here is used to steore all the data from the csv file.
- * It can be interpreted in this way:
- * map<chainName,
- *      map<locationName,
- *              map<eachProduct.product_name, eachProduct> > >
- * */
-using MarketData = map<string, map<string, map<string, Product> > >;
 /**
- * @brief read_success - read csv file inside the function
- *        and store the data to the datasets;
+ * @brief read_success - ask the name of the input file and load it
+ *        to the catalog; when the given name is a directory, every file
+ *        in it is read (see loader.hh), and .gz/.zst files are
+ *        decompressed on the fly (see compressed.hh);
  *        meanwhile, it print out the error message
  *        when the file failed opened or when data missing
- * @param allData      - all data read from csv file
- * @param productList  - the dataset for only product names
+ * @param catalog      - where all the data goes
+ * @param lazy         - only index the chains (--lazy)
+ * @param out          - where the prompt and the error messages go
  * @return a boolean value telling the status of reading result;
  *         only when error or data-missing happens, return false
  */
-bool read_success(MarketData& allData, set<string>& productList);
+bool read_success(Catalog& catalog, bool lazy, Output& out);
+/**
+ * @brief read_needed_chains - with --lazy, read the chains a command needs
+ *        before running it: stores, selection, range and under need the
+ *        chain given, chains needs none, and the other commands all of
+ *        them (cheapest too, as any chain can sell the product)
+ * @param catalog            - where the chains are read
+ * @param command            - the stem of the command
+ * @param cmd_1              - the 1st variable to the command
+ * @param out                - where the error messages go
+ * @return false if the input file can't be read any more
+ */
+bool read_needed_chains(Catalog& catalog, const string& command,
+                        const string& cmd_1, Output& out);
 /**
  * @brief read_cmd_and_varNum - read command from user;
  *        split the command by the space;
@@ -76,52 +106,127 @@ bool read_success(MarketData& allData, set<string>& productList);
  *        identified as the 1st variable to the command
  * @param cmd_2      - 3rd part without space in the string;
  *        identified as the 2nd variable to the command
- * @param cmd_border - 4th part without space in the string;
+ * @param cmd_border - the rest of the line after cmd_2;
  *        identified as the unwanted variable to the command
- *        (max 2 variables needed)
+ *        (max 2 variables needed), except for range and under,
+ *        which read their price limits from here
+ * @param log        - where the line is recorded (if recording)
  * @return the amount of variable to one command
  */
 int read_cmd_and_varNum(string& cmd_0,
-                        string& cmd_1, string& cmd_2, string& cmd_border);
+                        string& cmd_1, string& cmd_2, string& cmd_border,
+                        QueryLog& log);
 /**
- * @brief find_cheapest_price - based on all the data,
- *        with given target product name,
- *        the func. searches the lowest price
- *        and record the store list for the location
- *        where the target product set with the lowest price
- * @param allData             - all data read from csv file
- * @param cheapestList        - a vector made with pair<chainName, location>
- * @param productName         - product we are searching for the lowset price
- * @return the lowest price we found; if all out-of-stock, return -1.0
- *         for identifying
+ * @brief read_price - convert a price limit given by the user
+ * @param priceStr   - e.g. "2" or "2.50"
+ * @param price      - the converted value
+ * @return false if priceStr is not a whole number
  */
-double find_cheapest_price(MarketData& allData,
-                           vector<pair<string, string> >& cheapestList,
-                           string productName);
+bool read_price(const string& priceStr, double& price);
 
 //cmds using no variable
-void products_print(set<string>& allProducts, int amountOfVar);
-void chains_print(MarketData& allDataStored, int amountOfVar);
+void products_print(const Catalog& catalog, int amountOfVar, Output& out);
+void chains_print(const Catalog& catalog, int amountOfVar, Output& out);
+void cheapest_all_print(const Catalog& catalog, int amountOfVar,
+                        Output& out);
 //cmds using only 1 variable
-void stores_print(MarketData& allDataStored, string cmd_1, int amountOfVar);
-void cheapest_print(MarketData& allDataStored, set<string>& allProducts,
-                    string cmd_1, int amountOfVar);
+void stores_print(const Catalog& catalog, string cmd_1, int amountOfVar,
+                  Output& out);
+void cheapest_print(const Catalog& catalog, string cmd_1, int amountOfVar,
+                    Output& out);
+void export_print(const Catalog& catalog, string cmd_1, int amountOfVar,
+                  Output& out);
 //cmd using 2 variables
-void selection_print(MarketData& allDataStored,
-                     string cmd_1, string cmd_2, int amountOfVar);
+void selection_print(const Catalog& catalog,
+                     string cmd_1, string cmd_2, int amountOfVar,
+                     Output& out);
+//cmds using price limits (3 or 4 variables)
+void range_print(const Catalog& catalog, string cmd_1, string cmd_2,
+                 string cmd_border, int amountOfVar, Output& out);
+void under_print(const Catalog& catalog, string cmd_1, string cmd_2,
+                 string cmd_border, int amountOfVar, Output& out);
+//cmd using any number of variables
+void query_print(const Catalog& catalog, string cmd_1, string cmd_2,
+                 string cmd_border, Output& out);
+//cmds keeping the catalog up to date
+void watch_print(const Catalog& catalog, Watches& watches, string cmd_1,
+                 string cmd_2, string cmd_border, int amountOfVar,
+                 Output& out);
+void update_print(Catalog& catalog, const Watches& watches, string cmd_1,
+                  string cmd_2, string cmd_border, int amountOfVar,
+                  Output& out);
+void apply_print(Catalog& catalog, const Watches& watches, string cmd_1,
+                 int amountOfVar, Output& out);
+
+//a catalog of the process, and the watches on it
+struct NamedCatalog {
+    unique_ptr<Catalog> catalog;
+    Watches watches;
+};
+//cmds choosing the catalog
+void load_print(map<string, NamedCatalog>& catalogs,
+                const shared_ptr<CatalogShare>& share, bool lazy,
+                string cmd_1, string cmd_2, int amountOfVar, Output& out);
+void use_print(map<string, NamedCatalog>& catalogs, NamedCatalog*& current,
+               string cmd_1, int amountOfVar, Output& out);
 
 //a test function; print all the data formatted. Not required in this project.
-void print_all(MarketData& allData);
+void print_all(const Catalog& catalog);
 
-int main(void){
-    MarketData allDataStored = {{}};
-    set<string> allProducts = {};
+int main(int argc, char* argv[]){
+    //options: the output format; --diff compares two files and quits;
+    //--record writes the commands to a log; --lazy reads chains on demand
+    OutputFormat format = OutputFormat::TEXT;
+    vector<string> diffPaths;
+    string logPath;
+    bool lazy = false;
+    bool optionsValid = true;
+    for(int i = 1; i < argc and optionsValid; ++i){
+        string option = argv[i];
+        if(option == "--diff" and i + 2 < argc){
+            diffPaths = {argv[i + 1], argv[i + 2]};
+            i += 2;
+        }
+        else if(option == "--record" and i + 1 < argc){
+            logPath = argv[i + 1];
+            i += 1;
+        }
+        else if(option == "--lazy"){lazy = true;}
+        else{optionsValid = read_output_format(option, format);}
+    }
+    if(!optionsValid){
+        cerr << "Usage: " << argv[0] << " [--format=text|json|tsv]"
+             << " [--diff <old file> <new file>]"
+             << " [--record <log file>] [--lazy]" << endl;
+        return EXIT_FAILURE;
+    }
+    QueryLog log;
+    if(!logPath.empty() and !log.open(logPath)){
+        cerr << "Error: the log file cannot be written" << endl;
+        return EXIT_FAILURE;
+    }
+    Output out(format);
+    if(!diffPaths.empty()){
+        return diff_catalogs(diffPaths[0], diffPaths[1], out)
+                ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    //all the catalogs share one dictionary and the equal assortments
+    auto share = make_shared<CatalogShare>();
+    map<string, NamedCatalog> catalogs;
+    NamedCatalog* current = &catalogs["default"];
+    current->catalog = make_unique<Catalog>(share);
     //read the file and receive the file-reading status
-    bool readStatusSuccess = read_success(allDataStored, allProducts);
+    bool readStatusSuccess = read_success(*current->catalog, lazy, out);
     if(!readStatusSuccess){return EXIT_FAILURE;}
+    log.start();
     //keep reading until cmd is "quit"
     while (readStatusSuccess) {
-        cout << "> ";
+        //the commands go to the catalog chosen with use
+        Catalog& catalog = *current->catalog;
+        Watches& watches = current->watches;
+        //the results so far are written out before waiting for the user
+        out.prompt("> ");
         string command, cmd_1, cmd_2, cmd_border;
         command = "";
         cmd_1 = "";
@@ -130,37 +235,73 @@ int main(void){
         /*get the num of non-empty strings after command
          *thus it's the amount of variable */
         int amountOfVar =
-                read_cmd_and_varNum(command, cmd_1, cmd_2, cmd_border);
+                read_cmd_and_varNum(command, cmd_1, cmd_2, cmd_border, log);
+
+        if(!read_needed_chains(catalog, command, cmd_1, out)){
+            return EXIT_FAILURE;
+        }
 
         if(command == "quit"){
             /*cmd "quit" directly terminates the program
              *thus should have no variable
              *(cmd_1, cmd_2, and cmd_border should be empty) */
             if(amountOfVar != 0){
-                cout << "Error: error in command " << command << endl;}
+                out.error(command, "Error: error in command " + command);}
             else{return EXIT_SUCCESS;}
         }
         else if (command == "products"){
-            products_print(allProducts, amountOfVar);
+            products_print(catalog, amountOfVar, out);
         }
         else if (command == "chains"){
-            chains_print(allDataStored, amountOfVar);
+            chains_print(catalog, amountOfVar, out);
         }
         else if (command == "stores"){
-            stores_print(allDataStored, cmd_1, amountOfVar);
+            stores_print(catalog, cmd_1, amountOfVar, out);
         }
         else if (command == "cheapest"){
-            cheapest_print(allDataStored, allProducts, cmd_1, amountOfVar);
+            cheapest_print(catalog, cmd_1, amountOfVar, out);
+        }
+        else if (command == "cheapest-all"){
+            cheapest_all_print(catalog, amountOfVar, out);
+        }
+        else if (command == "export"){
+            export_print(catalog, cmd_1, amountOfVar, out);
         }
         else if (command == "selection"){
-            selection_print(allDataStored, cmd_1, cmd_2, amountOfVar);
+            selection_print(catalog, cmd_1, cmd_2, amountOfVar, out);
+        }
+        else if (command == "range"){
+            range_print(catalog, cmd_1, cmd_2, cmd_border, amountOfVar, out);
+        }
+        else if (command == "under"){
+            under_print(catalog, cmd_1, cmd_2, cmd_border, amountOfVar, out);
+        }
+        else if (command == "query"){
+            query_print(catalog, cmd_1, cmd_2, cmd_border, out);
+        }
+        else if (command == "watch"){
+            watch_print(catalog, watches, cmd_1, cmd_2, cmd_border,
+                        amountOfVar, out);
+        }
+        else if (command == "update"){
+            update_print(catalog, watches, cmd_1, cmd_2, cmd_border,
+                         amountOfVar, out);
+        }
+        else if (command == "apply"){
+            apply_print(catalog, watches, cmd_1, amountOfVar, out);
+        }
+        else if (command == "load"){
+            load_print(catalogs, share, lazy, cmd_1, cmd_2, amountOfVar, out);
+        }
+        else if (command == "use"){
+            use_print(catalogs, current, cmd_1, amountOfVar, out);
         }
 
         //this cmd "printall" branch is only for test...
-        //else if (command == "printall"){print_all(allDataStored);}
+        //else if (command == "printall"){print_all(catalog);}
 
         //all other cmd stems are unknown; then wait for next input from user
-        else{cout << "Error: unknown command: " << command << endl;}
+        else{out.error(command, "Error: unknown command: " + command);}
     }
     return 0;
 }
@@ -168,115 +309,66 @@ int main(void){
 //============== bodies of functions ====================
 
 //- - - - - - functions contribute most - - - - - -
-bool read_success(MarketData& allData, set<string>& productList){
-    /* process the input csv data; when error, cout error message
-     * at the sametime, assign the value to the dataset
+bool read_success(Catalog& catalog, bool lazy, Output& out){
+    /* process the input csv data; when error, print error message
      * finally, return boolean value to tell the status of data-reading */
     string inputFName;
-    cout << "Input file: ";
+    out.prompt("Input file: ");
     getline(cin, inputFName);
-    ifstream listFileOB(inputFName);
-    //when the input filename doesn't exist
-    if(!listFileOB){
-        cout << "Error: the input file cannot be opened" << endl;
-        return false;
-    }
     /* Basic idea:
-     * Read content line by line (using while with getline
-     * to avoid any data missing bcs >> operator skip spaces.
-     * Then asign the content to 4 fields and check whether
-     * any of them is empty or containing spaces
+     * The loader (see loader.hh) reads the file in big blocks instead of
+     * line by line. Each block is swept once by the structural scanner
+     * (see scanner.hh), which gives the 4 fields of every line and tells
+     * whether any of them is empty or contains spaces.
      * if empty or containing spaces, the file has an erroneous line;
-     * if not, store the data
+     * if not, the catalog stores the data
     */
-    string eachLine = "";
-    while(getline(listFileOB, eachLine)){
-        stringstream lineStream(eachLine);
-        string chainName, storeName, pName, pPriceStr;
-        chainName = "";
-        storeName = "";
-        pName = "";
-        pPriceStr = "";
-        getline(lineStream, chainName, ';');
-        getline(lineStream, storeName, ';');
-        getline(lineStream, pName, ';');
-        getline(lineStream, pPriceStr, ';');
-
-        if(chainName.empty() or storeName.empty()
-                or pName.empty() or pPriceStr.empty())
-        {
-            cout << "Error: the input file has an erroneous line" << endl;
-            return false;
-        }
-        if(chainName.find(' ') != string::npos
-                or storeName.find(' ') != string::npos
-                or pName.find(' ') != string::npos
-                or pPriceStr.find(' ') != string::npos)
-        {
-            cout << "Error: the input file has an erroneous line" << endl;
-            return false;
-        }
-
-        //make the product list
-        productList.insert(pName);
-
-        double pPriceDouble = -1.0;
-        //sign for identifing the out-of-stock status
-        if(pPriceStr == "out-of-stock"){pPriceDouble = -1.0;}
-        else{pPriceDouble = stod(pPriceStr);}
-
-        Product eachProduct = {pName, pPriceDouble};
-        //chainName hasn't been stored
-        if(allData.find(chainName) == allData.end())
-        {
-            allData.insert(
-                        {{chainName,{{storeName,
-                               {{eachProduct.product_name, eachProduct}}}}}});
-        }
-        //chainName has been stored
-        else{
-            //...but storeName hasn't been stored
-            if(allData.at(chainName).find(storeName)
-                            == allData.at(chainName).end())
-            {
-                allData.at(chainName)
-                        .insert({{storeName,
-                                 {{eachProduct.product_name, eachProduct}}}});
-            }
-            //storeName has been stored
-            else{
-                //...but we don't know if this product has price history
-                // Check if the product already exists
-                //1, if not (product_name can't be found
-                if(allData.at(chainName).at(storeName)
-                        .find(eachProduct.product_name)
-                            == allData.at(chainName).at(storeName).end())
-                {
-                    allData.at(chainName).at(storeName).
-                            insert({eachProduct.product_name, eachProduct});
-                }
-                //2, if product has price history
-                else
-                {
-                    //rewrite the price (by manually asign the value
-                    allData.at(chainName)
-                            .at(storeName)
-                            .at(eachProduct.product_name).price
-                                                = eachProduct.price;
-                }
-            }
-        }
+    LoadStatus status = lazy ? catalog.load_lazy(inputFName)
+                             : catalog.load(inputFName);
+    if(status == LoadStatus::CANNOT_OPEN){
+        out.error("load", "Error: the input file cannot be opened");
+        return false;
+    }
+    if(status == LoadStatus::ERRONEOUS_LINE){
+        out.error("load", "Error: the input file has an erroneous line");
+        return false;
     }
-    listFileOB.close();
     //data successfully stored
     return true;
 }
 
+bool read_needed_chains(Catalog& catalog, const string& command,
+                        const string& cmd_1, Output& out){
+    //nothing is left to read unless the catalog was loaded lazily
+    LoadStatus status = LoadStatus::SUCCESS;
+    if(command == "stores" or command == "selection" or command == "range"
+            or command == "under"){
+        status = catalog.load_chain(cmd_1);
+    }
+    else if(command == "products" or command == "cheapest"
+            or command == "cheapest-all" or command == "export"
+            or command == "query" or command == "watch"
+            or command == "update" or command == "apply"){
+        status = catalog.load_all_chains();
+    }
+    if(status == LoadStatus::SUCCESS){return true;}
+    if(status == LoadStatus::FILE_CHANGED){
+        out.error("load", "Error: the input file has changed");
+    }
+    else if(status == LoadStatus::CANNOT_OPEN){
+        out.error("load", "Error: the input file cannot be opened");
+    }
+    else{out.error("load", "Error: the input file has an erroneous line");}
+    return false;
+}
+
 int read_cmd_and_varNum(string& cmd_0,
-                        string& cmd_1, string& cmd_2, string& cmd_border){
+                        string& cmd_1, string& cmd_2, string& cmd_border,
+                        QueryLog& log){
     //cmd in a line from cin
     string lineCMD = "";
     getline(cin, lineCMD);
+    log.record(lineCMD);
     stringstream streamCMD(lineCMD);
     //asign each part of cmd in a line, splitted by spaces
     streamCMD >> cmd_0;
@@ -291,215 +383,721 @@ int read_cmd_and_varNum(string& cmd_0,
      * cmd_1 is surely not empty.
      * Thus we start from checking the empty status of cmd_border
      **/
-    if(!cmd_border.empty()){return 9;}
+    if(!cmd_border.empty()){
+        //count the words of the rest, needed by range and under
+        stringstream streamBorder(cmd_border);
+        string eachWord;
+        int amountOfVar = 2;
+        while(streamBorder >> eachWord){++amountOfVar;}
+        return amountOfVar;
+    }
     else if(!cmd_2.empty()){return 2;}
     else if(!cmd_1.empty()){return 1;}
     else{return 0;}
 }
 
-double find_cheapest_price(MarketData& allData,
-                           vector<pair<string, string> >& cheapestList,
-                           string productName){
-    //use negative double value as a sign of out-of-stock
-    double lowestPrice = -1.0;
-    //first part: finding the lowest price
-    for(auto& chains:allData){
-        for(auto& stores:chains.second){
-            for(auto& products:stores.second){
-                /*if products.first(the name of product)
-                 * has been recorded previously*/
-                if(products.first == productName){
-                    /* Value-assigning happens only when
-                     * 1) lowestPrice hasn't been asigned with a
-                     *   valid value (thus it's -1.0)
-                     *   NOTE even if the new assigned value (product.price)
-                     *   is still -1.0, it doesn't matter
-                     *   bcs value = -1.0 is always invalid.
-                     *   Assigning doesn't change anything,
-                     *   and also represents the out-of-stock status.
-                     *   Meanwhile, this condition makes assigning happens
-                     *   whenever lowestPrice == -1.0.
-                     *   It avoids the cycle that -1.0 smaller than every
-                     *   normal price then lowestPrice will never be the
-                     *   bigger one and be assigned when there is
-                     *   a valid price.
-                     *
-                     * 2) (a) the product.price now is lower AND
-                     *    (b) the it is also not -1.0
-                     *   bcs -1.0 would be lower than any other normal price.
-                     *   thus if we don't add the 2.b condition,
-                     *   out-of-stock sign will be considered as the
-                     *   new lowest price,
-                     *   which means out-of-stock sign overwrites the previous
-                     *   valid lowest price.
-                     **/
-                    if((lowestPrice == -1.0)
-                            or (lowestPrice > products.second.price
-                                and products.second.price != -1.0)){
-                        lowestPrice = products.second.price;
-                    }
-                }
-            }
-        }
-    }
-    /*second part: according to the lowest price we found,
-        record chains-location data*/
-    for(auto& chains:allData){
-        for(auto& stores:chains.second){
-            for(auto& products:stores.second){
-                if(products.second.price == lowestPrice
-                        and lowestPrice != -1.0)
-                {
-                    cheapestList.push_back({chains.first, stores.first});
-                }
-            }
-        }
-    }
-    return lowestPrice;
+bool read_price(const string& priceStr, double& price){
+    //the whole string must be the number
+    return !priceStr.empty()
+            and read_number(priceStr, price) == priceStr.size();
 }
 
 //- - - - - - functions for printing - - - - - - -
 //cmds using no variable
 /**
  * @brief products_print - make the output printing when command is "products"
- * @param allProducts    - where main data stored
+ * @param catalog        - where main data stored
  * @param amountOfVar    - the amount of the variable to this command from user
+ * @param out            - where the result goes
  */
-void products_print(set<string>& allProducts, int amountOfVar){
+void products_print(const Catalog& catalog, int amountOfVar, Output& out){
     /*cmd "products" directly print out all products
      *regardless of the chain or location
      *thus should have no variable
      *(cmd_1, cmd_2, and cmd_border should be empty) */
     if(amountOfVar != 0){
-        cout << "Error: error in command " << "products" << endl;}
+        out.error("products", "Error: error in command products");}
     else{
-        //product names were directly stored in (set)allProducts
-        for(auto& product:allProducts){
-            cout << product << endl;
+        out.begin("products");
+        for(NameId product:catalog.products()){
+            out.row_begin();
+            out.field("product", catalog.name(product));
+            out.row_end();
         }
+        out.end();
     }
 }
 /**
  * @brief chains_print   - make the output printing when command is "chains"
- * @param allDataStored  - where main data stored
+ * @param catalog        - where main data stored
  * @param amountOfVar    - the amount of the variable to this command from user
+ * @param out            - where the result goes
  */
-void chains_print(MarketData& allDataStored, int amountOfVar){
+void chains_print(const Catalog& catalog, int amountOfVar, Output& out){
     /*cmd "chains" directly print out all chainName
      *regardless of other factors
      *thus should have no variable
      *(cmd_1, cmd_2, and cmd_border should be empty) */
     if(amountOfVar != 0){
-        cout << "Error: error in command " << "chains" << endl;}
+        out.error("chains", "Error: error in command chains");}
     else{
-        /*chain here is
-         * pair<chainName, map<location, map<product.name, product> > >*/
-        for(auto& chain:allDataStored){
-            cout << chain.first << endl;
+        out.begin("chains");
+        //the data structure before the catalog always held an empty chain
+        out.row_begin();
+        out.field("chain", "");
+        out.row_end();
+        for(NameId chain:catalog.chains()){
+            out.row_begin();
+            out.field("chain", catalog.name(chain));
+            out.row_end();
         }
+        out.end();
     }
 }
+/**
+ * @brief cheapest_all_print - make the output printing when command is
+ *        "cheapest-all": for every product, one line
+ *        "product price chain store" per store selling it at the lowest
+ *        price, or "product out of stock" when none has it in stock
+ * @param catalog            - where main data stored
+ * @param amountOfVar        - the amount of the variable to this command
+ * @param out                - where the result goes
+ */
+void cheapest_all_print(const Catalog& catalog, int amountOfVar,
+                        Output& out){
+    //cmd "cheapest-all" answers cheapest for all products; no variable
+    if(amountOfVar != 0){
+        out.error("cheapest-all", "Error: error in command cheapest-all");
+        return;
+    }
+    out.begin("cheapest-all");
+    Span<NameId> products = catalog.products();
+    for(ProductId product = 0; product < products.size(); ++product){
+        string_view productName = catalog.name(products[product]);
+        CheapestOffers cheapest = catalog.cheapest(product);
+        if(cheapest.price == -1.0){
+            out.row_begin();
+            out.field("product", productName);
+            out.price_field("price", cheapest.price);
+            out.row_end();
+        }
+        for(auto& eachStore:cheapest.stores){
+            out.row_begin();
+            out.field("product", productName);
+            out.price_field("price", cheapest.price);
+            out.field("chain", catalog.name(eachStore.chain));
+            out.field("store", catalog.name(eachStore.store));
+            out.row_end();
+        }
+    }
+    out.end();
+}
 //cmds using only 1 variable
 /**
  * @brief stores_print  - make the output printing when command is "stores"
- * @param allDataStored - where main data stored
+ * @param catalog       - where main data stored
  * @param cmd_1         - the first valid variable to command "stores"
  * @param amountOfVar   - the amount of the variable to this command from user
+ * @param out           - where the result goes
  */
-void stores_print(MarketData& allDataStored, string cmd_1, int amountOfVar){
+void stores_print(const Catalog& catalog, string cmd_1, int amountOfVar,
+                  Output& out){
     /*cmd "stores" prints out all locations of a certain chainName
      *thus should have only 1 variable
      *(cmd_2 and cmd_border should be empty) */
+    ChainId chain = 0;
     if(amountOfVar != 1){
-        cout << "Error: error in command " << "stores" << endl;}
-    /*cmd_1 here is the target chainName from user
-     *if not found in the keys of the map... */
-    else if(allDataStored.find(cmd_1) == allDataStored.end()){
-        cout << "Error: unknown chain name" << endl;
+        out.error("stores", "Error: error in command stores");}
+    //cmd_1 here is the target chainName from user
+    else if(!catalog.find_chain(cmd_1, chain)){
+        out.error("stores", "Error: unknown chain name");
     }
     else{
-        /*stores here is
-         *map<location, map<product.name, product> >
-         *under the given chainName */
-        for(auto& stores:allDataStored.at(cmd_1)){
-            cout << stores.first << endl;
+        out.begin("stores");
+        out.attribute("chain", cmd_1);
+        for(NameId store:catalog.stores(chain)){
+            out.row_begin();
+            out.field("store", catalog.name(store));
+            out.row_end();
         }
+        out.end();
     }
 }
 /**
  * @brief cheapest_print - make the output printing when command is "cheapest"
- * @param allDataStored  - where main data stored
- * @param allProducts    - where the data of product names (no repeated) stored
+ * @param catalog        - where main data stored
  * @param cmd_1          - the first valid variable to command "stores"
  * @param amountOfVar    - the amount of the variable to this command from user
+ * @param out            - where the result goes
  */
-void cheapest_print(MarketData& allDataStored, set<string>& allProducts,
-                    string cmd_1, int amountOfVar){
+void cheapest_print(const Catalog& catalog, string cmd_1, int amountOfVar,
+                    Output& out){
     /*cmd "cheapest" finds out the list of chain-location
      *with given productName
      *thus should have only 1 variable
      *cmd_2 and cmd_border should be empty) */
+    ProductId product = 0;
     if(amountOfVar != 1){
-        cout << "Error: error in command " << "cheapest" << endl;}
-    //(set)allProducts directly stored all occured productName
-    else if(allProducts.find(cmd_1) == allProducts.end()){
-        cout << "The product is not part of product selection" << endl;
+        out.error("cheapest", "Error: error in command cheapest");}
+    else if(!catalog.find_product(cmd_1, product)){
+        out.error("cheapest", "The product is not part of product selection");
     }
     else{
-        //set a vector made by pair<chainName, location>
-        vector<pair<string, string> > cheapestList;
-        /*receive the lowest price searched by this function;
-         *read the content of allDataStored,
-         *directly change the content of cheapestList*/
-        double price = find_cheapest_price(allDataStored, cheapestList, cmd_1);
-        if(price == -1.0){
-            cout << "The product is temporarily out of stock everywhere"
-                 << endl;}
-        else{
-            //set the format of output figure ( = %.2f)
-            cout << fixed << setprecision(2)
-                 << price << " " << "euros" << endl;
-            for(auto& eachStore:cheapestList){
-                cout << eachStore.first << " " << eachStore.second << endl;
+        /*the lowest price and the stores selling the product at that
+         *price, in the order of chains and locations */
+        CheapestOffers cheapest = catalog.cheapest(product);
+        //the text tells the price once, before the stores
+        if(out.is_text()){
+            if(cheapest.price == -1.0){
+                out.text("The product is temporarily out of stock everywhere")
+                        .end_line();
+                return;
             }
+            out.price(cheapest.price).text(" euros").end_line();
         }
+        //out of stock everywhere ==> no stores in the result
+        out.begin("cheapest");
+        out.attribute("product", cmd_1);
+        out.price_attribute("price", cheapest.price);
+        /*as before the catalog: every store with some product at the
+         *lowest price, once for each such product */
+        const OfferColumns& columns = catalog.columns();
+        for(size_t row = 0;
+            cheapest.price != -1.0 and row < columns.price.size(); ++row){
+            if(columns.price[row] != cheapest.price){continue;}
+            out.row_begin();
+            out.field("chain",
+                      catalog.name(catalog.chain_name(columns.chain[row])));
+            out.field("store",
+                      catalog.name(catalog.store_name(columns.store[row])));
+            out.row_end();
+        }
+        out.end();
     }
 }
+/**
+ * @brief export_print - make the output printing when command is "export"
+ * @param catalog      - where main data stored
+ * @param cmd_1        - the name of the file written
+ * @param amountOfVar  - the amount of the variable to this command from user
+ * @param out          - where the result goes
+ */
+void export_print(const Catalog& catalog, string cmd_1, int amountOfVar,
+                  Output& out){
+    /*cmd "export" writes all the offers to an Arrow file
+     *thus should have only 1 variable */
+    if(amountOfVar != 1){
+        out.error("export", "Error: error in command export");
+        return;
+    }
+    ExportStatus status = export_arrow(catalog, cmd_1);
+    if(status == ExportStatus::CANNOT_WRITE){
+        out.error("export", "Error: the export file cannot be written");
+        return;
+    }
+    if(status == ExportStatus::PRICE_TOO_LARGE){
+        out.error("export", "Error: a price is too large to be exported");
+        return;
+    }
+    size_t offerCount = catalog.columns().price.size();
+    if(out.is_text()){
+        out.text(to_string(offerCount)).text(" offers written to ")
+                .text(cmd_1).end_line();
+        return;
+    }
+    out.begin("export");
+    out.attribute("file", cmd_1);
+    out.row_begin();
+    out.count_field("offers", offerCount);
+    out.row_end();
+    out.end();
+}
 //cmd using 2 variables
 /**
- * @brief selection_print - make the output printing when command is "cheapest"
- * @param allDataStored   - where main data stored
+ * @brief find_store_print_error - look up a store of a chain
+ *        and print the error message when it can't be found
+ * @param catalog                - where main data stored
+ * @param command                - the command, for the error message
+ * @param cmd_1                  - chainName
+ * @param cmd_2                  - location
+ * @param store                  - the store found
+ * @param out                    - where the error message goes
+ * @return false when chain or store is unknown
+ */
+bool find_store_print_error(const Catalog& catalog, const string& command,
+                            string cmd_1, string cmd_2, StoreId& store,
+                            Output& out){
+    ChainId chain = 0;
+    if(!catalog.find_chain(cmd_1, chain)){
+        out.error(command, "Error: unknown chain name");
+        return false;
+    }
+    if(!catalog.find_store(chain, cmd_2, store)){
+        out.error(command, "Error: unknown store");
+        return false;
+    }
+    return true;
+}
+/**
+ * @brief print_offers - print products with their prices, one per line
+ * @param catalog      - where main data stored
+ * @param offers       - the products
+ * @param out          - where the result goes, after begin()
+ *                       and the attributes
+ */
+void print_offers(const Catalog& catalog, Span<Offer> offers, Output& out){
+    for(auto& offer:offers){
+        out.row_begin();
+        out.field("product", catalog.name(offer.product));
+        //-1.0 is printed as out of stock
+        out.price_field("price", offer.price);
+        out.row_end();
+    }
+    out.end();
+}
+/**
+ * @brief selection_print - make the output printing when command is "selection"
+ * @param catalog         - where main data stored
  * @param cmd_1           - the first valid variable to command "stores"
  * @param cmd_2           - the second valid variable to command "stores"
  * @param amountOfVar     - the amount of variable(s) to this command from user
+ * @param out             - where the result goes
  */
-void selection_print(MarketData& allDataStored,
-                     string cmd_1, string cmd_2, int amountOfVar){
+void selection_print(const Catalog& catalog,
+                     string cmd_1, string cmd_2, int amountOfVar,
+                     Output& out){
     /*cmd "selection" finds out the all the products
      *with given chainName(cmd_1) and location(cmd_2)
      *thus should have only 2 variables
      *(cmd_border should be empty) */
+    StoreId store = 0;
     if(amountOfVar != 2){
-        cout << "Error: error in command " << "selection" << endl;}
-    //when chainName(cmd_1) can't be found
-    else if(allDataStored.find(cmd_1) == allDataStored.end()){
-        cout << "Error: unknown chain name" << endl;
+        out.error("selection", "Error: error in command selection");}
+    else if(find_store_print_error(catalog, "selection", cmd_1, cmd_2, store,
+                                   out)){
+        out.begin("selection");
+        out.attribute("chain", cmd_1);
+        out.attribute("store", cmd_2);
+        print_offers(catalog, catalog.selection(store), out);
     }
-    //when location(cmd_2) can't be found
-    else if(allDataStored.at(cmd_1).find(cmd_2)
-                    == allDataStored.at(cmd_1).end()){
-        cout << "Error: unknown store" << endl;
+}
+
+//cmds using price limits
+/**
+ * @brief print_price_range - print the products of one store whose price
+ *        is in [lowest, highest], cheapest first
+ * @param catalog           - where main data stored
+ * @param command           - "range" or "under"
+ * @param cmd_1             - chainName
+ * @param cmd_2             - location
+ * @param lowest            - the lower limit (inclusive)
+ * @param highest           - the upper limit (inclusive)
+ * @param out               - where the result goes
+ */
+void print_price_range(const Catalog& catalog, const string& command,
+                       string cmd_1, string cmd_2,
+                       double lowest, double highest, Output& out){
+    StoreId store = 0;
+    if(!find_store_print_error(catalog, command, cmd_1, cmd_2, store, out)){
+        return;
     }
-    else{
-        //products here is map<product.name, product>
-        for(auto& products:allDataStored.at(cmd_1).at(cmd_2)){
-            cout << products.first << " ";
-            if(products.second.price == -1.0){cout << "out of stock" << endl;}
-            //set the format of the figure ( = %.2f)
-            else{cout << fixed << setprecision(2)
-                      << products.second.price << endl;}
+    Span<Offer> offers = catalog.price_range(store, lowest, highest);
+    if(offers.empty() and out.is_text()){
+        out.text("No products in the given price range").end_line();
+        return;
+    }
+    out.begin(command);
+    out.attribute("chain", cmd_1);
+    out.attribute("store", cmd_2);
+    print_offers(catalog, offers, out);
+}
+/**
+ * @brief range_print - make the output printing when command is "range"
+ * @param catalog     - where main data stored
+ * @param cmd_1       - chainName
+ * @param cmd_2       - location
+ * @param cmd_border  - the rest of the line: "<min> <max>"
+ * @param amountOfVar - the amount of variable(s) to this command from user
+ * @param out         - where the result goes
+ */
+void range_print(const Catalog& catalog, string cmd_1, string cmd_2,
+                 string cmd_border, int amountOfVar, Output& out){
+    /*cmd "range" lists the products of a store
+     *whose price is between min and max (both included)
+     *thus should have 4 variables */
+    string minStr, maxStr;
+    stringstream streamLimits(cmd_border);
+    streamLimits >> minStr >> maxStr;
+    double lowest = 0.0;
+    double highest = 0.0;
+    if(amountOfVar != 4 or !read_price(minStr, lowest)
+            or !read_price(maxStr, highest)){
+        out.error("range", "Error: error in command range");
+        return;
+    }
+    print_price_range(catalog, "range", cmd_1, cmd_2, lowest, highest, out);
+}
+/**
+ * @brief under_print - make the output printing when command is "under"
+ * @param catalog     - where main data stored
+ * @param cmd_1       - chainName
+ * @param cmd_2       - location
+ * @param cmd_border  - the rest of the line: "<max>"
+ * @param amountOfVar - the amount of variable(s) to this command from user
+ * @param out         - where the result goes
+ */
+void under_print(const Catalog& catalog, string cmd_1, string cmd_2,
+                 string cmd_border, int amountOfVar, Output& out){
+    /*cmd "under" lists the products of a store
+     *which can be bought with the given budget (price <= max)
+     *thus should have 3 variables */
+    string maxStr;
+    stringstream streamLimits(cmd_border);
+    streamLimits >> maxStr;
+    double highest = 0.0;
+    if(amountOfVar != 3 or !read_price(maxStr, highest)){
+        out.error("under", "Error: error in command under");
+        return;
+    }
+    //every valid price is >= 0
+    print_price_range(catalog, "under", cmd_1, cmd_2, 0.0, highest, out);
+}
+
+//cmd using any number of variables
+/**
+ * @brief query_print - make the output printing when command is "query":
+ *        the matching offers as "chain store product price", or one line
+ *        per group: the chain, store or product, then the aggregates
+ * @param catalog     - where main data stored
+ * @param cmd_1       - the 1st word of the query
+ * @param cmd_2       - the 2nd word of the query
+ * @param cmd_border  - the rest of the query
+ * @param out         - where the result goes
+ */
+void query_print(const Catalog& catalog, string cmd_1, string cmd_2,
+                 string cmd_border, Output& out){
+    //the words were split by read_cmd_and_varNum; put them together again
+    string queryText = cmd_1;
+    if(!cmd_2.empty()){queryText += " " + cmd_2 + cmd_border;}
+    Query query;
+    if(!parse_query(catalog, queryText, query)){
+        out.error("query", "Error: error in command query");
+        return;
+    }
+    QueryResult result = run_query(catalog, query);
+    const OfferColumns& columns = catalog.columns();
+    out.begin("query");
+    out.attribute("query", queryText);
+    if(query_lists_offers(query)){
+        for(auto row:result.offers){
+            out.row_begin();
+            ChainId chain = columns.chain[row];
+            StoreId store = columns.store[row];
+            ProductId product = columns.product[row];
+            out.field("chain", catalog.name(catalog.chain_name(chain)));
+            out.field("store", catalog.name(catalog.store_name(store)));
+            out.field("product", catalog.name(catalog.product_name(product)));
+            out.price_field("price", columns.price[row]);
+            out.row_end();
+        }
+        out.end();
+        return;
+    }
+    //"by" without aggregates counts the offers
+    vector<Query::Aggregate> aggregates = query.aggregates;
+    if(aggregates.empty()){aggregates.push_back(Query::Aggregate::COUNT);}
+    for(auto& group:result.groups){
+        out.row_begin();
+        if(query.groupBy == Query::GroupBy::CHAIN){
+            out.field("chain", catalog.name(catalog.chain_name(group.key)));
+        }
+        else if(query.groupBy == Query::GroupBy::STORE){
+            ChainId chain = catalog.store_chain(group.key);
+            out.field("chain", catalog.name(catalog.chain_name(chain)));
+            out.field("store", catalog.name(catalog.store_name(group.key)));
+        }
+        else if(query.groupBy == Query::GroupBy::PRODUCT){
+            out.field("product", catalog.name(catalog.product_name(group.key)));
+        }
+        for(auto aggregate:aggregates){
+            if(aggregate == Query::Aggregate::COUNT){
+                out.count_field("count", group.count);
+            }
+            else if(aggregate == Query::Aggregate::MIN){
+                out.price_field("min", group.lowest);
+            }
+            else{out.price_field("max", group.highest);}
+        }
+        out.row_end();
+    }
+    out.end();
+}
+
+//cmds keeping the catalog up to date
+//a watch fired by an update, and the offer it was fired by
+struct FiredAlert {
+    StoreId store;
+    ProductId product;
+    double price;
+    Alert alert;
+};
+/**
+ * @brief update_and_check - change a price in the catalog and collect
+ *        the watches fired by the change
+ * @param catalog          - where main data stored
+ * @param watches          - the registered watches
+ * @param store            - the store of the offer
+ * @param product          - the product of the offer
+ * @param price            - the new price, -1.0 for out of stock
+ * @param fired            - where the fired watches are added
+ * @return false if the store doesn't have the product
+ */
+bool update_and_check(Catalog& catalog, const Watches& watches,
+                      StoreId store, ProductId product, double price,
+                      vector<FiredAlert>& fired){
+    double oldPrice = 0.0;
+    if(!catalog.update_price(store, product, price, oldPrice)){return false;}
+    vector<Alert> alerts;
+    watches.check(product, oldPrice, price, alerts);
+    for(auto& alert:alerts){fired.push_back({store, product, price, alert});}
+    return true;
+}
+/**
+ * @brief print_alerts - print the fired watches, one line each:
+ *        "Alert: milk below 1.00 at Prisma Kaleva: 0.95" or
+ *        "Alert: milk in stock at Prisma Kaleva: 0.95"
+ * @param catalog      - where main data stored
+ * @param fired        - the fired watches
+ * @param out          - where the result goes
+ */
+void print_alerts(const Catalog& catalog, const vector<FiredAlert>& fired,
+                  Output& out){
+    for(auto& eachAlert:fired){
+        string_view product =
+                catalog.name(catalog.product_name(eachAlert.product));
+        ChainId chain = catalog.store_chain(eachAlert.store);
+        string_view chainName = catalog.name(catalog.chain_name(chain));
+        string_view storeName =
+                catalog.name(catalog.store_name(eachAlert.store));
+        if(out.is_text()){
+            out.text("Alert: ").text(product);
+            if(eachAlert.alert.inStock){out.text(" in stock");}
+            else{out.text(" below ").price(eachAlert.alert.threshold);}
+            out.text(" at ").text(chainName).text(" ").text(storeName)
+                    .text(": ").price(eachAlert.price).end_line();
+            continue;
         }
+        out.row_begin();
+        out.field("watch", eachAlert.alert.inStock ? "instock" : "below");
+        if(eachAlert.alert.inStock){out.field("threshold", "");}
+        else{out.price_field("threshold", eachAlert.alert.threshold);}
+        out.field("product", product);
+        out.field("chain", chainName);
+        out.field("store", storeName);
+        out.price_field("price", eachAlert.price);
+        out.row_end();
+    }
+}
+/**
+ * @brief watch_print - make the output printing when command is "watch":
+ *        "watch <product> below <price>" or "watch <product> instock"
+ *        registers a watch; it prints only errors
+ * @param catalog     - where main data stored
+ * @param watches     - where the watch goes
+ * @param cmd_1       - the product
+ * @param cmd_2       - "below" or "instock"
+ * @param cmd_border  - the rest of the line: "<price>" for below
+ * @param amountOfVar - the amount of variable(s) to this command from user
+ * @param out         - where the result goes
+ */
+void watch_print(const Catalog& catalog, Watches& watches, string cmd_1,
+                 string cmd_2, string cmd_border, int amountOfVar,
+                 Output& out){
+    string priceStr;
+    stringstream streamLimits(cmd_border);
+    streamLimits >> priceStr;
+    double threshold = 0.0;
+    bool below = cmd_2 == "below" and amountOfVar == 3
+            and read_price(priceStr, threshold);
+    bool inStock = cmd_2 == "instock" and amountOfVar == 2;
+    ProductId product = 0;
+    if(!below and !inStock){
+        out.error("watch", "Error: error in command watch");
+        return;
+    }
+    if(!catalog.find_product(cmd_1, product)){
+        out.error("watch", "The product is not part of product selection");
+        return;
+    }
+    if(below){watches.watch_below(product, threshold);}
+    else{watches.watch_in_stock(product);}
+    out.begin("watch");
+    out.attribute("product", cmd_1);
+    out.attribute("watch", cmd_2);
+    out.end();
+}
+/**
+ * @brief update_print - make the output printing when command is "update":
+ *        "update <chain> <store> <product> <price>" changes the price of
+ *        an offer (the price can also be out-of-stock) and prints the
+ *        watches fired by it
+ * @param catalog      - where main data stored
+ * @param watches      - the registered watches
+ * @param cmd_1        - chainName
+ * @param cmd_2        - location
+ * @param cmd_border   - the rest of the line: "<product> <price>"
+ * @param amountOfVar  - the amount of variable(s) to this command from user
+ * @param out          - where the result goes
+ */
+void update_print(Catalog& catalog, const Watches& watches, string cmd_1,
+                  string cmd_2, string cmd_border, int amountOfVar,
+                  Output& out){
+    string productName, priceStr;
+    stringstream streamRest(cmd_border);
+    streamRest >> productName >> priceStr;
+    double price = 0.0;
+    if(amountOfVar != 4 or !parse_price(priceStr, price)){
+        out.error("update", "Error: error in command update");
+        return;
+    }
+    StoreId store = 0;
+    if(!find_store_print_error(catalog, "update", cmd_1, cmd_2, store, out)){
+        return;
+    }
+    ProductId product = 0;
+    vector<FiredAlert> fired;
+    if(!catalog.find_product(productName, product)
+            or !update_and_check(catalog, watches, store, product, price,
+                                 fired)){
+        out.error("update", "Error: the store has no such product");
+        return;
+    }
+    out.begin("update");
+    print_alerts(catalog, fired, out);
+    out.end();
+}
+/**
+ * @brief apply_print - make the output printing when command is "apply":
+ *        "apply <file>" changes the prices of the offers in the file
+ *        (same format as the input file) one line after the other, as
+ *        update does, and prints the watches fired; the lines of offers
+ *        the catalog doesn't have are skipped and counted
+ * @param catalog     - where main data stored
+ * @param watches     - the registered watches
+ * @param cmd_1       - the file
+ * @param amountOfVar - the amount of variable(s) to this command from user
+ * @param out         - where the result goes
+ */
+void apply_print(Catalog& catalog, const Watches& watches, string cmd_1,
+                 int amountOfVar, Output& out){
+    if(amountOfVar != 1){
+        out.error("apply", "Error: error in command apply");
+        return;
+    }
+    vector<FiredAlert> fired;
+    size_t skipped = 0;
+    auto apply_rows = [&](const vector<RowFields>& lines){
+        for(auto& line:lines){
+            double price = -1.0;
+            if(!parse_price(line.price, price)){return false;}
+            ChainId chain = 0;
+            StoreId store = 0;
+            ProductId product = 0;
+            if(!catalog.find_chain(line.chain, chain)
+                    or !catalog.find_store(chain, line.store, store)
+                    or !catalog.find_product(line.product, product)
+                    or !update_and_check(catalog, watches, store, product,
+                                         price, fired)){
+                ++skipped;
+            }
+        }
+        return true;
+    };
+    LoadStatus status = load_input(cmd_1, apply_rows);
+    if(status == LoadStatus::CANNOT_OPEN){
+        out.error("apply", "Error: the input file cannot be opened");
+        return;
+    }
+    //the lines before an erroneous one stay applied, thus their alerts
+    //are printed before the error
+    out.begin("apply");
+    out.attribute("skipped", to_string(skipped));
+    print_alerts(catalog, fired, out);
+    out.end();
+    if(skipped != 0 and out.is_text()){
+        out.text(to_string(skipped))
+                .text(" lines skipped: not in the catalog").end_line();
+    }
+    if(status == LoadStatus::ERRONEOUS_LINE){
+        out.error("apply", "Error: the input file has an erroneous line");
+    }
+}
+
+//cmds choosing the catalog
+/**
+ * @brief load_print - make the output printing when command is "load":
+ *        "load <catalog> <input file>" reads the input file into the named
+ *        catalog (a new one, or one replacing the catalog of that name
+ *        and its watches); the commands keep going to the catalog in use
+ * @param catalogs    - the catalogs of the process
+ * @param share       - what the catalogs share
+ * @param lazy        - only index the chains (--lazy)
+ * @param cmd_1       - the name of the catalog
+ * @param cmd_2       - the input file
+ * @param amountOfVar - the amount of the variable to this command from user
+ * @param out         - where the result goes
+ */
+void load_print(map<string, NamedCatalog>& catalogs,
+                const shared_ptr<CatalogShare>& share, bool lazy,
+                string cmd_1, string cmd_2, int amountOfVar, Output& out){
+    if(amountOfVar != 2){
+        out.error("load", "Error: error in command load");
+        return;
+    }
+    auto catalog = make_unique<Catalog>(share);
+    LoadStatus status = lazy ? catalog->load_lazy(cmd_2)
+                             : catalog->load(cmd_2);
+    //a failed load leaves the catalog of that name as it was
+    if(status == LoadStatus::CANNOT_OPEN){
+        out.error("load", "Error: the input file cannot be opened");
+        return;
+    }
+    if(status != LoadStatus::SUCCESS){
+        out.error("load", "Error: the input file has an erroneous line");
+        return;
+    }
+    NamedCatalog& named = catalogs[cmd_1];
+    named.catalog = move(catalog);
+    named.watches = Watches();
+    out.begin("load");
+    out.attribute("catalog", cmd_1);
+    out.attribute("file", cmd_2);
+    out.end();
+}
+/**
+ * @brief use_print  - make the output printing when command is "use":
+ *        "use <catalog>" sends the next commands to the named catalog
+ * @param catalogs    - the catalogs of the process
+ * @param current     - the catalog in use
+ * @param cmd_1       - the name of the catalog
+ * @param amountOfVar - the amount of the variable to this command from user
+ * @param out         - where the result goes
+ */
+void use_print(map<string, NamedCatalog>& catalogs, NamedCatalog*& current,
+               string cmd_1, int amountOfVar, Output& out){
+    if(amountOfVar != 1){
+        out.error("use", "Error: error in command use");
+        return;
+    }
+    auto found = catalogs.find(cmd_1);
+    if(found == catalogs.end()){
+        out.error("use", "Error: unknown catalog " + cmd_1);
+        return;
     }
+    current = &found->second;
+    out.begin("use");
+    out.attribute("catalog", cmd_1);
+    out.end();
 }
 
 //- - - - - - functions not required - - - - - - -
@@ -507,27 +1105,22 @@ void selection_print(MarketData& allDataStored,
 /**
  * @brief print_all - print out all content in a format
  *                    the same as the sample overview
- * @param allData   - where main data stored
+ * @param catalog   - where main data stored
  */
-void print_all(MarketData& allData){
+void print_all(const Catalog& catalog){
     cout << "Here are the list of all products in all supermarkets:" << endl;
-    for(auto& chain:allData){
-        cout << chain.first << endl;
-        for(auto& store:chain.second){
-            cout << "    " << store.first << endl;
-            for(auto& products:store.second){
-                if(products.second.price == -1){
-                    cout << "        "
-                         << products.second.product_name << "  \t"
-                         << "out-of-stock" << endl;
-                }
-                else{
-                    //set output as %.2f
-                    cout << "        "
-                         << products.second.product_name << "  \t"
-                         << fixed << setprecision(2)
-                         << products.second.price << endl;
-                }
+    Span<NameId> chains = catalog.chains();
+    for(ChainId chain = 0; chain < chains.size(); ++chain){
+        cout << catalog.name(chains[chain]) << endl;
+        for(NameId storeName:catalog.stores(chain)){
+            cout << "    " << catalog.name(storeName) << endl;
+            StoreId store = 0;
+            catalog.find_store(chain, catalog.name(storeName), store);
+            for(auto& offer:catalog.selection(store)){
+                cout << "        " << catalog.name(offer.product) << "  \t";
+                if(offer.price == -1.0){cout << "out-of-stock" << endl;}
+                //set output as %.2f
+                else{cout << fixed << setprecision(2) << offer.price << endl;}
             }
         }
     }
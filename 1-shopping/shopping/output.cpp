@@ -0,0 +1,256 @@
+/* Chain stores - output
+ *
+ * Desc:
+ *   Implementation of the buffered output. See output.hh.
+ *
+ * Program author
+ * Name: Ruowen Liu
+ * Student number: -
+ * UserID: -
+ * E-Mail: ruowen.liu@tuni.fi
+ * */
+
+#include "output.hh"
+
+#include <charconv>
+#include <cmath>
+#include <cstdio>
+
+namespace {
+
+//a listing bigger than this is written out in parts of about this size
+const std::size_t FLUSH_SIZE = std::size_t(1) << 16;
+
+} // namespace
+
+bool read_output_format(std::string_view option, OutputFormat& format){
+    if(option == "--format=text"){format = OutputFormat::TEXT;}
+    else if(option == "--format=json"){format = OutputFormat::JSON;}
+    else if(option == "--format=tsv"){format = OutputFormat::TSV;}
+    else{return false;}
+    return true;
+}
+
+Output::Output(OutputFormat format) : format_(format) {
+    buffer_.reserve(FLUSH_SIZE * 2);
+}
+
+Output::~Output(){
+    flush();
+}
+
+OutputFormat Output::format() const {
+    return format_;
+}
+
+bool Output::is_text() const {
+    return format_ == OutputFormat::TEXT;
+}
+
+Output& Output::text(std::string_view piece){
+    buffer_.append(piece);
+    return *this;
+}
+
+Output& Output::price(double price){
+    append_price(price, "out of stock");
+    return *this;
+}
+
+Output& Output::end_line(){
+    buffer_.push_back('\n');
+    flush_if_big();
+    return *this;
+}
+
+void Output::prompt(std::string_view prompt){
+    if(is_text()){buffer_.append(prompt);}
+    flush();
+}
+
+void Output::begin(std::string_view command){
+    firstRow_ = true;
+    tsvPrefix_.clear();
+    if(format_ == OutputFormat::JSON){
+        buffer_.append("{\"command\":");
+        append_json_string(command);
+    }
+}
+
+void Output::attribute(std::string_view key, std::string_view value){
+    if(format_ == OutputFormat::JSON){
+        buffer_.push_back(',');
+        append_json_string(key);
+        buffer_.push_back(':');
+        append_json_string(value);
+    }
+    else if(format_ == OutputFormat::TSV){
+        //the prefix is built in the buffer, then moved aside
+        std::size_t start = buffer_.size();
+        append_tsv_value(value);
+        tsvPrefix_.append(buffer_, start, std::string::npos).push_back('\t');
+        buffer_.resize(start);
+    }
+}
+
+void Output::price_attribute(std::string_view key, double price){
+    if(format_ == OutputFormat::JSON){
+        buffer_.push_back(',');
+        append_json_string(key);
+        buffer_.push_back(':');
+        append_price(price, "null");
+    }
+    else if(format_ == OutputFormat::TSV){
+        std::size_t start = buffer_.size();
+        append_price(price, "out-of-stock");
+        tsvPrefix_.append(buffer_, start, std::string::npos).push_back('\t');
+        buffer_.resize(start);
+    }
+}
+
+void Output::row_begin(){
+    firstField_ = true;
+    if(format_ == OutputFormat::JSON){
+        buffer_.append(firstRow_ ? ",\"results\":[{" : ",{");
+    }
+    else if(format_ == OutputFormat::TSV){
+        buffer_.append(tsvPrefix_);
+    }
+    firstRow_ = false;
+}
+
+void Output::field(std::string_view key, std::string_view value){
+    field_separator();
+    if(format_ == OutputFormat::JSON){
+        append_json_string(key);
+        buffer_.push_back(':');
+        append_json_string(value);
+    }
+    else if(format_ == OutputFormat::TSV){append_tsv_value(value);}
+    else{buffer_.append(value);}
+}
+
+void Output::price_field(std::string_view key, double price){
+    field_separator();
+    if(format_ == OutputFormat::JSON){
+        append_json_string(key);
+        buffer_.push_back(':');
+        append_price(price, "null");
+    }
+    else if(format_ == OutputFormat::TSV){append_price(price, "out-of-stock");}
+    else{append_price(price, "out of stock");}
+}
+
+void Output::count_field(std::string_view key, std::uint64_t count){
+    field_separator();
+    if(format_ == OutputFormat::JSON){
+        append_json_string(key);
+        buffer_.push_back(':');
+    }
+    char digits[24];
+    auto result = std::to_chars(digits, digits + sizeof(digits), count);
+    buffer_.append(digits, result.ptr);
+}
+
+void Output::row_end(){
+    if(format_ == OutputFormat::JSON){buffer_.push_back('}');}
+    else{end_line();}
+}
+
+void Output::end(){
+    if(format_ == OutputFormat::JSON){
+        buffer_.append(firstRow_ ? ",\"results\":[]}\n" : "]}\n");
+        flush_if_big();
+    }
+}
+
+void Output::error(std::string_view command, std::string_view message){
+    if(is_text()){
+        text(message).end_line();
+        return;
+    }
+    //the machine readable formats don't repeat the "Error: " of the text
+    const std::string_view errorPrefix = "Error: ";
+    if(message.substr(0, errorPrefix.size()) == errorPrefix){
+        message.remove_prefix(errorPrefix.size());
+    }
+    if(format_ == OutputFormat::JSON){
+        buffer_.append("{\"command\":");
+        append_json_string(command);
+        buffer_.append(",\"error\":");
+        append_json_string(message);
+        buffer_.append("}\n");
+    }
+    else{
+        buffer_.append("error\t");
+        append_tsv_value(message);
+        buffer_.push_back('\n');
+    }
+}
+
+void Output::flush(){
+    if(buffer_.empty()){return;}
+    std::fwrite(buffer_.data(), 1, buffer_.size(), stdout);
+    std::fflush(stdout);
+    buffer_.clear();
+}
+
+void Output::field_separator(){
+    if(firstField_){
+        firstField_ = false;
+        return;
+    }
+    if(format_ == OutputFormat::JSON){buffer_.push_back(',');}
+    else if(format_ == OutputFormat::TSV){buffer_.push_back('\t');}
+    else{buffer_.push_back(' ');}
+}
+
+void Output::append_json_string(std::string_view value){
+    const char* hexDigits = "0123456789abcdef";
+    buffer_.push_back('"');
+    for(char c:value){
+        unsigned char byte = static_cast<unsigned char>(c);
+        if(c == '"' or c == '\\'){
+            buffer_.push_back('\\');
+            buffer_.push_back(c);
+        }
+        //control characters must be escaped; other bytes are kept (utf-8)
+        else if(byte < 0x20){
+            buffer_.append("\\u00");
+            buffer_.push_back(hexDigits[byte >> 4]);
+            buffer_.push_back(hexDigits[byte & 0xf]);
+        }
+        else{buffer_.push_back(c);}
+    }
+    buffer_.push_back('"');
+}
+
+void Output::append_tsv_value(std::string_view value){
+    //a tab inside a value would split it in two
+    for(char c:value){
+        if(c == '\t'){buffer_.append("\\t");}
+        else if(c == '\\'){buffer_.append("\\\\");}
+        else{buffer_.push_back(c);}
+    }
+}
+
+void Output::append_price(double price, std::string_view outOfStock){
+    if(price == -1.0){
+        buffer_.append(outOfStock);
+        return;
+    }
+    //the input may give inf or nan, which JSON has no numbers for
+    if(format_ == OutputFormat::JSON and not std::isfinite(price)){
+        buffer_.append("null");
+        return;
+    }
+    //the longest double written with 2 decimals is about 312 characters
+    char digits[320];
+    auto result = std::to_chars(digits, digits + sizeof(digits), price,
+                                std::chars_format::fixed, 2);
+    buffer_.append(digits, result.ptr);
+}
+
+void Output::flush_if_big(){
+    if(buffer_.size() >= FLUSH_SIZE){flush();}
+}
@@ -0,0 +1,109 @@
+/* Chain stores - output
+ *
+ * Desc:
+ *   Everything the program prints goes through one Output object. The
+ * text is collected into a buffer which is reused for the whole run and
+ * written out with one call when input is needed from the user (or when
+ * the buffer grows big), thus a long listing costs a few large writes
+ * instead of one flush per line. Prices are formatted with to_chars.
+ *   Besides the normal text, the results can be printed for other
+ * programs (selected with --format, see main.cpp):
+ *   json - one JSON object per command on its own line:
+ *          {"command":"selection","chain":"Prisma","store":"Kaleva",
+ *           "results":[{"product":"bread","price":2.40}, ...]}
+ *          a failed command is {"command":"...","error":"..."};
+ *          an out-of-stock price is null, so is an infinite or nan
+ *          one (possible in the input)
+ *   tsv  - one line per result, fields separated by tabs, the
+ *          attributes of the command (e.g. chain and store of selection)
+ *          first; a failed command is "error<TAB>message";
+ *          an out-of-stock price is "out-of-stock"
+ *   The prompts are printed only in the text format.
+ *
+ * Program author
+ * Name: Ruowen Liu
+ * Student number: -
+ * UserID: -
+ * E-Mail: ruowen.liu@tuni.fi
+ * */
+
+#ifndef OUTPUT_HH
+#define OUTPUT_HH
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+enum class OutputFormat {
+    TEXT,
+    JSON,
+    TSV
+};
+
+/**
+ * @brief read_output_format - convert a command line option
+ * @param option             - "--format=text", "--format=json" or
+ *                             "--format=tsv"
+ * @param format             - the converted value
+ * @return false if the option is none of the above
+ */
+bool read_output_format(std::string_view option, OutputFormat& format);
+
+/* A price of -1.0 means out of stock everywhere in this class, the same
+ * way as in the data structure of main.cpp.
+ *
+ * A result is printed as
+ *   begin(command), attribute()*, (row_begin(), field()*, row_end())*, end()
+ * In the text format the attributes are not printed and the fields of a
+ * row are separated by spaces; anything else the text needs (e.g. the
+ * header line of cheapest) is written with text() and price(). */
+class Output {
+public:
+    explicit Output(OutputFormat format = OutputFormat::TEXT);
+    ~Output();
+
+    OutputFormat format() const;
+    bool is_text() const;
+
+    //- - plain text - -
+    Output& text(std::string_view piece);
+    //%.2f
+    Output& price(double price);
+    Output& end_line();
+    //printed only in the text format; flushes, the user is going to type
+    void prompt(std::string_view prompt);
+
+    //- - results - -
+    void begin(std::string_view command);
+    void attribute(std::string_view key, std::string_view value);
+    void price_attribute(std::string_view key, double price);
+    void row_begin();
+    void field(std::string_view key, std::string_view value);
+    void price_field(std::string_view key, double price);
+    //a number, not quoted in JSON
+    void count_field(std::string_view key, std::uint64_t count);
+    void row_end();
+    void end();
+    //the whole output of a failed command; message is the text format
+    //line, e.g. "Error: unknown store"
+    void error(std::string_view command, std::string_view message);
+
+    //write the buffer to stdout
+    void flush();
+
+private:
+    void field_separator();
+    void append_json_string(std::string_view value);
+    void append_tsv_value(std::string_view value);
+    void append_price(double price, std::string_view outOfStock);
+    void flush_if_big();
+
+    OutputFormat format_;
+    std::string buffer_;
+    //tsv: the attributes of the current result, written before each row
+    std::string tsvPrefix_;
+    bool firstRow_ = true;
+    bool firstField_ = true;
+};
+
+#endif // OUTPUT_HH
@@ -0,0 +1,317 @@
+/* Chain stores - query
+ *
+ * Desc:
+ *   Implementation of the queries. See query.hh.
+ *   parse_query turns every name predicate into a table with one byte per
+ * chain, store or product code. run_query then goes through the columns
+ * BATCH_SIZE offers at a time: each predicate ands its result into a byte
+ * mask of the batch, and the rows left in the mask are collected or
+ * added to the groups.
+ *
+ * Program author
+ * Name: Ruowen Liu
+ * Student number: -
+ * UserID: -
+ * E-Mail: ruowen.liu@tuni.fi
+ * */
+
+#include "query.hh"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+//small enough for the mask and the row numbers to stay in the L1 cache
+const std::size_t BATCH_SIZE = 1024;
+
+//the "=" and "!=" predicates on one kind of name
+struct NameFilter {
+    bool anyKept = false;
+    std::vector<std::uint32_t> kept;
+    std::vector<std::uint32_t> left;
+};
+
+//an instock-at or outofstock-at predicate
+struct StockAtFilter {
+    bool found;
+    ChainId chain;
+    bool inStock;
+};
+
+std::vector<std::uint8_t> make_table(std::size_t size,
+                                     const NameFilter& filter){
+    if(not filter.anyKept and filter.left.empty()){return {};}
+    std::vector<std::uint8_t> table(size, filter.anyKept ? 0 : 1);
+    for(auto code:filter.kept){table[code] = 1;}
+    for(auto code:filter.left){table[code] = 0;}
+    return table;
+}
+
+//the codes of the stores named so, in every chain
+void find_stores(const Catalog& catalog, std::string_view storeName,
+                 std::vector<std::uint32_t>& codes){
+    for(StoreId store = 0; store < catalog.store_count(); ++store){
+        if(catalog.name(catalog.store_name(store)) == storeName){
+            codes.push_back(store);
+        }
+    }
+}
+
+bool read_query_price(std::string_view text, double& price){
+    //the whole text must be the number
+    return not text.empty() and read_number(text, price) == text.size();
+}
+
+//and the rows of a batch whose code is not kept out of the mask
+void filter_codes(const std::vector<std::uint8_t>& table,
+                  const std::uint32_t* codes, std::size_t length,
+                  std::uint8_t* selected){
+    if(table.empty()){return;}
+    for(std::size_t i = 0; i < length; ++i){
+        selected[i] &= table[codes[i]];
+    }
+}
+
+} // namespace
+
+bool query_lists_offers(const Query& query){
+    return query.groupBy == Query::GroupBy::NONE and query.aggregates.empty();
+}
+
+bool parse_query(const Catalog& catalog, std::string_view text,
+                 Query& query){
+    query = Query();
+    NameFilter chains, stores, products;
+    std::vector<StockAtFilter> stockAt;
+    bool stockGiven = false;
+    bool groupGiven = false;
+    bool expectGroup = false;
+
+    while(true){
+        std::size_t wordBegin = text.find_first_not_of(" \t");
+        if(wordBegin == std::string_view::npos){break;}
+        text.remove_prefix(wordBegin);
+        std::string_view word = text.substr(0, text.find_first_of(" \t"));
+        text.remove_prefix(word.size());
+
+        if(expectGroup){
+            if(word == "chain"){query.groupBy = Query::GroupBy::CHAIN;}
+            else if(word == "store"){query.groupBy = Query::GroupBy::STORE;}
+            else if(word == "product"){query.groupBy = Query::GroupBy::PRODUCT;}
+            else{return false;}
+            expectGroup = false;
+            continue;
+        }
+        if(word == "by"){
+            if(groupGiven){return false;}
+            groupGiven = true;
+            expectGroup = true;
+            continue;
+        }
+        if(word == "count"){
+            query.aggregates.push_back(Query::Aggregate::COUNT);
+            continue;
+        }
+        if(word == "min"){
+            query.aggregates.push_back(Query::Aggregate::MIN);
+            continue;
+        }
+        if(word == "max"){
+            query.aggregates.push_back(Query::Aggregate::MAX);
+            continue;
+        }
+        if(word == "instock" or word == "outofstock"){
+            //both at once would be a contradiction
+            if(stockGiven){return false;}
+            stockGiven = true;
+            query.stock = word == "instock" ? Query::Stock::IN
+                                            : Query::Stock::OUT;
+            continue;
+        }
+
+        //key, operator and value, e.g. "price<=2.50"
+        std::size_t operatorBegin = word.find_first_of("!<>=");
+        if(operatorBegin == std::string_view::npos or operatorBegin == 0){
+            return false;
+        }
+        std::string_view key = word.substr(0, operatorBegin);
+        std::string_view rest = word.substr(operatorBegin);
+        std::string_view op = rest.substr(0, 1);
+        if(rest.size() > 1 and rest[1] == '=' and rest[0] != '='){
+            op = rest.substr(0, 2);
+        }
+        std::string_view value = rest.substr(op.size());
+        if(value.empty()){return false;}
+
+        if(key == "price"){
+            double price = 0.0;
+            if(not read_query_price(value, price)){return false;}
+            const double infinity = std::numeric_limits<double>::infinity();
+            if(op == "<"){
+                query.highest = std::min(query.highest,
+                                         std::nextafter(price, -infinity));
+            }
+            else if(op == "<="){query.highest = std::min(query.highest, price);}
+            else if(op == ">"){
+                query.lowest = std::max(query.lowest,
+                                        std::nextafter(price, infinity));
+            }
+            else if(op == ">="){query.lowest = std::max(query.lowest, price);}
+            else if(op == "="){
+                query.lowest = std::max(query.lowest, price);
+                query.highest = std::min(query.highest, price);
+            }
+            else{return false;}
+            query.priceLimited = true;
+            continue;
+        }
+        if(key == "instock-at" or key == "outofstock-at"){
+            if(op != "="){return false;}
+            StockAtFilter filter = {false, 0, key == "instock-at"};
+            filter.found = catalog.find_chain(value, filter.chain);
+            stockAt.push_back(filter);
+            continue;
+        }
+
+        NameFilter* filter = nullptr;
+        if(key == "chain"){filter = &chains;}
+        else if(key == "store"){filter = &stores;}
+        else if(key == "product"){filter = &products;}
+        else{return false;}
+        std::vector<std::uint32_t>* codes = nullptr;
+        if(op == "="){
+            filter->anyKept = true;
+            codes = &filter->kept;
+        }
+        else if(op == "!="){codes = &filter->left;}
+        else{return false;}
+        std::uint32_t code = 0;
+        if(key == "chain"){
+            if(catalog.find_chain(value, code)){codes->push_back(code);}
+        }
+        else if(key == "store"){find_stores(catalog, value, *codes);}
+        else if(catalog.find_product(value, code)){codes->push_back(code);}
+    }
+    if(expectGroup){return false;}
+
+    query.chains = make_table(catalog.chains().size(), chains);
+    query.stores = make_table(catalog.store_count(), stores);
+    query.products = make_table(catalog.products().size(), products);
+
+    /* The stock of a product in a chain: the offers of a chain are
+     * consecutive in the columns, thus only that part is scanned */
+    const OfferColumns& columns = catalog.columns();
+    for(auto& filter:stockAt){
+        if(query.products.empty()){
+            query.products.assign(catalog.products().size(), 1);
+        }
+        std::vector<std::uint8_t> inStock(catalog.products().size(), 0);
+        if(filter.found){
+            auto range = std::equal_range(columns.chain.begin(),
+                                          columns.chain.end(), filter.chain);
+            for(auto i = static_cast<std::size_t>(range.first
+                                                  - columns.chain.begin());
+                i < static_cast<std::size_t>(range.second
+                                             - columns.chain.begin()); ++i){
+                inStock[columns.product[i]] |= columns.price[i] != -1.0;
+            }
+        }
+        std::uint8_t wanted = filter.inStock ? 1 : 0;
+        for(std::size_t product = 0; product < inStock.size(); ++product){
+            query.products[product] &= inStock[product] == wanted;
+        }
+    }
+    return true;
+}
+
+QueryResult run_query(const Catalog& catalog, const Query& query){
+    const OfferColumns& columns = catalog.columns();
+    const std::size_t offerCount = columns.price.size();
+    QueryResult result;
+    bool listing = query_lists_offers(query);
+
+    //the column giving the group of an offer; one group if not grouped
+    const std::uint32_t* keys = nullptr;
+    std::size_t groupCount = 1;
+    if(query.groupBy == Query::GroupBy::CHAIN){
+        keys = columns.chain.data();
+        groupCount = catalog.chains().size();
+    }
+    else if(query.groupBy == Query::GroupBy::STORE){
+        keys = columns.store.data();
+        groupCount = catalog.store_count();
+    }
+    else if(query.groupBy == Query::GroupBy::PRODUCT){
+        keys = columns.product.data();
+        groupCount = catalog.products().size();
+    }
+    std::vector<std::uint32_t> counts;
+    std::vector<double> lowest, highest;
+    if(not listing){
+        counts.assign(groupCount, 0);
+        lowest.assign(groupCount, std::numeric_limits<double>::infinity());
+        highest.assign(groupCount, -std::numeric_limits<double>::infinity());
+    }
+
+    std::uint8_t selected[BATCH_SIZE];
+    std::uint32_t rows[BATCH_SIZE];
+    for(std::size_t first = 0; first < offerCount; first += BATCH_SIZE){
+        const std::size_t length = std::min(BATCH_SIZE, offerCount - first);
+        std::fill(selected, selected + length, 1);
+        filter_codes(query.chains, columns.chain.data() + first, length,
+                     selected);
+        filter_codes(query.stores, columns.store.data() + first, length,
+                     selected);
+        filter_codes(query.products, columns.product.data() + first, length,
+                     selected);
+        const double* prices = columns.price.data() + first;
+        if(query.priceLimited){
+            for(std::size_t i = 0; i < length; ++i){
+                selected[i] &= (prices[i] != -1.0) & (prices[i] >= query.lowest)
+                        & (prices[i] <= query.highest);
+            }
+        }
+        if(query.stock == Query::Stock::IN){
+            for(std::size_t i = 0; i < length; ++i){
+                selected[i] &= prices[i] != -1.0;
+            }
+        }
+        else if(query.stock == Query::Stock::OUT){
+            for(std::size_t i = 0; i < length; ++i){
+                selected[i] &= prices[i] == -1.0;
+            }
+        }
+
+        //the rows left in the mask, without a branch per row
+        std::size_t kept = 0;
+        for(std::size_t i = 0; i < length; ++i){
+            rows[kept] = static_cast<std::uint32_t>(first + i);
+            kept += selected[i];
+        }
+        if(listing){
+            result.offers.insert(result.offers.end(), rows, rows + kept);
+            continue;
+        }
+        for(std::size_t i = 0; i < kept; ++i){
+            std::uint32_t key = keys == nullptr ? 0 : keys[rows[i]];
+            double price = columns.price[rows[i]];
+            ++counts[key];
+            if(price != -1.0){
+                lowest[key] = std::min(lowest[key], price);
+                highest[key] = std::max(highest[key], price);
+            }
+        }
+    }
+
+    if(listing){return result;}
+    for(std::uint32_t key = 0; key < groupCount; ++key){
+        //without grouping the only group is printed even when empty
+        if(counts[key] == 0 and keys != nullptr){continue;}
+        bool anyInStock = lowest[key] <= highest[key];
+        result.groups.push_back({key, counts[key],
+                                 anyInStock ? lowest[key] : -1.0,
+                                 anyInStock ? highest[key] : -1.0});
+    }
+    return result;
+}
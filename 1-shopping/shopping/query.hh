@@ -0,0 +1,108 @@
+/* Chain stores - query
+ *
+ * Desc:
+ *   Ad-hoc questions over all the offers of a catalog, e.g. "the products
+ * under 1.50 in chain S-market that are out of stock at Prisma":
+ *   chain=S-market price<1.50 outofstock-at=Prisma
+ * A query is a list of words separated by spaces:
+ *   chain=<name>, store=<name>, product=<name>
+ *                     - keep the offers of these; several of the same
+ *                       kind are alternatives (chain=A chain=B)
+ *   chain!=<name>, store!=<name>, product!=<name>
+ *                     - leave out the offers of these
+ *   price<p, price<=p, price>p, price>=p, price=p
+ *                     - keep the in-stock offers priced so
+ *   instock, outofstock
+ *                     - keep the offers in stock / out of stock
+ *   instock-at=<chain>, outofstock-at=<chain>
+ *                     - keep the products some store of the chain has in
+ *                       stock / no store of the chain has in stock
+ *   by chain, by store, by product
+ *                     - one result per chain, store or product
+ *   count, min, max   - the number of offers, and the lowest and highest
+ *                       in-stock price
+ * The words are all combined with "and". Without "by" and without
+ * aggregates the matching offers are listed; "by" alone counts them.
+ *   A name that is not in the catalog matches nothing. A store name
+ * matches the stores of that name in every chain.
+ *   The query is executed over the columns of the catalog (see
+ * OfferColumns in catalog.hh) in batches: the name predicates are turned
+ * into tables indexed by the dictionary code, so filtering a batch is a
+ * few table lookups and comparisons per offer, without strings or
+ * branches.
+ *
+ * Program author
+ * Name: Ruowen Liu
+ * Student number: -
+ * UserID: -
+ * E-Mail: ruowen.liu@tuni.fi
+ * */
+
+#ifndef QUERY_HH
+#define QUERY_HH
+
+#include "catalog.hh"
+
+#include <cstdint>
+#include <limits>
+#include <string_view>
+#include <vector>
+
+struct Query {
+    enum class Stock {ANY, IN, OUT};
+    enum class GroupBy {NONE, CHAIN, STORE, PRODUCT};
+    enum class Aggregate {COUNT, MIN, MAX};
+
+    //1 for the codes kept; an empty table keeps every code
+    std::vector<std::uint8_t> chains;
+    std::vector<std::uint8_t> stores;
+    std::vector<std::uint8_t> products;
+    //the in-stock prices kept, both limits included
+    bool priceLimited = false;
+    double lowest = -std::numeric_limits<double>::infinity();
+    double highest = std::numeric_limits<double>::infinity();
+    Stock stock = Stock::ANY;
+
+    GroupBy groupBy = GroupBy::NONE;
+    std::vector<Aggregate> aggregates;
+};
+
+//one result row of an aggregating query; lowest and highest are -1.0
+//when none of the offers is in stock
+struct QueryGroup {
+    //a chain, store or product, as given by Query::groupBy
+    std::uint32_t key;
+    std::uint32_t count;
+    double lowest;
+    double highest;
+};
+
+struct QueryResult {
+    //the rows of the matching offers in the columns, when listing
+    std::vector<std::uint32_t> offers;
+    //otherwise the groups, in the order of the keys (one group when
+    //not grouped)
+    std::vector<QueryGroup> groups;
+};
+
+/**
+ * @brief parse_query - read the words of a query (see above)
+ * @param catalog     - where the names are looked up
+ * @param text        - the query
+ * @param query       - the parsed query
+ * @return false if a word is not understood
+ */
+bool parse_query(const Catalog& catalog, std::string_view text, Query& query);
+
+/**
+ * @brief run_query - find the offers matching a query
+ * @param catalog   - the catalog queried
+ * @param query     - a query given by parse_query
+ * @return the listed offers or the groups
+ */
+QueryResult run_query(const Catalog& catalog, const Query& query);
+
+//true if the query lists offers instead of aggregating them
+bool query_lists_offers(const Query& query);
+
+#endif // QUERY_HH
@@ -0,0 +1,32 @@
+/* Chain stores - query log
+ *
+ * Desc:
+ *   Implementation of the query log. See querylog.hh.
+ *
+ * Program author
+ * Name: Ruowen Liu
+ * Student number: -
+ * UserID: -
+ * E-Mail: ruowen.liu@tuni.fi
+ * */
+
+#include "querylog.hh"
+
+bool QueryLog::open(const std::string& path){
+    file_.open(path, std::ios::trunc);
+    if(not file_){return false;}
+    file_ << "# shopping query log" << std::endl;
+    start();
+    return file_.good();
+}
+
+void QueryLog::start(){
+    start_ = std::chrono::steady_clock::now();
+}
+
+void QueryLog::record(std::string_view commandLine){
+    if(not file_.is_open()){return;}
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - start_);
+    file_ << elapsed.count() << '\t' << commandLine << std::endl;
+}
@@ -0,0 +1,47 @@
+/* Chain stores - query log
+ *
+ * Desc:
+ *   Records the commands typed at the "> " prompt (started with
+ * --record <log file>, see main.cpp), for replaying them later with the
+ * replay tool (see replay.cpp). The log is a text file: a header line
+ * starting with '#', then one line per command:
+ *   <microseconds since the first prompt><TAB><the command line>
+ * Every line is written out right away, thus the log is complete even if
+ * the program is stopped without quit.
+ *
+ * Program author
+ * Name: Ruowen Liu
+ * Student number: -
+ * UserID: -
+ * E-Mail: ruowen.liu@tuni.fi
+ * */
+
+#ifndef QUERYLOG_HH
+#define QUERYLOG_HH
+
+#include <chrono>
+#include <fstream>
+#include <string>
+#include <string_view>
+
+class QueryLog {
+public:
+    /**
+     * @brief open - start recording into a file (replacing it)
+     * @param path - the log file
+     * @return false if the file can't be written
+     */
+    bool open(const std::string& path);
+
+    //the times are counted from here; call at the first prompt
+    void start();
+
+    //nothing happens when the log is not open
+    void record(std::string_view commandLine);
+
+private:
+    std::ofstream file_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+#endif // QUERYLOG_HH
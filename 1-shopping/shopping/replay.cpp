@@ -0,0 +1,346 @@
+/* Chain stores - replay
+ *
+ * Desc:
+ *   Replays a query log recorded with shopping --record (see
+ * querylog.hh) against a shopping program and an input file, and
+ * reports the latency of the commands and the throughput.
+ *   Usage: replay <shopping program> <input file> <log file>
+ *                 [--streams=N] [--speed=original|max]
+ *   Every stream runs its own shopping program, which loads the input
+ * file, and sends it all the commands of the log, one after the other.
+ * The latency of a command is the time from writing the command line to
+ * receiving the next "> " prompt. The streams start replaying together
+ * when all of them have loaded the input.
+ *   --speed=original waits until the time a command was typed (counted
+ * from the first prompt) before sending it; --speed=max (the default)
+ * sends the next command as soon as the previous one is answered.
+ *   Since the program is run as it is, the same log can be replayed
+ * against two builds to compare them.
+ *
+ * Program author
+ * Name: Ruowen Liu
+ * Student number: -
+ * UserID: -
+ * E-Mail: ruowen.liu@tuni.fi
+ * */
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <csignal>
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace std;
+
+using Clock = chrono::steady_clock;
+
+namespace {
+
+const size_t READ_SIZE = size_t(1) << 16;
+
+//one line of the log
+struct LoggedCommand {
+    long long micros;
+    string line;
+};
+
+//the latency of one replayed command
+struct Sample {
+    size_t command;
+    double micros;
+};
+
+/**
+ * @brief read_log - read the commands of a query log
+ * @param path     - the log file
+ * @param commands - the commands, in the order of the log
+ * @return false if the file can't be read or a line is not
+ *         "<microseconds><TAB><command>"
+ */
+bool read_log(const string& path, vector<LoggedCommand>& commands){
+    ifstream file(path);
+    if(!file){return false;}
+    string line;
+    while(getline(file, line)){
+        if(!line.empty() and line[0] == '#'){continue;}
+        size_t tab = line.find('\t');
+        if(tab == string::npos){return false;}
+        try{
+            commands.push_back({stoll(line.substr(0, tab)),
+                                line.substr(tab + 1)});
+        }
+        catch(const exception&){return false;}
+    }
+    return true;
+}
+
+//the first word of a command line
+string command_name(const string& line){
+    stringstream stream(line);
+    string name;
+    stream >> name;
+    return name.empty() ? "(empty)" : name;
+}
+
+/**
+ * @brief The Session class - a running shopping program, talked to
+ *        through pipes
+ */
+class Session {
+public:
+    ~Session(){finish();}
+
+    //start the program and load the input file
+    bool start(const string& program, const string& inputFile){
+        /* close-on-exec: the sessions of the other streams fork at the
+         * same time, and a child holding the write end of another
+         * session's pipe would keep its reader from seeing the end */
+        int toChild[2];
+        int fromChild[2];
+        if(pipe2(toChild, O_CLOEXEC) != 0){return false;}
+        if(pipe2(fromChild, O_CLOEXEC) != 0){
+            close(toChild[0]);
+            close(toChild[1]);
+            return false;
+        }
+        pid_ = fork();
+        if(pid_ < 0){
+            for(int fd:{toChild[0], toChild[1], fromChild[0], fromChild[1]}){
+                close(fd);
+            }
+            return false;
+        }
+        if(pid_ == 0){
+            //dup2 clears close-on-exec of the standard streams
+            dup2(toChild[0], STDIN_FILENO);
+            dup2(fromChild[1], STDOUT_FILENO);
+            close(toChild[0]);
+            close(toChild[1]);
+            close(fromChild[0]);
+            close(fromChild[1]);
+            execl(program.c_str(), program.c_str(),
+                  static_cast<char*>(nullptr));
+            _exit(127);
+        }
+        close(toChild[0]);
+        close(fromChild[1]);
+        toChild_ = toChild[1];
+        fromChild_ = fromChild[0];
+        //"Input file: " is followed by the first "> " right away
+        return send(inputFile) and wait_prompt(true);
+    }
+
+    //false if the program stopped instead of answering
+    bool run(const string& line){
+        return send(line) and wait_prompt(false);
+    }
+
+    //send quit (if still running) and wait for the program to stop
+    void finish(){
+        if(pid_ <= 0){return;}
+        send("quit");
+        close(toChild_);
+        char buffer[READ_SIZE];
+        while(read(fromChild_, buffer, sizeof(buffer)) > 0){}
+        close(fromChild_);
+        waitpid(pid_, nullptr, 0);
+        pid_ = -1;
+    }
+
+private:
+    bool send(const string& line){
+        string text = line + "\n";
+        size_t written = 0;
+        while(written < text.size()){
+            ssize_t count = write(toChild_, text.data() + written,
+                                  text.size() - written);
+            if(count <= 0){return false;}
+            written += static_cast<size_t>(count);
+        }
+        return true;
+    }
+
+    /* The answer ends with a prompt at the start of a line (every result
+     * line ends with '\n'); only the last 3 characters are kept */
+    bool wait_prompt(bool first){
+        char buffer[READ_SIZE];
+        string tail;
+        size_t received = 0;
+        while(true){
+            ssize_t count = read(fromChild_, buffer, sizeof(buffer));
+            if(count <= 0){return false;}
+            received += static_cast<size_t>(count);
+            tail.append(buffer, static_cast<size_t>(count));
+            if(tail.size() > 3){tail.erase(0, tail.size() - 3);}
+            bool endsWithPrompt = tail.size() >= 2
+                    and tail.compare(tail.size() - 2, 2, "> ") == 0;
+            if(endsWithPrompt and (first or received == 2 or tail[0] == '\n')){
+                return true;
+            }
+        }
+    }
+
+    pid_t pid_ = -1;
+    int toChild_ = -1;
+    int fromChild_ = -1;
+};
+
+//the streams wait here until all of them have loaded the input
+class StartLine {
+public:
+    explicit StartLine(size_t streams) : waiting_(streams) {}
+
+    Clock::time_point arrive(){
+        unique_lock<mutex> lock(mutex_);
+        if(--waiting_ == 0){
+            start_ = Clock::now();
+            allArrived_.notify_all();
+        }
+        else{allArrived_.wait(lock, [this](){return waiting_ == 0;});}
+        return start_;
+    }
+
+    Clock::time_point start() const { return start_; }
+
+private:
+    mutex mutex_;
+    condition_variable allArrived_;
+    size_t waiting_;
+    Clock::time_point start_;
+};
+
+//nearest-rank percentile of sorted values
+double percentile(const vector<double>& sorted, double percent){
+    if(sorted.empty()){return 0.0;}
+    size_t rank = static_cast<size_t>(percent / 100.0 * sorted.size()
+                                      + 0.999999);
+    return sorted[min(sorted.size(), max<size_t>(rank, 1)) - 1];
+}
+
+void print_latencies(const string& name, vector<double>& micros){
+    sort(micros.begin(), micros.end());
+    char line[160];
+    snprintf(line, sizeof(line),
+             "%-14s %8zu %10.1f %10.1f %10.1f %10.1f %10.1f", name.c_str(),
+             micros.size(), percentile(micros, 50), percentile(micros, 90),
+             percentile(micros, 99), percentile(micros, 99.9),
+             micros.empty() ? 0.0 : micros.back());
+    cout << line << endl;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]){
+    if(argc < 4){
+        cerr << "Usage: " << argv[0] << " <shopping program> <input file>"
+             << " <log file> [--streams=N] [--speed=original|max]" << endl;
+        return EXIT_FAILURE;
+    }
+    string program = argv[1];
+    string inputFile = argv[2];
+    string logPath = argv[3];
+    size_t streamCount = 1;
+    bool originalSpeed = false;
+    for(int i = 4; i < argc; ++i){
+        string option = argv[i];
+        if(option.rfind("--streams=", 0) == 0){
+            int streams = atoi(option.c_str() + 10);
+            streamCount = static_cast<size_t>(max(1, streams));
+        }
+        else if(option == "--speed=original"){originalSpeed = true;}
+        else if(option == "--speed=max"){originalSpeed = false;}
+        else{
+            cerr << "Error: unknown option " << option << endl;
+            return EXIT_FAILURE;
+        }
+    }
+    vector<LoggedCommand> commands;
+    if(!read_log(logPath, commands)){
+        cerr << "Error: the log file cannot be read" << endl;
+        return EXIT_FAILURE;
+    }
+    //the replay stops at quit, as the program would
+    auto quit = find_if(commands.begin(), commands.end(),
+                        [](const LoggedCommand& command){
+        return command.line == "quit";
+    });
+    commands.erase(quit, commands.end());
+    //a stream whose program stops must not kill the replay
+    signal(SIGPIPE, SIG_IGN);
+
+    vector<vector<Sample>> samples(streamCount);
+    vector<char> failed(streamCount, false);
+    StartLine startLine(streamCount);
+    vector<thread> streams;
+    for(size_t stream = 0; stream < streamCount; ++stream){
+        streams.emplace_back([&, stream](){
+            Session session;
+            bool started = session.start(program, inputFile);
+            if(!started){failed[stream] = true;}
+            Clock::time_point start = startLine.arrive();
+            if(!started){return;}
+            samples[stream].reserve(commands.size());
+            for(size_t i = 0; i < commands.size(); ++i){
+                if(originalSpeed){
+                    auto typed = chrono::microseconds(commands[i].micros);
+                    this_thread::sleep_until(start + typed);
+                }
+                Clock::time_point sent = Clock::now();
+                if(!session.run(commands[i].line)){
+                    failed[stream] = true;
+                    return;
+                }
+                double micros = chrono::duration<double, micro>(
+                            Clock::now() - sent).count();
+                samples[stream].push_back({i, micros});
+            }
+        });
+    }
+    for(auto& stream:streams){stream.join();}
+    double seconds = chrono::duration<double>(Clock::now() - startLine.start())
+            .count();
+
+    size_t failedCount = static_cast<size_t>(count(failed.begin(),
+                                                   failed.end(), true));
+    if(failedCount == streamCount){
+        cerr << "Error: the program could not load the input file" << endl;
+        return EXIT_FAILURE;
+    }
+    vector<double> all;
+    map<string, vector<double>> byCommand;
+    for(auto& streamSamples:samples){
+        for(auto& sample:streamSamples){
+            all.push_back(sample.micros);
+            byCommand[command_name(commands[sample.command].line)]
+                    .push_back(sample.micros);
+        }
+    }
+    cout << "replayed " << commands.size() << " commands x " << streamCount
+         << " streams at " << (originalSpeed ? "original" : "max")
+         << " speed" << endl;
+    char summary[160];
+    snprintf(summary, sizeof(summary),
+             "%zu commands in %.3f s, %.0f commands/s",
+             all.size(), seconds, all.size() / seconds);
+    cout << summary << endl;
+    if(failedCount != 0){
+        cout << failedCount << " streams stopped early" << endl;
+    }
+    cout << "command           count    p50 us     p90 us     p99 us"
+         << "   p99.9 us     max us" << endl;
+    print_latencies("all", all);
+    for(auto& [name, micros]:byCommand){print_latencies(name, micros);}
+    return failedCount == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
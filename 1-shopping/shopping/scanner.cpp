@@ -0,0 +1,226 @@
+/* Chain stores - structural scanner
+ *
+ * Desc:
+ *   Implementation of the one-sweep delimiter scan. See scanner.hh.
+ *
+ * Program author
+ * Name: Ruowen Liu
+ * Student number: -
+ * UserID: -
+ * E-Mail: ruowen.liu@tuni.fi
+ * */
+
+#include "scanner.hh"
+
+#include <cctype>
+#include <charconv>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SCANNER_X86 1
+#endif
+
+namespace {
+
+//- - - - - - the sweep, one version per instruction set - - - - - -
+/* Every version writes the offsets to out and returns the amount of them.
+ * out must have room for size + 1 offsets (the worst case: every byte
+ * is structural). */
+
+std::size_t sweep_scalar(const char* data, std::size_t size,
+                         std::size_t from, std::uint32_t* out){
+    std::size_t count = 0;
+    for(std::size_t i = from; i < size; ++i){
+        char c = data[i];
+        if(c == ';' or c == '\n' or c == ' '){
+            out[count++] = static_cast<std::uint32_t>(i);
+        }
+    }
+    return count;
+}
+
+#ifdef SCANNER_X86
+/* turn one bit mask (bit i set = byte base + i is structural)
+ * into offsets */
+inline std::size_t flatten_mask(std::uint32_t mask, std::size_t base,
+                                std::uint32_t* out){
+    std::size_t count = 0;
+    while(mask){
+        out[count++] = static_cast<std::uint32_t>(
+                    base + static_cast<std::size_t>(__builtin_ctz(mask)));
+        mask &= mask - 1;
+    }
+    return count;
+}
+
+__attribute__((target("sse2")))
+std::size_t sweep_sse2(const char* data, std::size_t size,
+                       std::uint32_t* out){
+    const __m128i semicolons = _mm_set1_epi8(';');
+    const __m128i newlines = _mm_set1_epi8('\n');
+    const __m128i spaces = _mm_set1_epi8(' ');
+    std::size_t count = 0;
+    std::size_t i = 0;
+    for(; i + 16 <= size; i += 16){
+        __m128i block = _mm_loadu_si128(
+                    reinterpret_cast<const __m128i*>(data + i));
+        __m128i hits = _mm_or_si128(
+                    _mm_or_si128(_mm_cmpeq_epi8(block, semicolons),
+                                 _mm_cmpeq_epi8(block, newlines)),
+                    _mm_cmpeq_epi8(block, spaces));
+        std::uint32_t mask =
+                static_cast<std::uint32_t>(_mm_movemask_epi8(hits));
+        count += flatten_mask(mask, i, out + count);
+    }
+    //the tail shorter than one vector
+    return count + sweep_scalar(data, size, i, out + count);
+}
+
+__attribute__((target("avx2")))
+std::size_t sweep_avx2(const char* data, std::size_t size,
+                       std::uint32_t* out){
+    const __m256i semicolons = _mm256_set1_epi8(';');
+    const __m256i newlines = _mm256_set1_epi8('\n');
+    const __m256i spaces = _mm256_set1_epi8(' ');
+    std::size_t count = 0;
+    std::size_t i = 0;
+    for(; i + 32 <= size; i += 32){
+        __m256i block = _mm256_loadu_si256(
+                    reinterpret_cast<const __m256i*>(data + i));
+        __m256i hits = _mm256_or_si256(
+                    _mm256_or_si256(_mm256_cmpeq_epi8(block, semicolons),
+                                    _mm256_cmpeq_epi8(block, newlines)),
+                    _mm256_cmpeq_epi8(block, spaces));
+        std::uint32_t mask =
+                static_cast<std::uint32_t>(_mm256_movemask_epi8(hits));
+        count += flatten_mask(mask, i, out + count);
+    }
+    return count + sweep_scalar(data, size, i, out + count);
+}
+#endif
+
+using SweepFunc = std::size_t (*)(const char*, std::size_t, std::uint32_t*);
+
+std::size_t sweep_portable(const char* data, std::size_t size,
+                           std::uint32_t* out){
+    return sweep_scalar(data, size, 0, out);
+}
+
+//pick the widest version the CPU supports, once
+SweepFunc select_sweep(const char*& isaName){
+#ifdef SCANNER_X86
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx2")){
+        isaName = "avx2";
+        return sweep_avx2;
+    }
+    if(__builtin_cpu_supports("sse2")){
+        isaName = "sse2";
+        return sweep_sse2;
+    }
+#endif
+    isaName = "scalar";
+    return sweep_portable;
+}
+
+const char* selectedIsa = "scalar";
+const SweepFunc sweep = select_sweep(selectedIsa);
+
+} // namespace
+
+void StructuralIndex::build(const char* data, std::size_t size){
+    if(capacity_ < size + 1){
+        positions_.reset(new std::uint32_t[size + 1]);
+        capacity_ = size + 1;
+    }
+    count_ = sweep(data, size, positions_.get());
+}
+
+bool scan_rows(const char* data, std::size_t size,
+               StructuralIndex& index, std::vector<RowFields>& rows){
+    index.build(data, size);
+    /* Walk the offsets row by row. fieldStart[k] is where field k begins;
+     * a field ends at the next ';' (or at the end of the line for the
+     * fourth field when there is no fourth ';').
+     * Only the first four fields matter, thus a space or ';' found after
+     * the fourth field is skipped. */
+    std::size_t rowStart = 0;
+    std::size_t fieldStart[4] = {0, 0, 0, 0};
+    std::size_t fieldEnd[4] = {0, 0, 0, 0};
+    int fieldsDone = 0;
+    bool hasSpace = false;
+
+    auto finish_row = [&](std::size_t lineEnd) -> bool {
+        //a missing field is an empty one, like with getline
+        for(int k = fieldsDone; k < 4; ++k){
+            fieldStart[k] = (k == fieldsDone) ? fieldStart[k] : lineEnd;
+            fieldEnd[k] = lineEnd;
+        }
+        for(int k = 0; k < 4; ++k){
+            if(fieldEnd[k] == fieldStart[k]){return false;}
+        }
+        if(hasSpace){return false;}
+        rows.push_back({{data + fieldStart[0], fieldEnd[0] - fieldStart[0]},
+                        {data + fieldStart[1], fieldEnd[1] - fieldStart[1]},
+                        {data + fieldStart[2], fieldEnd[2] - fieldStart[2]},
+                        {data + fieldStart[3], fieldEnd[3] - fieldStart[3]}});
+        return true;
+    };
+
+    fieldStart[0] = rowStart;
+    for(std::uint32_t position:index){
+        char c = data[position];
+        if(c == '\n'){
+            if(!finish_row(position)){return false;}
+            rowStart = position + 1;
+            fieldStart[0] = rowStart;
+            fieldsDone = 0;
+            hasSpace = false;
+        }
+        else if(fieldsDone < 4){
+            if(c == ' '){hasSpace = true;}
+            //c is ';' ==> current field ends here
+            else{
+                fieldEnd[fieldsDone] = position;
+                ++fieldsDone;
+                if(fieldsDone < 4){fieldStart[fieldsDone] = position + 1;}
+            }
+        }
+    }
+    //the last line may come without the line break
+    if(rowStart < size){
+        return finish_row(size);
+    }
+    return true;
+}
+
+std::size_t read_number(std::string_view text, double& value){
+    const char* begin = text.data();
+    const char* end = begin + text.size();
+    const char* next = begin;
+    while(next != end and std::isspace(static_cast<unsigned char>(*next))){
+        ++next;
+    }
+    //from_chars takes neither a '+' nor a "0x"
+    bool isNegative = next != end and *next == '-';
+    if(next != end and (*next == '+' or *next == '-')){++next;}
+    if(next == end or *next == '+' or *next == '-'){return 0;}
+    std::from_chars_result result{next, std::errc::invalid_argument};
+    bool isHex = end - next > 2 and next[0] == '0'
+            and (next[1] == 'x' or next[1] == 'X') and next[2] != '-';
+    if(isHex){
+        result = std::from_chars(next + 2, end, value,
+                                 std::chars_format::hex);
+    }
+    //"0x" without hexadecimal digits is read as 0 like stod does
+    if(result.ec == std::errc::invalid_argument){
+        result = std::from_chars(next, end, value);
+    }
+    if(result.ec != std::errc()){return 0;}
+    if(isNegative){value = -value;}
+    return static_cast<std::size_t>(result.ptr - begin);
+}
+
+const char* scanner_isa(){
+    return selectedIsa;
+}
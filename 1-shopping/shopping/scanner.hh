@@ -0,0 +1,96 @@
+/* Chain stores - structural scanner
+ *
+ * Desc:
+ *   The input file consists of lines of the form
+ * chain_store;store_location;product_name;product_price.
+ * Instead of splitting every line with getline and then searching each
+ * field for spaces, the scanner makes one sweep over a whole buffer and
+ * records the offsets of every ';', '\n' and ' ' character (the
+ * "structural index"). The rows are then cut and validated using only
+ * those offsets, so each byte of the input is examined once.
+ *   The sweep is vectorized with AVX2 or SSE2 when the CPU supports it
+ * and falls back to a plain loop otherwise.
+ *
+ * Program author
+ * Name: Ruowen Liu
+ * Student number: -
+ * UserID: -
+ * E-Mail: ruowen.liu@tuni.fi
+ * */
+
+#ifndef SCANNER_HH
+#define SCANNER_HH
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+/* The four fields of one input line. The views point into the buffer
+ * given to scan_rows, so the buffer must outlive the rows.
+ * */
+struct RowFields {
+    std::string_view chain;
+    std::string_view store;
+    std::string_view product;
+    std::string_view price;
+};
+
+/**
+ * @brief The StructuralIndex class - offsets of all ';', '\n' and ' '
+ *        characters of one buffer, in increasing order.
+ *        The storage is reused between builds, so one index can be used
+ *        for all the blocks of a file without reallocating.
+ */
+class StructuralIndex {
+public:
+    /**
+     * @brief build - sweep through the buffer and record the offsets
+     * @param data  - start of the buffer
+     * @param size  - length of the buffer (less than 4 GiB)
+     */
+    void build(const char* data, std::size_t size);
+
+    const std::uint32_t* begin() const { return positions_.get(); }
+    const std::uint32_t* end() const { return positions_.get() + count_; }
+    std::size_t size() const { return count_; }
+
+private:
+    std::unique_ptr<std::uint32_t[]> positions_;
+    std::size_t capacity_ = 0;
+    std::size_t count_ = 0;
+};
+
+/**
+ * @brief scan_rows - cut the buffer into rows and validate them;
+ *        a row is erroneous when one of its four fields is empty
+ *        or contains a space (anything after the fourth field is ignored,
+ *        the same way as with getline)
+ * @param data      - start of the buffer; the last row may end without '\n'
+ * @param size      - length of the buffer
+ * @param index     - reused index storage
+ * @param rows      - the valid rows are appended here
+ * @return false if an erroneous row was found
+ */
+bool scan_rows(const char* data, std::size_t size,
+               StructuralIndex& index, std::vector<RowFields>& rows);
+
+/**
+ * @brief read_number - read a number at the start of the text, the way
+ *        std::stod does: leading white space, an optional sign, then a
+ *        decimal or a 0x hexadecimal number, inf or nan
+ * @param text
+ * @param value       - the number read
+ * @return the count of the characters read, 0 if no number (also if out
+ *         of the range of double, where stod would throw)
+ */
+std::size_t read_number(std::string_view text, double& value);
+
+/**
+ * @brief scanner_isa - name of the instruction set the sweep uses
+ *        on this machine ("avx2", "sse2" or "scalar")
+ */
+const char* scanner_isa();
+
+#endif // SCANNER_HH
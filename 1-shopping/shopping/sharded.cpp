@@ -0,0 +1,102 @@
+/* Chain stores - sharded store
+ *
+ * Desc:
+ *   Implementation of the sharded store. See sharded.hh.
+ *
+ * Program author
+ * Name: Ruowen Liu
+ * Student number: -
+ * UserID: -
+ * E-Mail: ruowen.liu@tuni.fi
+ * */
+
+#include "sharded.hh"
+
+#include <algorithm>
+#include <thread>
+
+namespace {
+
+//several shards per thread, so that two writers seldom meet in one
+const std::size_t SHARDS_PER_THREAD = 8;
+
+} // namespace
+
+std::size_t ShardedStore::OfferKeyHash::operator()(const OfferKey& key) const {
+    std::size_t hash = key.chain;
+    hash = hash * 0x9E3779B97F4A7C15ull + key.store;
+    hash = hash * 0x9E3779B97F4A7C15ull + key.product;
+    return hash ^ (hash >> 29);
+}
+
+ShardedStore::ShardedStore(std::size_t shardCount){
+    if(shardCount == 0){
+        std::size_t threads = std::max(1u, std::thread::hardware_concurrency());
+        shardCount = threads * SHARDS_PER_THREAD;
+    }
+    for(std::size_t i = 0; i < shardCount; ++i){
+        shards_.push_back(std::make_unique<Shard>());
+    }
+}
+
+std::size_t ShardedStore::shard_of(std::string_view product) const {
+    return std::hash<std::string_view>()(product) % shards_.size();
+}
+
+bool ShardedStore::apply(const std::vector<RowFields>& rows){
+    //prices and shards first, without locks
+    std::vector<double> prices(rows.size());
+    std::vector<std::vector<std::uint32_t>> rowsOfShard(shards_.size());
+    for(std::size_t i = 0; i < rows.size(); ++i){
+        if(not parse_price(rows[i].price, prices[i])){return false;}
+        rowsOfShard[shard_of(rows[i].product)].push_back(
+                    static_cast<std::uint32_t>(i));
+    }
+    for(std::size_t shardIndex = 0; shardIndex < shards_.size(); ++shardIndex){
+        if(rowsOfShard[shardIndex].empty()){continue;}
+        Shard& shard = *shards_[shardIndex];
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        for(auto i:rowsOfShard[shardIndex]){
+            OfferKey key = {shard.names.intern(rows[i].chain),
+                            shard.names.intern(rows[i].store),
+                            shard.names.intern(rows[i].product)};
+            shard.prices[key] = prices[i];
+        }
+    }
+    return true;
+}
+
+void ShardedStore::read_shard(std::size_t shardIndex,
+                              const OfferVisitor& visit) const {
+    const Shard& shard = *shards_[shardIndex];
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    for(auto& [key, price]:shard.prices){
+        visit(shard.names.name(key.chain), shard.names.name(key.store),
+              shard.names.name(key.product), price);
+    }
+}
+
+bool ShardedStore::find(std::string_view chain, std::string_view store,
+                        std::string_view product, double& price) const {
+    const Shard& shard = *shards_[shard_of(product)];
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    OfferKey key = {0, 0, 0};
+    if(not shard.names.find(chain, key.chain)
+            or not shard.names.find(store, key.store)
+            or not shard.names.find(product, key.product)){
+        return false;
+    }
+    auto found = shard.prices.find(key);
+    if(found == shard.prices.end()){return false;}
+    price = found->second;
+    return true;
+}
+
+std::size_t ShardedStore::size() const {
+    std::size_t offerCount = 0;
+    for(auto& shard:shards_){
+        std::lock_guard<std::mutex> lock(shard->mutex);
+        offerCount += shard->prices.size();
+    }
+    return offerCount;
+}
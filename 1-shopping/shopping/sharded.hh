@@ -0,0 +1,97 @@
+/* Chain stores - sharded store
+ *
+ * Desc:
+ *   A store of offers that several threads can write at the same time,
+ * e.g. one per price feed. The offers are spread over shards by a hash
+ * of the product name; every shard has a lock, a dictionary of its names
+ * and the prices of its offers. A writer sorts a batch of rows by shard
+ * first, without any lock, and then takes the lock of each shard once
+ * for all the rows going to it, thus writers only wait for each other
+ * when they write the same shard at the same moment.
+ *   A reader locks one shard at a time: what it sees of a shard is the
+ * state between two batches, but two shards can be seen at different
+ * moments. Catalog::assign builds a catalog of the whole store this way.
+ *   Like in the input file, a later row of the same chain, store and
+ * product rewrites the price; among rows written by different threads at
+ * the same time, the one written last wins.
+ *
+ * Program author
+ * Name: Ruowen Liu
+ * Student number: -
+ * UserID: -
+ * E-Mail: ruowen.liu@tuni.fi
+ * */
+
+#ifndef SHARDED_HH
+#define SHARDED_HH
+
+#include "catalog.hh"
+#include "scanner.hh"
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+//called for the offers of a shard: chain, store, product and price
+using OfferVisitor = std::function<void(std::string_view, std::string_view,
+                                        std::string_view, double)>;
+
+class ShardedStore {
+public:
+    //shardCount 0: a number of shards suited to the machine
+    explicit ShardedStore(std::size_t shardCount = 0);
+
+    /**
+     * @brief apply - write a batch of rows; can be called by any number
+     *        of threads at the same time
+     * @param rows  - the rows; the views are not kept
+     * @return false if a price can't be read; nothing is written then
+     */
+    bool apply(const std::vector<RowFields>& rows);
+
+    std::size_t shard_count() const { return shards_.size(); }
+
+    /**
+     * @brief read_shard - go through the offers of a shard, under its lock
+     *        (writers of the shard wait until visit has seen them all)
+     * @param shard      - 0 ... shard_count() - 1
+     * @param visit      - called for every offer, in no particular order
+     */
+    void read_shard(std::size_t shard, const OfferVisitor& visit) const;
+
+    //the price of an offer; false if the store doesn't have the offer
+    bool find(std::string_view chain, std::string_view store,
+              std::string_view product, double& price) const;
+
+    //the number of offers (the shards are counted one after the other)
+    std::size_t size() const;
+
+private:
+    struct OfferKey {
+        NameId chain;
+        NameId store;
+        NameId product;
+        bool operator==(const OfferKey& other) const {
+            return chain == other.chain and store == other.store
+                    and product == other.product;
+        }
+    };
+    struct OfferKeyHash {
+        std::size_t operator()(const OfferKey& key) const;
+    };
+    struct Shard {
+        mutable std::mutex mutex;
+        Dictionary names;
+        std::unordered_map<OfferKey, double, OfferKeyHash> prices;
+    };
+
+    std::size_t shard_of(std::string_view product) const;
+
+    std::vector<std::unique_ptr<Shard>> shards_;
+};
+
+#endif // SHARDED_HH
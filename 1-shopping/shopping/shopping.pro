@@ -1,7 +1,18 @@
 TEMPLATE = app
-CONFIG += console c++11
+CONFIG += console c++17
 CONFIG -= app_bundle
 CONFIG -= qt
+CONFIG += thread
+
+include(catalog.pri)
 
 SOURCES += \
-        main.cpp
+        main.cpp \
+        output.cpp \
+        diff.cpp \
+        querylog.cpp
+
+HEADERS += \
+        output.hh \
+        diff.hh \
+        querylog.hh
@@ -0,0 +1,6 @@
+TEMPLATE = lib
+CONFIG += staticlib
+CONFIG -= qt
+TARGET = shoppingcatalog
+
+include(catalog.pri)
@@ -0,0 +1,48 @@
+/* Chain stores - price watches
+ *
+ * Desc:
+ *   Implementation of the watches. See watch.hh.
+ *
+ * Program author
+ * Name: Ruowen Liu
+ * Student number: -
+ * UserID: -
+ * E-Mail: ruowen.liu@tuni.fi
+ * */
+
+#include "watch.hh"
+
+#include <algorithm>
+
+void Watches::watch_below(ProductId product, double threshold){
+    std::vector<double>& below = byProduct_[product].below;
+    auto place = std::lower_bound(below.begin(), below.end(), threshold);
+    if(place == below.end() or *place != threshold){
+        below.insert(place, threshold);
+    }
+}
+
+void Watches::watch_in_stock(ProductId product){
+    byProduct_[product].inStock = true;
+}
+
+void Watches::check(ProductId product, double oldPrice, double newPrice,
+                    std::vector<Alert>& fired) const {
+    //only the changes into stock or to a lower price fire anything
+    if(newPrice == -1.0 or (oldPrice != -1.0 and newPrice >= oldPrice)){
+        return;
+    }
+    auto found = byProduct_.find(product);
+    if(found == byProduct_.end()){return;}
+    const ProductWatches& watches = found->second;
+    if(oldPrice == -1.0 and watches.inStock){fired.push_back({true, 0.0});}
+    //the prices p with newPrice < p <= oldPrice (out of stock is above all)
+    auto first = std::upper_bound(watches.below.begin(), watches.below.end(),
+                                  newPrice);
+    auto last = oldPrice == -1.0
+            ? watches.below.end()
+            : std::upper_bound(first, watches.below.end(), oldPrice);
+    for(auto threshold = first; threshold != last; ++threshold){
+        fired.push_back({false, *threshold});
+    }
+}
@@ -0,0 +1,67 @@
+/* Chain stores - price watches
+ *
+ * Desc:
+ *   Standing queries on the prices of products: "tell me when milk drops
+ * below 1.00 somewhere" (below) and "tell me when butter is back in stock
+ * somewhere" (in stock). A watch is checked only when the price of an
+ * offer of its product changes (see Catalog::update_price), and it fires
+ * on the change that makes it true:
+ *   below p  - an offer goes from out of stock or a price of at least p
+ *              to a price under p
+ *   in stock - an offer goes from out of stock to in stock
+ * A watch stays registered after firing, and fires again on the next such
+ * change. Registering the same watch again changes nothing.
+ *   The watches are kept per product, the below watches sorted by their
+ * price, thus a change finds the watches it fires by a binary search
+ * instead of going through all of them.
+ *
+ * Program author
+ * Name: Ruowen Liu
+ * Student number: -
+ * UserID: -
+ * E-Mail: ruowen.liu@tuni.fi
+ * */
+
+#ifndef WATCH_HH
+#define WATCH_HH
+
+#include "catalog.hh"
+
+#include <unordered_map>
+#include <vector>
+
+//a watch fired by a price change
+struct Alert {
+    bool inStock;
+    //the price of a below watch
+    double threshold;
+};
+
+class Watches {
+public:
+    void watch_below(ProductId product, double threshold);
+    void watch_in_stock(ProductId product);
+
+    /**
+     * @brief check - find the watches fired when the price of an offer
+     *        of a product changes
+     * @param product  - the product
+     * @param oldPrice - the price before, -1.0 for out of stock
+     * @param newPrice - the price after
+     * @param fired    - where the fired watches are added, the in-stock
+     *                   watch first, then the below watches by price
+     */
+    void check(ProductId product, double oldPrice, double newPrice,
+               std::vector<Alert>& fired) const;
+
+private:
+    struct ProductWatches {
+        //the prices of the below watches, ascending
+        std::vector<double> below;
+        bool inStock = false;
+    };
+
+    std::unordered_map<ProductId, ProductWatches> byProduct_;
+};
+
+#endif // WATCH_HH
@@ -14,8 +14,17 @@
 
 #include <iostream>
 #include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <thread>
 
-Cli::Cli(std::shared_ptr<Familytree> db) : database_(db)
+Cli::Cli(std::shared_ptr<Familytree> db, unsigned threads) :
+    database_(db),
+    threads_(threads != 0 ? threads
+                          : std::max(1u, std::thread::hardware_concurrency()))
 {
 }
 
@@ -26,14 +35,191 @@ bool Cli::exec_prompt()
     std::cout << PROMPT;
     std::getline(std::cin, line);
 
-    // Parsing command to the actual command and its parameters
-    std::vector<std::string> input = Utils::split(line, ' ');
-    if ( input.empty() or Utils::isEmpty(input.at(0)) )
+    std::vector<std::string> input;
+    CommandInfo* command = parse_command(line, input, std::cout);
+
+    // Checking special commands
+    if( command == nullptr )
     {
         return true;
     }
-    std::string command_str = input.front();
-    input.erase(input.begin());
+    if( command->id_ == "Q" )
+    {
+        return false;
+    }
+    if( command->id_ == "B" )
+    {
+        return exec_batch(input.at(0));
+    }
+
+    // Calling command method through the function pointer
+    (database_.get()->*(command->funcPtr_))(input, std::cout);
+    return true;
+}
+
+bool Cli::exec_batch(const std::string& filename)
+{
+    std::ifstream file(filename);
+    if( not file )
+    {
+        std::cout << "Error. Could not read " << filename << "."
+                  << std::endl;
+        return true;
+    }
+    if( batch_depth_ == MAX_BATCH_DEPTH )
+    {
+        std::cout << NESTED_BATCH << std::endl;
+        return true;
+    }
+
+    // Every line read gets its own output buffer until it is printed.
+    struct Query
+    {
+        CommandInfo* command_ = nullptr;
+        std::vector<std::string> params_;
+        std::ostringstream output_;
+        bool done_ = false;
+    };
+    // The lines not printed yet, of which the first taken ones have been
+    // taken by the workers; a deque keeps them in place when it grows.
+    std::deque<Query> queries;
+    std::size_t taken = 0;
+    bool closing = false;
+    std::mutex mutex;
+    std::condition_variable added;
+    std::condition_variable done;
+
+    // Takes the next query and runs it with the lock released.
+    auto runNext = [&](std::unique_lock<std::mutex>& lock)
+    {
+        Query& query = queries.at(taken++);
+        lock.unlock();
+        if( query.command_ != nullptr )
+        {
+            (database_.get()->*(query.command_->funcPtr_))(
+                        query.params_, query.output_);
+        }
+        lock.lock();
+        query.done_ = true;
+        done.notify_one();
+    };
+
+    // The workers take the next query until the batch is closed.
+    auto work = [&]()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        while( true )
+        {
+            added.wait(lock, [&]()
+            {
+                return closing or taken < queries.size();
+            });
+            if( taken == queries.size() )
+            {
+                return;
+            }
+            runNext(lock);
+        }
+    };
+
+    // In the order of the lines, with a prompt for each like typed: the
+    // ones done first, then the rest until at most keep are left. Instead
+    // of waiting, this thread runs the queries no worker has taken.
+    auto print = [&](std::size_t keep)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        while( not queries.empty()
+               and ( queries.front().done_ or queries.size() > keep ) )
+        {
+            if( not queries.front().done_ and taken < queries.size() )
+            {
+                runNext(lock);
+                continue;
+            }
+            done.wait(lock, [&]()
+            {
+                return queries.front().done_;
+            });
+            // Only this thread removes the done ones.
+            lock.unlock();
+            std::cout << PROMPT << queries.front().output_.str();
+            lock.lock();
+            queries.pop_front();
+            --taken;
+        }
+    };
+
+    std::size_t window = BATCH_WINDOW * threads_;
+    std::vector<std::thread> workers;
+    for( unsigned i = 1; i < threads_; ++i )
+    {
+        workers.emplace_back(work);
+    }
+    bool quit = false;
+    std::string line;
+    while( not quit and std::getline(file, line) )
+    {
+        Query query;
+        query.command_ = parse_command(line, query.params_, query.output_);
+        if( query.command_ != nullptr and query.command_->id_ == "Q" )
+        {
+            quit = true;
+            query.command_ = nullptr;
+        }
+
+        // A SAVE writes a file and a BATCH may quit: they run alone, after
+        // the lines before them have been printed.
+        if( query.command_ != nullptr and ( query.command_->id_ == "S"
+                                            or query.command_->id_ == "B" ) )
+        {
+            print(0);
+            std::cout << PROMPT;
+            if( query.command_->id_ == "S" )
+            {
+                (database_.get()->*(query.command_->funcPtr_))(
+                            query.params_, std::cout);
+                continue;
+            }
+            ++batch_depth_;
+            quit = not exec_batch(query.params_.at(0));
+            --batch_depth_;
+            continue;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            queries.push_back(std::move(query));
+        }
+        added.notify_one();
+        // At most window lines are read ahead of the output.
+        print(window - 1);
+    }
+    print(0);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        closing = true;
+    }
+    added.notify_all();
+    for( auto& worker : workers )
+    {
+        worker.join();
+    }
+    std::cout << std::flush;
+    return not quit;
+}
+
+CommandInfo* Cli::parse_command(const std::string& line,
+                                std::vector<std::string>& params,
+                                std::ostream& output)
+{
+    // Parsing command to the actual command and its parameters
+    params = Utils::split(line, ' ');
+    if ( params.empty() or Utils::isEmpty(params.at(0)) )
+    {
+        return nullptr;
+    }
+    std::string command_str = params.front();
+    params.erase(params.begin());
 
 
     CommandInfo* command = findCommand(command_str);
@@ -41,27 +227,24 @@ bool Cli::exec_prompt()
     // Checking special commands
     if( command == nullptr )
     {
-        std::cout << UNKNOWN_COMMAND << std::endl;
-        return true;
+        output << UNKNOWN_COMMAND << std::endl;
+        return nullptr;
     }
     if( command->id_ == "Q" )
     {
-        return false;
+        return command;
     }
-    if( command->params_.size() != input.size() )
+    if( command->params_.size() != params.size() )
     {
-        std::cout << WRONG_PARAMETERS << std::endl;
-        return true;
+        output << WRONG_PARAMETERS << std::endl;
+        return nullptr;
     }
-    if( command->id_ == "N" and not Utils::isNumeric(input.at(1)))
+    if( command->id_ == "N" and not Utils::isNumeric(params.at(1)))
     {
-        std::cout << NOT_NUMERIC << std::endl;
-        return true;
+        output << NOT_NUMERIC << std::endl;
+        return nullptr;
     }
-
-    // Calling command method through the function pointer
-    (database_.get()->*(command->funcPtr_))(input, std::cout);
-    return true;
+    return command;
 }
 
 CommandInfo *Cli::findCommand(std::string& command_name)
@@ -30,7 +30,7 @@ using MemberFunc = void (Familytree::*)(const std::vector<std::string>& params,
 // Struct describing a command
 struct CommandInfo
 {
-    std::string id_; // needed only for quit and commands with numeric params
+    std::string id_; // needed only for quit, batch, save and numeric params
     std::vector<std::string> allNames_;
     std::vector<std::string> params_;
     MemberFunc funcPtr_;
@@ -40,6 +40,7 @@ struct CommandInfo
 const std::string WRONG_PARAMETERS = "Wrong amount of parameters.";
 const std::string NOT_NUMERIC = "Wrong type of parameters.";
 const std::string UNKNOWN_COMMAND = "Unknown command.";
+const std::string NESTED_BATCH = "Error. Too many nested batches.";
 
 
 class Cli
@@ -48,8 +49,9 @@ public:
     /**
      * @brief Cli
      * @param db (database) pointer to the Familytree
+     * @param threads for the queries of a batch (0 for one per core)
      */
-    Cli(std::shared_ptr<Familytree> db);
+    Cli(std::shared_ptr<Familytree> db, unsigned threads = 0);
 
     /**
      * @brief exec_prompt runs the interface
@@ -57,13 +59,36 @@ public:
      */
     bool exec_prompt();
 
+    /**
+     * @brief exec_batch runs the commands of a file, one per line
+     * @param filename
+     * @return false if the file had the exit command, else true
+     * The queries run side by side on the threads, each into its own
+     * buffer, and a buffer is printed as soon as the lines before it
+     * have been; the output is the same as if the lines had been typed
+     * to the prompt. The file is read at most BATCH_WINDOW lines per thread
+     * ahead of the output. A SAVE or a BATCH waits for the queries
+     * before it.
+     */
+    bool exec_batch(const std::string& filename);
+
 private:
     // Pointer to the Familytree object the functions are called to
     std::shared_ptr<Familytree> database_;
 
+    // Threads running the queries of a batch
+    unsigned threads_;
+
     // Prompt printed for every query
     const std::string PROMPT = "> ";
 
+    // A batch file running itself stops at this depth
+    const unsigned MAX_BATCH_DEPTH = 16;
+    unsigned batch_depth_ = 0;
+
+    // Lines read ahead of the output in a batch, per thread
+    const unsigned BATCH_WINDOW = 4;
+
     // Vector containing those commands the CLI can recognize
     std::vector<CommandInfo> commands_ = {
         {"Q",{"QUIT","EXIT","Q","LOPETA"}, {}, nullptr},
@@ -76,6 +101,11 @@ private:
         {"",{"SHORTEST","LYHYIN","LYHIN"}, {"person"}, &Familytree::printShortestInLineage},
         {"N",{"GRANDCHILDREN","LAPSENLAPSET","GC","LL"}, {"person", "N"},&Familytree::printGrandChildrenN},
         {"N",{"GRANDPARENTS","ISOVANHEMMAT","GP","IV"}, {"person", "N"},&Familytree::printGrandParentsN},
+        {"",{"RELATION","SUKULAISUUS"}, {"person", "person"}, &Familytree::printRelation},
+        {"",{"KINSHIP","SUKULAISUUSKERROIN"}, {"person", "person"}, &Familytree::printKinship},
+        {"",{"INBREEDING","SUKUSIITOS"}, {}, &Familytree::printInbreeding},
+        {"S",{"SAVE","TALLENNA"}, {"file"}, &Familytree::saveSnapshot},
+        {"B",{"BATCH","ERAAJO"}, {"file"}, nullptr},
         {"",{},{},nullptr}
     };
 
@@ -86,6 +116,18 @@ private:
      * if not found, returns a nullptr
      */
     CommandInfo* findCommand(std::string& command_name);
+
+    /**
+     * @brief parse_command
+     * @param line
+     * @param params gets the parameters of the command
+     * @param output for the error messages
+     * @return pointer to the command to run; a nullptr if the line is
+     * empty or has an error, which has been printed
+     */
+    CommandInfo* parse_command(const std::string& line,
+                               std::vector<std::string>& params,
+                               std::ostream& output);
 };
 
 #endif // CLI_HH
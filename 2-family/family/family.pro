@@ -1,15 +1,23 @@
 TEMPLATE = app
-CONFIG += console c++11
+CONFIG += console c++17 thread
 CONFIG -= app_bundle
 CONFIG -= qt
 
 SOURCES += main.cpp \
     familytree.cpp \
+    familygraph.cpp \
+    familyloader.cpp \
+    kinship.cpp \
+    snapshot.cpp \
     cli.cpp \
     utils.cpp
 
 HEADERS += \
     familytree.hh \
+    familygraph.hh \
+    familyloader.hh \
+    kinship.hh \
+    snapshot.hh \
     cli.hh \
     utils.hh
 
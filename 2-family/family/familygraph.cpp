@@ -0,0 +1,490 @@
+//Description:
+/* This file implements the functions for class FamilyGraph.
+ * The file contains all the implementations for the member functions
+ * and the comments on the functions' logic.
+ *
+ * File author
+ * Name: Ruowen Liu
+ * Student number: -
+ * UserID: -
+ * E-Mail: ruowen.liu@tuni.fi
+ * */
+
+#include "familygraph.hh"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <numeric>
+#include <thread>
+
+namespace
+{
+//the first capacity of the string table
+const std::size_t NAME_CHUNK = std::size_t(1) << 16;
+//a part smaller than this is not worth a thread of its own
+const std::size_t MIN_PART = std::size_t(1) << 16;
+
+/**
+ * @brief isConsistent
+ * @param data is the mapped snapshot, its sizes checked already
+ * @param header of the snapshot
+ * @return true iff every id and offset in the arrays is in its bounds
+ *         and the two name orders are inverse; the checksums only tell
+ *         that the file is the one written, not that the writer was right
+ */
+bool isConsistent(const char* data, const SnapshotHeader& header)
+{
+    std::size_t persons = static_cast<std::size_t>(header.persons_);
+    std::size_t children = static_cast<std::size_t>(header.children_);
+    auto section = [data, &header](int which){
+        return data + header.offsets_[which];
+    };
+    auto nameBegin = reinterpret_cast<const std::uint64_t*>(
+                section(NAME_BEGIN));
+    auto parents = reinterpret_cast<const ParentIds*>(section(PARENTS));
+    auto childBegin = reinterpret_cast<const std::uint32_t*>(
+                section(CHILD_BEGIN));
+    auto childIds = reinterpret_cast<const PersonId*>(section(CHILDREN));
+    auto byName = reinterpret_cast<const PersonId*>(section(BY_NAME));
+    auto rank = reinterpret_cast<const std::uint32_t*>(section(RANKS));
+    if(nameBegin[0] != 0 or nameBegin[persons] != header.nameBytes_
+            or childBegin[0] != 0 or childBegin[persons] != children){
+        return false;
+    }
+    for(std::size_t id = 0; id < persons; ++id){
+        if(nameBegin[id] > nameBegin[id + 1]
+                or childBegin[id] > childBegin[id + 1]){
+            return false;
+        }
+        for(PersonId parent:parents[id]){
+            if(parent != NO_PERSON and parent >= persons){
+                return false;
+            }
+        }
+        //byName is a permutation and rank its inverse
+        if(byName[id] >= persons or rank[byName[id]] != id){
+            return false;
+        }
+    }
+    return std::all_of(childIds, childIds + children,
+                       [persons](PersonId child){
+        return child < persons;
+    });
+}
+}
+
+void VisitMarks::start(std::size_t size)
+{
+    if(stamps_.size() < size){
+        stamps_.resize(size, round_);
+    }
+    //after 2^32 rounds the old stamps would look new
+    if(++round_ == 0){
+        std::fill(stamps_.begin(), stamps_.end(), 0);
+        round_ = 1;
+    }
+}
+
+FamilyGraph::FamilyGraph()
+{
+    nameBegin_.assign({0});
+    childBegin_.assign({0});
+}
+
+PersonId FamilyGraph::addPerson(std::string_view name, int height)
+{
+    if(find(name) != NO_PERSON){
+        return NO_PERSON;
+    }
+    PersonId id = static_cast<PersonId>(size());
+    storeName(name);
+    heights_.change([height](std::vector<std::int32_t>& heights){
+        heights.push_back(height);
+    });
+    parents_.change([](std::vector<ParentIds>& parents){
+        parents.push_back({NO_PERSON, NO_PERSON});
+    });
+    //the frozen part is found by binary search, the new ones by the index
+    index_.emplace(this->name(id), id);
+    frozen_ = false;
+    return id;
+}
+
+void FamilyGraph::addRelation(PersonId child, const ParentIds& parents)
+{
+    parents_.change([child, &parents](std::vector<ParentIds>& all){
+        all[child] = parents;
+    });
+    for(PersonId parent:parents){
+        if(parent != NO_PERSON){
+            childEdges_.push_back({parent, child});
+        }
+    }
+    frozen_ = false;
+}
+
+void FamilyGraph::freeze()
+{
+    if(frozen_){
+        return;
+    }
+    std::size_t count = size();
+    sortNames();
+    index_ = {};
+
+    /* children CSR by counting sort: the earlier children of a parent
+     * first, then the new edges in the order they were added */
+    std::vector<std::uint32_t> begin(count + 1, 0);
+    for(std::size_t parent = 0; parent + 1 < childBegin_.size(); ++parent){
+        begin[parent + 1] = childBegin_[parent + 1] - childBegin_[parent];
+    }
+    for(auto& edge:childEdges_){
+        ++begin[edge.first + 1];
+    }
+    std::partial_sum(begin.begin(), begin.end(), begin.begin());
+    std::vector<PersonId> children(begin.back());
+    std::vector<std::uint32_t> next(begin.begin(), begin.end() - 1);
+    for(std::size_t parent = 0; parent + 1 < childBegin_.size(); ++parent){
+        for(std::uint32_t i = childBegin_[parent];
+            i < childBegin_[parent + 1]; ++i){
+            children[next[parent]++] = children_[i];
+        }
+    }
+    for(auto& edge:childEdges_){
+        children[next[edge.first]++] = edge.second;
+    }
+    childBegin_.assign(std::move(begin));
+    children_.assign(std::move(children));
+    childEdges_ = {};
+    frozen_ = true;
+}
+
+void FamilyGraph::build(const std::vector<std::string_view>& names,
+                        std::vector<int>&& heights,
+                        std::vector<ParentIds>&& parents,
+                        const std::vector<std::pair<PersonId, PersonId>>& edges,
+                        unsigned threads)
+{
+    std::size_t count = names.size();
+    threads = std::max(1u, threads);
+    //runs part(i, begin, end) for the parts of [0, size) on the threads
+    auto inParallel = [threads](std::size_t size, auto part){
+        std::size_t used = std::max<std::size_t>(
+                    1, std::min<std::size_t>(threads, size / MIN_PART));
+        std::vector<std::thread> workers;
+        for(std::size_t i = 0; i < used; ++i){
+            std::size_t begin = size * i / used;
+            std::size_t end = size * (i + 1) / used;
+            if(i + 1 == used){
+                part(i, begin, end);
+            }
+            else{
+                workers.emplace_back(part, i, begin, end);
+            }
+        }
+        for(auto& thread:workers){
+            thread.join();
+        }
+        return used;
+    };
+
+    //the names to the string table, each part copied by its own thread
+    std::vector<std::uint64_t> offsets(count + 1, 0);
+    for(std::size_t id = 0; id < count; ++id){
+        offsets[id + 1] = offsets[id] + names[id].size();
+    }
+    std::vector<char> chars(offsets.back());
+    inParallel(count, [&](std::size_t, std::size_t begin, std::size_t end){
+        for(std::size_t id = begin; id < end; ++id){
+            std::memcpy(chars.data() + offsets[id], names[id].data(),
+                        names[id].size());
+        }
+    });
+    snapshot_.reset();
+    nameChars_.assign(std::move(chars));
+    nameBegin_.assign(std::move(offsets));
+    heights_.assign(std::move(heights));
+    parents_.assign(std::move(parents));
+
+    /* children CSR by a parallel counting sort: every part of the edges
+     * is counted on its own, then each part places its edges after the
+     * ones of the earlier parts */
+    std::size_t parts = std::max<std::size_t>(
+                1, std::min<std::size_t>(threads, edges.size() / MIN_PART));
+    std::vector<std::vector<std::uint32_t>> counts(
+                parts, std::vector<std::uint32_t>(count, 0));
+    inParallel(edges.size(), [&](std::size_t part, std::size_t begin,
+               std::size_t end){
+        for(std::size_t i = begin; i < end; ++i){
+            ++counts[part][edges[i].first];
+        }
+    });
+    std::vector<std::uint32_t> begin(count + 1, 0);
+    for(std::size_t parent = 0; parent < count; ++parent){
+        std::uint32_t next = begin[parent];
+        for(auto& partCounts:counts){
+            std::uint32_t partCount = partCounts[parent];
+            partCounts[parent] = next;
+            next += partCount;
+        }
+        begin[parent + 1] = next;
+    }
+    std::vector<PersonId> children(edges.size());
+    inParallel(edges.size(), [&](std::size_t part, std::size_t first,
+               std::size_t last){
+        std::vector<std::uint32_t>& next = counts[part];
+        for(std::size_t i = first; i < last; ++i){
+            children[next[edges[i].first]++] = edges[i].second;
+        }
+    });
+    childBegin_.assign(std::move(begin));
+    children_.assign(std::move(children));
+    childEdges_ = {};
+    index_ = {};
+    sortNames();
+    frozen_ = true;
+}
+
+PersonId FamilyGraph::find(std::string_view name) const
+{
+    auto added = index_.find(name);
+    if(added != index_.end()){
+        return added->second;
+    }
+    auto found = std::lower_bound(byName_.begin(), byName_.end(), name,
+                                  [this](PersonId id, std::string_view key){
+        return this->name(id) < key;
+    });
+    if(found == byName_.end() or this->name(*found) != name){
+        return NO_PERSON;
+    }
+    return *found;
+}
+
+IdRange FamilyGraph::children(PersonId id) const
+{
+    const PersonId* first = children_.data();
+    return {first + childBegin_[id], first + childBegin_[id + 1]};
+}
+
+void FamilyGraph::sortByName(std::vector<PersonId>& ids) const
+{
+    std::sort(ids.begin(), ids.end(), [this](PersonId a, PersonId b){
+        return rank_[a] < rank_[b];
+    });
+    ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+}
+
+bool FamilyGraph::save(const std::string& path, std::uint32_t flags)
+{
+    freeze();
+    //the sections in the order of SnapshotSection
+    struct Section
+    {
+        const void* data_;
+        std::size_t size_;
+    };
+    Section sections[SNAPSHOT_SECTIONS] = {
+        {nameBegin_.data(), nameBegin_.size() * sizeof(std::uint64_t)},
+        {heights_.data(), heights_.size() * sizeof(std::int32_t)},
+        {parents_.data(), parents_.size() * sizeof(ParentIds)},
+        {childBegin_.data(), childBegin_.size() * sizeof(std::uint32_t)},
+        {children_.data(), children_.size() * sizeof(PersonId)},
+        {byName_.data(), byName_.size() * sizeof(PersonId)},
+        {rank_.data(), rank_.size() * sizeof(std::uint32_t)},
+        {nameChars_.data(), nameChars_.size()}
+    };
+
+    SnapshotHeader header = {};
+    std::memcpy(header.magic_, SNAPSHOT_MAGIC, sizeof(header.magic_));
+    header.version_ = SNAPSHOT_VERSION;
+    header.byteOrder_ = SNAPSHOT_BYTE_ORDER;
+    header.persons_ = size();
+    header.children_ = children_.size();
+    header.nameBytes_ = nameChars_.size();
+    header.flags_ = flags;
+    //the sections after the header, each one aligned
+    std::vector<char> payload;
+    for(int section = 0; section < SNAPSHOT_SECTIONS; ++section){
+        std::size_t offset = SNAPSHOT_HEADER_SIZE + payload.size();
+        std::size_t padding = (SNAPSHOT_ALIGNMENT
+                               - offset % SNAPSHOT_ALIGNMENT)
+                % SNAPSHOT_ALIGNMENT;
+        payload.resize(payload.size() + padding, 0);
+        header.offsets_[section] = SNAPSHOT_HEADER_SIZE + payload.size();
+        header.sizes_[section] = sections[section].size_;
+        const char* data = static_cast<const char*>(sections[section].data_);
+        payload.insert(payload.end(), data, data + sections[section].size_);
+    }
+    header.payloadChecksum_ = snapshotChecksum(payload.data(),
+                                               payload.size());
+    header.headerChecksum_ = snapshotChecksum(
+                reinterpret_cast<const char*>(&header),
+                offsetof(SnapshotHeader, headerChecksum_));
+
+    //a new file renamed over the old one: the mappings of the old one stay
+    std::string written = path + ".tmp";
+    {
+        std::ofstream file(written, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(payload.data(),
+                   static_cast<std::streamsize>(payload.size()));
+        if(!file){
+            file.close();
+            std::remove(written.c_str());
+            return false;
+        }
+    }
+    if(std::rename(written.c_str(), path.c_str()) != 0){
+        //where rename does not replace a file
+        std::remove(path.c_str());
+        if(std::rename(written.c_str(), path.c_str()) != 0){
+            std::remove(written.c_str());
+            return false;
+        }
+    }
+    return true;
+}
+
+bool FamilyGraph::load(const std::string& path, std::uint32_t& flags,
+                       std::string& error)
+{
+    auto file = std::make_unique<MappedFile>();
+    if(!file->open(path)){
+        error = "could not open the file";
+        return false;
+    }
+    SnapshotHeader header;
+    if(file->size() < SNAPSHOT_HEADER_SIZE){
+        error = "not a snapshot file";
+        return false;
+    }
+    std::memcpy(&header, file->data(), sizeof(header));
+    if(std::memcmp(header.magic_, SNAPSHOT_MAGIC, sizeof(header.magic_))
+            != 0){
+        error = "not a snapshot file";
+        return false;
+    }
+    if(header.byteOrder_ != SNAPSHOT_BYTE_ORDER){
+        error = "written in another byte order";
+        return false;
+    }
+    if(header.version_ != SNAPSHOT_VERSION){
+        error = "version " + std::to_string(header.version_)
+                + ", expected " + std::to_string(SNAPSHOT_VERSION);
+        return false;
+    }
+    if(header.headerChecksum_ != snapshotChecksum(
+                file->data(), offsetof(SnapshotHeader, headerChecksum_))){
+        error = "checksum mismatch";
+        return false;
+    }
+
+    //the sizes must be the ones of the counts, the sections in the file
+    std::uint64_t persons = header.persons_;
+    std::uint64_t expected[SNAPSHOT_SECTIONS] = {
+        (persons + 1) * sizeof(std::uint64_t),
+        persons * sizeof(std::int32_t),
+        persons * sizeof(ParentIds),
+        (persons + 1) * sizeof(std::uint32_t),
+        header.children_ * sizeof(PersonId),
+        persons * sizeof(PersonId),
+        persons * sizeof(std::uint32_t),
+        header.nameBytes_
+    };
+    bool isValid = persons < NO_PERSON and header.children_ < UINT32_MAX;
+    std::uint64_t end = SNAPSHOT_HEADER_SIZE;
+    for(int section = 0; section < SNAPSHOT_SECTIONS and isValid; ++section){
+        std::uint64_t offset = header.offsets_[section];
+        isValid = header.sizes_[section] == expected[section]
+                and offset % SNAPSHOT_ALIGNMENT == 0 and offset >= end
+                and offset <= file->size()
+                and header.sizes_[section] <= file->size() - offset;
+        end = offset + header.sizes_[section];
+    }
+    if(!isValid or end != file->size()){
+        error = "wrong size";
+        return false;
+    }
+    if(header.payloadChecksum_ != snapshotChecksum(
+                file->data() + SNAPSHOT_HEADER_SIZE,
+                file->size() - SNAPSHOT_HEADER_SIZE)){
+        error = "checksum mismatch";
+        return false;
+    }
+    if(!isConsistent(file->data(), header)){
+        error = "inconsistent contents";
+        return false;
+    }
+
+    //the columns read the mapped file from now on
+    auto section = [&file, &header](int which){
+        return file->data() + header.offsets_[which];
+    };
+    std::size_t count = static_cast<std::size_t>(persons);
+    nameBegin_.map(reinterpret_cast<const std::uint64_t*>(
+                       section(NAME_BEGIN)), count + 1);
+    heights_.map(reinterpret_cast<const std::int32_t*>(section(HEIGHTS)),
+                 count);
+    parents_.map(reinterpret_cast<const ParentIds*>(section(PARENTS)),
+                 count);
+    childBegin_.map(reinterpret_cast<const std::uint32_t*>(
+                        section(CHILD_BEGIN)), count + 1);
+    children_.map(reinterpret_cast<const PersonId*>(section(CHILDREN)),
+                  static_cast<std::size_t>(header.children_));
+    byName_.map(reinterpret_cast<const PersonId*>(section(BY_NAME)), count);
+    rank_.map(reinterpret_cast<const std::uint32_t*>(section(RANKS)), count);
+    nameChars_.map(section(NAME_CHARS),
+                   static_cast<std::size_t>(header.nameBytes_));
+    snapshot_ = std::move(file);
+    childEdges_ = {};
+    index_ = {};
+    frozen_ = true;
+    flags = header.flags_;
+    return true;
+}
+
+void FamilyGraph::sortNames()
+{
+    //the ids in the alphabetical order, and the rank of every id
+    std::size_t count = size();
+    std::vector<PersonId> byName(count);
+    std::iota(byName.begin(), byName.end(), PersonId(0));
+    std::sort(byName.begin(), byName.end(), [this](PersonId a, PersonId b){
+        return name(a) < name(b);
+    });
+    std::vector<std::uint32_t> rank(count);
+    for(std::size_t i = 0; i < count; ++i){
+        rank[byName[i]] = static_cast<std::uint32_t>(i);
+    }
+    byName_.assign(std::move(byName));
+    rank_.assign(std::move(rank));
+}
+
+void FamilyGraph::storeName(std::string_view name)
+{
+    const char* before = nameChars_.data();
+    nameChars_.change([name](std::vector<char>& chars){
+        //grow by doubling, not by every name
+        if(chars.size() + name.size() > chars.capacity()){
+            chars.reserve(std::max({2 * chars.capacity(), NAME_CHUNK,
+                                    chars.size() + name.size()}));
+        }
+        chars.insert(chars.end(), name.begin(), name.end());
+    });
+    std::uint64_t end = nameChars_.size();
+    nameBegin_.change([end](std::vector<std::uint64_t>& begins){
+        begins.push_back(end);
+    });
+    //the characters have moved: the index must view the new ones
+    if(nameChars_.data() != before and !index_.empty()){
+        std::unordered_map<std::string_view, PersonId> index;
+        index.reserve(index_.size());
+        for(auto& entry:index_){
+            index.emplace(this->name(entry.second), entry.second);
+        }
+        index_ = std::move(index);
+    }
+}
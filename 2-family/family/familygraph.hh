@@ -0,0 +1,298 @@
+//Description:
+/* This file defines the class FamilyGraph, the storage of the persons
+ * and their relations used by the class Familytree.
+ *   Every person gets a dense integer id (PersonId) in the order the
+ * persons are added, and all the data of the persons is kept in arrays
+ * indexed by the id:
+ *   names    - offsets into one string table of the characters of all
+ *              the names
+ *   heights  - the heights
+ *   parents  - two slots per person (father, mother), NO_PERSON if unknown
+ *   children - compressed sparse row (CSR): the children of person i are
+ *              children_[childBegin_[i] ... childBegin_[i + 1])
+ * and the ids sorted by name, for finding a name by binary search and for
+ * printing in the alphabetical order (rank = place in that order).
+ *   While persons and relations are being added, the children are only
+ * collected as (parent, child) edges, and names are found with a hash
+ * index. freeze() builds the CSR and the sorted ids and drops the hash
+ * index; the queries need a frozen graph. Adding more after that is
+ * possible, the graph is frozen again when needed.
+ *   A frozen graph can be saved as a snapshot file (see snapshot.hh) and
+ * loaded back by mapping the file: then the arrays are read right from
+ * the mapped pages. Adding to a loaded graph copies the arrays first.
+ *
+ * File author
+ * Name: Ruowen Liu
+ * Student number: -
+ * UserID: -
+ * E-Mail: ruowen.liu@tuni.fi
+ * */
+
+#ifndef FAMILYGRAPH_HH
+#define FAMILYGRAPH_HH
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "snapshot.hh"
+
+using PersonId = std::uint32_t;
+const PersonId NO_PERSON = UINT32_MAX;
+
+//father and mother, in the order of the datafile
+using ParentIds = std::array<PersonId, 2>;
+
+/**
+ * @brief The IdRange struct - consecutive ids, e.g. the children of
+ *        a person
+ */
+struct IdRange
+{
+    const PersonId* first_ = nullptr;
+    const PersonId* last_ = nullptr;
+
+    const PersonId* begin() const { return first_; }
+    const PersonId* end() const { return last_; }
+    std::size_t size() const
+    {
+        return static_cast<std::size_t>(last_ - first_);
+    }
+    bool empty() const { return first_ == last_; }
+};
+
+/**
+ * @brief The VisitMarks class - marks for the persons reached in
+ *        a traversal. start() forgets the earlier marks without touching
+ *        them, thus a traversal costs only the persons it reaches.
+ */
+class VisitMarks
+{
+public:
+    /**
+     * @brief start
+     * @param size is the number of persons
+     * Start a new round of marks.
+     */
+    void start(std::size_t size);
+
+    /**
+     * @brief mark
+     * @param id
+     * @return true if the person was not marked in this round before
+     */
+    bool mark(PersonId id)
+    {
+        if(stamps_[id] == round_){
+            return false;
+        }
+        stamps_[id] = round_;
+        return true;
+    }
+
+    //true if the person is marked in this round
+    bool isMarked(PersonId id) const { return stamps_[id] == round_; }
+
+private:
+    std::vector<std::uint32_t> stamps_;
+    std::uint32_t round_ = 0;
+};
+
+/**
+ * @brief The Column class - one array of the graph: either its own vector,
+ *        or a part of the snapshot file the graph was loaded from
+ */
+template <typename T>
+class Column
+{
+public:
+    Column() = default;
+    Column(Column&&) = default;
+    Column& operator=(Column&&) = default;
+    Column(const Column&) = delete;
+    Column& operator=(const Column&) = delete;
+
+    const T& operator[](std::size_t i) const { return data_[i]; }
+    const T* data() const { return data_; }
+    std::size_t size() const { return size_; }
+    const T* begin() const { return data_; }
+    const T* end() const { return data_ + size_; }
+
+    /**
+     * @brief change
+     * @param edit gets the own vector to change; a mapped column is
+     *        copied to it first
+     */
+    template <typename Edit>
+    void change(Edit edit)
+    {
+        if(data_ != own_.data() or size_ != own_.size()){
+            own_.assign(data_, data_ + size_);
+        }
+        edit(own_);
+        data_ = own_.data();
+        size_ = own_.size();
+    }
+
+    //own the values (moved, no copy)
+    void assign(std::vector<T>&& values)
+    {
+        own_ = std::move(values);
+        data_ = own_.data();
+        size_ = own_.size();
+    }
+
+    //read the values from a mapped snapshot
+    void map(const T* data, std::size_t size)
+    {
+        own_ = {};
+        data_ = data;
+        size_ = size;
+    }
+
+private:
+    std::vector<T> own_;
+    const T* data_ = nullptr;
+    std::size_t size_ = 0;
+};
+
+class FamilyGraph
+{
+public:
+    FamilyGraph();
+
+    //======== building ========
+    /**
+     * @brief addPerson
+     * @param name
+     * @param height
+     * @return the id of the new person, or NO_PERSON if the name
+     *         has already been added
+     */
+    PersonId addPerson(std::string_view name, int height);
+
+    /**
+     * @brief addRelation
+     * @param child
+     * @param parents (NO_PERSON for an unknown one)
+     * Set the parents of the child, and add the child to the children of
+     * each known parent. Like a relation given twice in the datafile, a
+     * later call replaces the parents, but the child stays a child of the
+     * earlier parents too.
+     */
+    void addRelation(PersonId child, const ParentIds& parents);
+
+    /**
+     * @brief freeze
+     * Build the children CSR and the ids sorted by name. Nothing is done
+     * if nothing has been added since the last freeze.
+     */
+    void freeze();
+    bool isFrozen() const { return frozen_; }
+
+    /**
+     * @brief build
+     * @param names of the persons, by the ids (copied into the graph)
+     * @param heights by the ids
+     * @param parents by the ids
+     * @param edges are the (parent, child) edges in the order of the
+     *        relations, as addRelation would have added them
+     * @param threads is the number of threads to use
+     * Replace the whole graph with the given persons, frozen. The names
+     * are copied and the children CSR is built by a counting sort that
+     * the threads share: each one counts and places the edges of its own
+     * part, thus the children stay in the order of the edges.
+     */
+    void build(const std::vector<std::string_view>& names,
+               std::vector<int>&& heights, std::vector<ParentIds>&& parents,
+               const std::vector<std::pair<PersonId, PersonId>>& edges,
+               unsigned threads);
+
+    //======== snapshot ========
+    /**
+     * @brief save
+     * @param path
+     * @param flags are kept in the file for the user of the graph
+     * @return true if the file was written
+     * Save the graph (frozen first) as a snapshot file. The file is
+     * written beside the path and then renamed over it, thus a process
+     * that has mapped the earlier file keeps reading the earlier file.
+     */
+    bool save(const std::string& path, std::uint32_t flags);
+
+    /**
+     * @brief load
+     * @param path
+     * @param flags get the flags saved in the file
+     * @param error gets the reason, if the file is rejected
+     * @return true if the file is a valid snapshot; then the graph is the
+     *         one saved, read from the mapped file
+     */
+    bool load(const std::string& path, std::uint32_t& flags,
+              std::string& error);
+
+    //======== queries ========
+    /**
+     * @brief find
+     * @param name
+     * @return the id of the person, NO_PERSON if not found
+     */
+    PersonId find(std::string_view name) const;
+
+    std::size_t size() const { return heights_.size(); }
+    std::string_view name(PersonId id) const
+    {
+        return std::string_view(nameChars_.data() + nameBegin_[id],
+                                nameBegin_[id + 1] - nameBegin_[id]);
+    }
+    int height(PersonId id) const { return heights_[id]; }
+    const ParentIds& parents(PersonId id) const { return parents_[id]; }
+    //the children of the person (frozen graph only)
+    IdRange children(PersonId id) const;
+    //the ids in the alphabetical order of the names (frozen graph only)
+    const Column<PersonId>& byName() const { return byName_; }
+    //the place of the person in byName() (frozen graph only)
+    std::uint32_t rank(PersonId id) const { return rank_[id]; }
+
+    /**
+     * @brief sortByName
+     * @param ids
+     * Sort the ids in the alphabetical order of the names and remove the
+     * duplicates (frozen graph only).
+     */
+    void sortByName(std::vector<PersonId>& ids) const;
+
+private:
+    //the characters of all the names, and where each one begins
+    Column<char> nameChars_;
+    Column<std::uint64_t> nameBegin_;
+    Column<std::int32_t> heights_;
+    Column<ParentIds> parents_;
+
+    //building: the (parent, child) edges in the order they were added,
+    //and the names added since the last freeze (views into nameChars_)
+    std::vector<std::pair<PersonId, PersonId>> childEdges_;
+    std::unordered_map<std::string_view, PersonId> index_;
+
+    //frozen: children CSR, and the ids by name
+    bool frozen_ = true;
+    Column<std::uint32_t> childBegin_;
+    Column<PersonId> children_;
+    Column<PersonId> byName_;
+    Column<std::uint32_t> rank_;
+
+    //the snapshot file the columns are read from, if loaded
+    std::unique_ptr<MappedFile> snapshot_;
+
+    void storeName(std::string_view name);
+    //the ids sorted by name and the ranks
+    void sortNames();
+};
+
+#endif // FAMILYGRAPH_HH
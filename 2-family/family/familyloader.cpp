@@ -0,0 +1,426 @@
+//Description:
+/* This file implements the functions for class FamilyLoader.
+ * The file contains all the implementations for the member functions
+ * and the comments on the functions' logic.
+ *
+ * File author
+ * Name: Ruowen Liu
+ * Student number: -
+ * UserID: -
+ * E-Mail: ruowen.liu@tuni.fi
+ * */
+
+#include "familyloader.hh"
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <functional>
+#include <thread>
+
+namespace
+{
+const char CSV_DELIMITER = ';';
+enum CsvFields { CSV_NAME, CSV_HEIGHT, CSV_FATHER, CSV_MOTHER, CSV_VALUES };
+//less data than this is not worth more threads
+const std::size_t MIN_PARALLEL_DATA = std::size_t(1) << 20;
+const std::size_t MIN_PARALLEL_ROWS = std::size_t(1) << 14;
+
+//the height like Utils::isNumeric and std::stoi read it; false if bad
+bool readHeight(std::string_view field, int& height)
+{
+    if(field.empty()){
+        return false;
+    }
+    for(char c:field){
+        if(c < '0' or c > '9'){
+            return false;
+        }
+    }
+    auto result = std::from_chars(field.data(), field.data() + field.size(),
+                                  height);
+    return result.ec == std::errc();
+}
+
+//the end of the line starting at begin: its '\n', or end if none
+char* lineEnd(char* begin, char* end)
+{
+    void* found = std::memchr(begin, '\n', static_cast<std::size_t>(
+                                  end - begin));
+    return found != nullptr ? static_cast<char*>(found) : end;
+}
+
+/* split like Utils::split: the quotes are dropped, and a delimiter between
+ * them is part of the field; the line is compacted over the quotes, thus
+ * the fields are views into the line; returns the number of the fields */
+std::size_t splitQuoted(char* line, char* end, std::string_view* fields)
+{
+    char* write = line;
+    char* fieldBegin = line;
+    std::size_t fieldCount = 0;
+    bool insideQuotation = false;
+    for(char* read = line; read < end; ++read){
+        if(*read == '"'){
+            insideQuotation = !insideQuotation;
+        }
+        else if(*read != CSV_DELIMITER or insideQuotation){
+            *write++ = *read;
+        }
+        else{
+            if(fieldCount < CSV_VALUES){
+                fields[fieldCount] = std::string_view(
+                            fieldBegin, static_cast<std::size_t>(
+                                write - fieldBegin));
+            }
+            ++fieldCount;
+            fieldBegin = write;
+        }
+    }
+    if(fieldCount < CSV_VALUES){
+        fields[fieldCount] = std::string_view(
+                    fieldBegin, static_cast<std::size_t>(write - fieldBegin));
+    }
+    return fieldCount + 1;
+}
+
+//the same without quotes: the fields are found by memchr
+std::size_t split(char* line, char* end, std::string_view* fields)
+{
+    std::size_t fieldCount = 0;
+    for(;;){
+        void* found = std::memchr(line, CSV_DELIMITER,
+                                  static_cast<std::size_t>(end - line));
+        char* fieldEnd = found != nullptr ? static_cast<char*>(found) : end;
+        if(fieldCount < CSV_VALUES){
+            fields[fieldCount] = std::string_view(
+                        line, static_cast<std::size_t>(fieldEnd - line));
+        }
+        ++fieldCount;
+        if(found == nullptr){
+            return fieldCount;
+        }
+        line = fieldEnd + 1;
+    }
+}
+}
+
+template <typename Work>
+void FamilyLoader::inParallel(std::size_t count, Work work) const
+{
+    //always threads_ parts, some of them empty, the last one on this thread
+    std::size_t used = count < MIN_PARALLEL_ROWS ? 1 : threads_;
+    std::vector<std::thread> workers;
+    for(std::size_t part = 0; part < threads_; ++part){
+        std::size_t first = part < used ? count * part / used : count;
+        std::size_t last = part < used ? count * (part + 1) / used : count;
+        if(part + 1 == threads_){
+            work(part, first, last);
+        }
+        else if(first < last){
+            workers.emplace_back(work, part, first, last);
+        }
+    }
+    for(auto& thread:workers){
+        thread.join();
+    }
+}
+
+FamilyLoader::FamilyLoader(unsigned threads):
+    threads_(threads != 0 ? threads
+                          : std::max(1u, std::thread::hardware_concurrency()))
+{
+}
+
+bool FamilyLoader::load(char* data, std::size_t size, Familytree& tree,
+                        std::ostream& output)
+{
+    //======== parse: the parts cut at the line ends ========
+    std::size_t partCount = size < MIN_PARALLEL_DATA ? 1 : threads_;
+    char* dataEnd = data + size;
+    parts_.clear();
+    parts_.resize(partCount);
+    char* begin = data;
+    for(std::size_t i = 0; i < partCount; ++i){
+        char* end = std::max(begin, data + size * (i + 1) / partCount);
+        //the part ends after a line end, except the last one
+        if(i + 1 < partCount and end < dataEnd){
+            end = std::min(lineEnd(end, dataEnd) + 1, dataEnd);
+        }
+        else{
+            end = dataEnd;
+        }
+        parts_.at(i).begin_ = begin;
+        parts_.at(i).end_ = end;
+        begin = end;
+    }
+    std::vector<std::thread> workers;
+    for(std::size_t i = 1; i < partCount; ++i){
+        workers.emplace_back([this, i](){ parse(parts_.at(i)); });
+    }
+    parse(parts_.at(0));
+    for(auto& thread:workers){
+        thread.join();
+    }
+
+    //the rows up to the first bad line, which ends the datafile
+    std::uint32_t lineOffset = 0;
+    std::uint32_t badLine = 0;
+    bool badHeight = false;
+    rows_.clear();
+    for(Part& part:parts_){
+        for(const Row& row:part.rows_){
+            rows_.push_back(&row);
+        }
+        if(part.badLine_ != 0){
+            badLine = lineOffset + part.badLine_;
+            badHeight = part.badHeight_;
+            break;
+        }
+        lineOffset += part.lines_;
+    }
+
+    //======== resolve: the ids of the names ========
+    std::size_t persons = resolve(rows_.size());
+    //like addNewPerson, the names added before
+    for(std::size_t row = 0; row < rows_.size(); ++row){
+        if(!isFirst_.at(row)){
+            output << ALREADY_ADDED << std::endl;
+        }
+    }
+    if(badLine != 0){
+        if(badHeight){
+            output << "Invalid argument." << std::endl;
+        }
+        output << "Error in datafile, line " << badLine << std::endl;
+        return false;
+    }
+
+    //======== build: the persons and the relations ========
+    std::vector<std::string_view> names(persons);
+    std::vector<int> heights(persons);
+    std::vector<ParentIds> parents(persons);
+    std::vector<std::size_t> edgeBegin(rows_.size() + 1, 0);
+    inParallel(rows_.size(), [&](std::size_t, std::size_t first,
+               std::size_t last){
+        for(std::size_t row = first; row < last; ++row){
+            PersonId id = ids_.at(row);
+            const ParentIds& rowParents = rowParents_.at(row);
+            if(isFirst_.at(row)){
+                names.at(id) = rows_.at(row)->name_;
+                heights.at(id) = rows_.at(row)->height_;
+                parents.at(id) = rowParents;
+            }
+            edgeBegin.at(row + 1) = (rowParents.at(0) != NO_PERSON)
+                    + (rowParents.at(1) != NO_PERSON);
+        }
+    });
+    /* a relation given again for a child replaces the parents, like
+     * addRelation does, in the order of the lines */
+    bool relationReplaced = false;
+    for(std::size_t row = 0; row < rows_.size(); ++row){
+        if(isFirst_.at(row)){
+            continue;
+        }
+        ParentIds& earlier = parents.at(ids_.at(row));
+        if(earlier.at(0) != NO_PERSON or earlier.at(1) != NO_PERSON){
+            relationReplaced = true;
+        }
+        earlier = rowParents_.at(row);
+    }
+    //the (parent, child) edges in the order of the lines
+    for(std::size_t row = 0; row < rows_.size(); ++row){
+        edgeBegin.at(row + 1) += edgeBegin.at(row);
+    }
+    std::vector<std::pair<PersonId, PersonId>> edges(edgeBegin.back());
+    inParallel(rows_.size(), [&](std::size_t, std::size_t first,
+               std::size_t last){
+        for(std::size_t row = first; row < last; ++row){
+            std::size_t next = edgeBegin.at(row);
+            for(PersonId parent:rowParents_.at(row)){
+                if(parent != NO_PERSON){
+                    edges.at(next++) = {parent, ids_.at(row)};
+                }
+            }
+        }
+    });
+
+    FamilyGraph graph;
+    graph.build(names, std::move(heights), std::move(parents), edges,
+                threads_);
+    tree.loadGraph(std::move(graph), relationReplaced);
+    return true;
+}
+
+void FamilyLoader::parse(Part& part)
+{
+    char* begin = part.begin_;
+    while(begin < part.end_){
+        char* end = lineEnd(begin, part.end_);
+        char* line = begin;
+        begin = end + 1;
+        //line numbering for error printing
+        ++part.lines_;
+
+        //skip empty and commented lines
+        if(line == end or *line == '#'){
+            continue;
+        }
+
+        //most lines have no quotes, and need not be copied over
+        std::string_view fields[CSV_VALUES];
+        bool hasQuotes = std::memchr(line, '"', static_cast<std::size_t>(
+                                         end - line)) != nullptr;
+        std::size_t fieldCount = hasQuotes ? splitQuoted(line, end, fields)
+                                           : split(line, end, fields);
+
+        //check that there was correct amount of fields in the line
+        Row row;
+        bool isGood = fieldCount == CSV_VALUES;
+        if(isGood){
+            row.name_ = fields[CSV_NAME];
+            row.father_ = fields[CSV_FATHER];
+            row.mother_ = fields[CSV_MOTHER];
+            row.line_ = part.lines_;
+            if(!readHeight(fields[CSV_HEIGHT], row.height_)){
+                part.badHeight_ = true;
+                isGood = false;
+            }
+            if(row.name_.empty()){
+                isGood = false;
+            }
+        }
+        if(!isGood){
+            part.badLine_ = part.lines_;
+            return;
+        }
+        part.rows_.push_back(row);
+    }
+}
+
+std::size_t FamilyLoader::resolve(std::size_t rows)
+{
+    std::hash<std::string_view> hash;
+    std::size_t partitions = rows < MIN_PARALLEL_ROWS ? 1 : threads_;
+    //the rows of each partition, by the parts of the rows
+    std::vector<std::vector<std::vector<std::uint32_t>>> buckets(
+                threads_, std::vector<std::vector<std::uint32_t>>(partitions));
+    nameHashes_.resize(rows);
+    inParallel(rows, [&](std::size_t part, std::size_t first,
+               std::size_t last){
+        for(std::size_t row = first; row < last; ++row){
+            nameHashes_[row] = hash(rows_[row]->name_);
+            buckets[part][nameHashes_[row] % partitions].push_back(
+                        static_cast<std::uint32_t>(row));
+        }
+    });
+
+    //the first row of every name; each partition is a thread of its own
+    std::vector<NameTable> firstRows;
+    for(std::size_t partition = 0; partition < partitions; ++partition){
+        std::size_t names = 0;
+        for(auto& partBuckets:buckets){
+            names += partBuckets[partition].size();
+        }
+        firstRows.emplace_back(rows_, names);
+    }
+    isFirst_.assign(rows, 0);
+    std::vector<std::thread> workers;
+    for(std::size_t partition = 0; partition < partitions; ++partition){
+        workers.emplace_back([&, partition](){
+            NameTable& names = firstRows[partition];
+            for(auto& partBuckets:buckets){
+                for(std::uint32_t row:partBuckets[partition]){
+                    isFirst_[row] = names.insert(row, nameHashes_[row]);
+                }
+            }
+        });
+    }
+    for(auto& thread:workers){
+        thread.join();
+    }
+
+    //the ids in the order of the first rows
+    std::vector<std::size_t> firstIds(threads_ + 1, 0);
+    inParallel(rows, [&](std::size_t part, std::size_t first,
+               std::size_t last){
+        firstIds[part + 1] = static_cast<std::size_t>(
+                    std::count(isFirst_.begin() + first,
+                               isFirst_.begin() + last, 1));
+    });
+    for(std::size_t part = 0; part < threads_; ++part){
+        firstIds[part + 1] += firstIds[part];
+    }
+    ids_.assign(rows, NO_PERSON);
+    inParallel(rows, [&](std::size_t part, std::size_t first,
+               std::size_t last){
+        PersonId next = static_cast<PersonId>(firstIds[part]);
+        for(std::size_t row = first; row < last; ++row){
+            if(isFirst_[row]){
+                ids_[row] = next++;
+            }
+        }
+    });
+
+    //the names of the others and of the parents, by the first rows
+    auto find = [&](std::string_view name, std::size_t nameHash){
+        std::uint32_t row = firstRows[nameHash % partitions].find(name,
+                                                                  nameHash);
+        return row == NameTable::NO_ROW ? NO_PERSON : ids_[row];
+    };
+    rowParents_.assign(rows, {NO_PERSON, NO_PERSON});
+    inParallel(rows, [&](std::size_t, std::size_t first, std::size_t last){
+        for(std::size_t row = first; row < last; ++row){
+            const Row& eachRow = *rows_[row];
+            if(!isFirst_[row]){
+                ids_[row] = find(eachRow.name_, nameHashes_[row]);
+            }
+            rowParents_[row] = {find(eachRow.father_, hash(eachRow.father_)),
+                                find(eachRow.mother_, hash(eachRow.mother_))};
+        }
+    });
+    return firstIds.back();
+}
+
+FamilyLoader::NameTable::NameTable(const std::vector<const Row*>& rows,
+                                   std::size_t names):
+    rows_(rows)
+{
+    //at most half full
+    std::size_t size = 16;
+    while(size < 2 * names){
+        size *= 2;
+    }
+    slots_.resize(size);
+    mask_ = size - 1;
+}
+
+bool FamilyLoader::NameTable::insert(std::uint32_t row, std::size_t hash)
+{
+    std::string_view name = rows_[row]->name_;
+    std::uint32_t tag = tagOf(hash);
+    for(std::size_t i = hash >> 8;; ++i){
+        Slot& slot = slots_[i & mask_];
+        if(slot.row_ == NO_ROW){
+            slot = {row, tag};
+            return true;
+        }
+        if(slot.tag_ == tag and rows_[slot.row_]->name_ == name){
+            return false;
+        }
+    }
+}
+
+std::uint32_t FamilyLoader::NameTable::find(std::string_view name,
+                                            std::size_t hash) const
+{
+    std::uint32_t tag = tagOf(hash);
+    for(std::size_t i = hash >> 8;; ++i){
+        const Slot& slot = slots_[i & mask_];
+        if(slot.row_ == NO_ROW){
+            return NO_ROW;
+        }
+        if(slot.tag_ == tag and rows_[slot.row_]->name_ == name){
+            return slot.row_;
+        }
+    }
+}
@@ -0,0 +1,172 @@
+//Description:
+/* This file defines the class FamilyLoader, which reads the whole datafile
+ * into a Familytree on several threads. The result is the same as adding
+ * every line with addNewPerson and then every relation with addRelation,
+ * as main.cpp did one line at a time, but the work is done in phases
+ * that the threads share:
+ *   1) parse   - the data is cut into parts at line ends, and every part
+ *                is split into rows of string_views into the data, with
+ *                no allocation per row: the lines are found by memchr,
+ *                and a line with quotes is unquoted in place;
+ *   2) resolve - the names are spread over partitions by their hashes;
+ *                each partition finds the first row of every name in it,
+ *                which gets the next id in the order of the rows, and
+ *                then the names of the parents are looked up the same way;
+ *   3) build   - FamilyGraph::build copies the names and builds the
+ *                children CSR by a parallel counting sort.
+ * The first bad line is reported like before, "Error in datafile, line N",
+ * after the messages of the names repeated on the lines before it.
+ *
+ * File author
+ * Name: Ruowen Liu
+ * Student number: -
+ * UserID: -
+ * E-Mail: ruowen.liu@tuni.fi
+ * */
+
+#ifndef FAMILYLOADER_HH
+#define FAMILYLOADER_HH
+
+#include "familytree.hh"
+
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+class FamilyLoader
+{
+public:
+    /**
+     * @brief FamilyLoader
+     * @param threads is the number of threads to use (0 for one per core)
+     */
+    explicit FamilyLoader(unsigned threads = 0);
+
+    /**
+     * @brief load
+     * @param data is the whole datafile, e.g. a privately mapped file; the
+     *        quotes are removed from it in place
+     * @param size of the data
+     * @param tree gets the persons and the relations of the datafile
+     * @param output is for the error messages
+     * @return true iff there were no errors in the datafile
+     */
+    bool load(char* data, std::size_t size, Familytree& tree,
+              std::ostream& output);
+
+private:
+    //one line of the datafile
+    struct Row
+    {
+        std::string_view name_;
+        std::string_view father_;
+        std::string_view mother_;
+        int height_ = NO_HEIGHT;
+        //the line number within the part
+        std::uint32_t line_ = 0;
+    };
+
+    //the rows of one part of the data
+    struct Part
+    {
+        char* begin_ = nullptr;
+        char* end_ = nullptr;
+        std::vector<Row> rows_;
+        std::uint32_t lines_ = 0;
+        //the first bad line of the part, 0 if none
+        std::uint32_t badLine_ = 0;
+        bool badHeight_ = false;
+    };
+
+    /**
+     * @brief The NameTable class - the first row of every name of one
+     *        partition, by open addressing on the hashes of the names
+     */
+    class NameTable
+    {
+    public:
+        static const std::uint32_t NO_ROW = UINT32_MAX;
+
+        /**
+         * @brief NameTable
+         * @param rows are all the rows
+         * @param names is the most names the table will get
+         */
+        NameTable(const std::vector<const Row*>& rows, std::size_t names);
+
+        /**
+         * @brief insert
+         * @param row
+         * @param hash is the hash of the row's name
+         * @return true if the name had no row before
+         */
+        bool insert(std::uint32_t row, std::size_t hash);
+
+        /**
+         * @brief find
+         * @param name
+         * @param hash of the name
+         * @return the first row of the name, NO_ROW if not found
+         */
+        std::uint32_t find(std::string_view name, std::size_t hash) const;
+
+    private:
+        //an empty slot has NO_ROW, the tag is a part of the hash
+        struct Slot
+        {
+            std::uint32_t row_ = NO_ROW;
+            std::uint32_t tag_ = 0;
+        };
+        const std::vector<const Row*>& rows_;
+        std::vector<Slot> slots_;
+        std::size_t mask_ = 0;
+        //the partitions use the hash modulo their count; the slots the rest
+        static std::uint32_t tagOf(std::size_t hash)
+        {
+            return static_cast<std::uint32_t>(std::uint64_t(hash) >> 32);
+        }
+    };
+
+    unsigned threads_;
+    std::vector<Part> parts_;
+    //the rows of all the parts, by the place in the datafile
+    std::vector<const Row*> rows_;
+    //the id of the name of every row
+    std::vector<PersonId> ids_;
+    //true for the first row of every name
+    std::vector<char> isFirst_;
+    //the hash of the name of every row
+    std::vector<std::size_t> nameHashes_;
+    //the ids of the parents of every row
+    std::vector<ParentIds> rowParents_;
+
+    /**
+     * @brief parse
+     * @param part
+     * Split the lines of the part into the rows, until the first bad line.
+     */
+    void parse(Part& part);
+
+    /**
+     * @brief resolve
+     * @param rows is the number of the rows to resolve
+     * @return the number of the persons
+     * Give the ids to the names of the rows, the first row of a name first.
+     */
+    std::size_t resolve(std::size_t rows);
+
+    /**
+     * @brief inParallel
+     * @param count is the number of the items
+     * @param work(part, begin, end) handles items [begin, end)
+     * Share the items with the threads, in consecutive parts.
+     */
+    template <typename Work>
+    void inParallel(std::size_t count, Work work) const;
+};
+
+#endif // FAMILYLOADER_HH
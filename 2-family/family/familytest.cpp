@@ -0,0 +1,602 @@
+//Description:
+/* This file is a test program of the ways the family tree is loaded. The
+ * datafiles are generated, with everything the format allows: repeated
+ * names, names in quotes (also with a ';' inside), unknown and missing
+ * parents, comments, empty lines and "\r" line ends. The reference is the
+ * datafile read one line at a time with addNewPerson and addRelation, as
+ * main.cpp did before FamilyLoader. Two loads are the same when their
+ * messages are the same and, if the datafile had no errors, the
+ * snapshots (see snapshot.hh) of their trees have the same bytes. The
+ * datafile is loaded from a string, and from a private mapping of the file
+ * (as main.cpp loads it), which must leave the file unchanged.
+ *   A snapshot is saved, loaded back and saved again: the bytes and the
+ * answers to the queries must stay the same. Damaged snapshots, also ones
+ * with right checksums but ids or offsets out of their bounds, must be
+ * rejected with the right message.
+ *   A BATCH file, with errors, a SAVE, a nested BATCH and a QUIT, run on
+ * several threads, must print the same as its lines typed to the prompt.
+ *   Usage: familytest
+ * Every check prints "PASS <name>" or "FAIL <name>: <what differed>";
+ * the exit status is EXIT_FAILURE if any check failed. The files are
+ * written to the temporary directory of the system.
+ *
+ * File author
+ * Name: Ruowen Liu
+ * Student number: -
+ * UserID: -
+ * E-Mail: ruowen.liu@tuni.fi
+ * */
+
+#include "cli.hh"
+#include "familytree.hh"
+#include "familyloader.hh"
+#include "snapshot.hh"
+#include "utils.hh"
+
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+//enough for FamilyLoader to parse, resolve and build on several threads
+const int BIG_PERSONS = 150000;
+//every this many persons one is queried
+const int QUERY_STEP = 7919;
+//many times the lines a batch reads ahead on the most threads
+const int BATCH_LINES = 400;
+//the lineage queries of a batch go through most of the persons
+const int BATCH_PERSONS = 20000;
+const std::vector<unsigned> THREAD_COUNTS = {1, 2, 3, 8};
+
+int failures = 0;
+
+std::filesystem::path directory()
+{
+    return std::filesystem::temp_directory_path() / "family-familytest";
+}
+
+void report(const std::string& name, bool passed,
+            const std::string& what = "")
+{
+    if(passed){
+        std::cout << "PASS " << name << std::endl;
+    }
+    else{
+        std::cout << "FAIL " << name << ": " << what << std::endl;
+        ++failures;
+    }
+}
+
+std::string readFile(const std::filesystem::path& path)
+{
+    std::ifstream file(path, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(file), {});
+}
+
+/**
+ * @brief makeDatafile
+ * @param seed
+ * @param persons is the number of person lines
+ * @param badLine is made bad, or the first person line after it (0 for none)
+ * @return the text of a datafile
+ */
+std::string makeDatafile(unsigned seed, int persons, int badLine = 0)
+{
+    std::mt19937 random(seed);
+    //about one name in 20 is given twice
+    std::uniform_int_distribution<int> pick(0, persons + persons / 20);
+    auto name = [](int person){
+        if(person % 97 == 3){
+            return "\"Q;" + std::to_string(person) + "\"";
+        }
+        if(person % 89 == 5){
+            return "\"R\"" + std::to_string(person);
+        }
+        return "P" + std::to_string(person);
+    };
+    std::string data = "";
+    int line = 0;
+    for(int person = 0; person < persons; ++person){
+        std::string father = random() % 8 == 0 ? "-" : name(pick(random));
+        std::string mother = random() % 9 == 0 ? "-" : name(pick(random));
+        std::string height = std::to_string(150 + random() % 50);
+        std::string text = name(pick(random)) + ";" + height + ";"
+                + father + ";" + mother;
+        if(++line >= badLine and badLine != 0){
+            //a height that is not a number, or a missing field
+            text = badLine % 2 == 0 ? name(person) + ";1x;-;-"
+                                    : name(person) + ";180;-";
+            badLine = 0;
+        }
+        if(random() % 50 == 0){
+            text += "\r";
+        }
+        data += text + "\n";
+        if(random() % 40 == 0){
+            data += random() % 2 == 0 ? "\n" : "# a comment;1;2;3\n";
+            ++line;
+        }
+    }
+    return data;
+}
+
+/**
+ * @brief loadSerially
+ * @param data
+ * @param tree
+ * @param output
+ * @return true iff there were no errors in the data
+ * The reference: the datafile read one line at a time like main.cpp did
+ * before FamilyLoader.
+ */
+bool loadSerially(const std::string& data, Familytree& tree,
+                  std::ostream& output)
+{
+    std::istringstream lines(data);
+    std::string line = "";
+    std::vector<std::vector<std::string>> relations;
+    int lineNumber = 0;
+    while(std::getline(lines, line)){
+        ++lineNumber;
+        if(line.empty() or line.at(0) == '#'){
+            continue;
+        }
+        std::vector<std::string> fields = Utils::split(line, ';');
+        int height = NO_HEIGHT;
+        if(fields.size() == 4){
+            if(Utils::isNumeric(fields.at(1))){
+                height = std::stoi(fields.at(1));
+            }
+            else{
+                output << "Invalid argument." << std::endl;
+            }
+            relations.push_back(fields);
+        }
+        if(fields.size() != 4 or fields.at(0).empty()
+                or height == NO_HEIGHT){
+            output << "Error in datafile, line " << lineNumber << std::endl;
+            return false;
+        }
+        tree.addNewPerson(fields.at(0), height, output);
+    }
+    for(auto& relation:relations){
+        tree.addRelation(relation.at(0), {relation.at(2), relation.at(3)},
+                         output);
+    }
+    return true;
+}
+
+//the messages of a load, and the snapshot of the tree loaded
+struct Loaded
+{
+    bool isValid_ = false;
+    std::string output_ = "";
+    std::string snapshot_ = "";
+};
+
+Loaded saved(Familytree& tree, bool isValid, const std::string& output,
+             const std::string& snapshotName)
+{
+    std::filesystem::path path = directory() / snapshotName;
+    std::ostringstream ignored;
+    tree.saveSnapshot({path.string()}, ignored);
+    return {isValid, output, readFile(path)};
+}
+
+//where a load differs from the reference, "" if it does not
+std::string difference(const Loaded& loaded, const Loaded& expected)
+{
+    if(loaded.isValid_ != expected.isValid_){
+        return loaded.isValid_ ? "loaded a bad datafile"
+                               : "did not load a good datafile";
+    }
+    if(loaded.output_ != expected.output_){
+        return "the messages differ";
+    }
+    //after an error the program stops, whatever was added
+    if(loaded.isValid_ and loaded.snapshot_ != expected.snapshot_){
+        return "the graphs differ";
+    }
+    return "";
+}
+
+Loaded loadSeriallySaved(const std::string& data)
+{
+    Familytree tree;
+    std::ostringstream output;
+    bool isValid = loadSerially(data, tree, output);
+    return saved(tree, isValid, output.str(), "serial.snap");
+}
+
+/**
+ * @brief testLoader
+ * @param name
+ * @param data
+ * FamilyLoader on every thread count against the line by line load.
+ */
+void testLoader(const std::string& name, const std::string& data,
+                bool isValid = true)
+{
+    Loaded expected = loadSeriallySaved(data);
+    if(expected.isValid_ != isValid){
+        report(name, false, "the datafile was not generated as meant");
+        return;
+    }
+    for(unsigned threads:THREAD_COUNTS){
+        std::string text = data;
+        Familytree tree;
+        std::ostringstream output;
+        FamilyLoader loader(threads);
+        bool isValid = loader.load(&text[0], text.size(), tree, output);
+        Loaded loaded = saved(tree, isValid, output.str(), "loader.snap");
+        std::string what = difference(loaded, expected);
+        report(name + ", " + std::to_string(threads) + " threads",
+               what.empty(), what);
+    }
+}
+
+/**
+ * @brief testMapped
+ * @param name
+ * @param data
+ * FamilyLoader on a private mapping of the datafile, as main.cpp loads
+ * it: the names are unquoted in the mapped pages, the file stays as it was.
+ */
+void testMapped(const std::string& name, const std::string& data)
+{
+    Loaded expected = loadSeriallySaved(data);
+    std::filesystem::path path = directory() / "datafile.txt";
+    for(unsigned threads:THREAD_COUNTS){
+        std::string testName = name + ", " + std::to_string(threads)
+                + " threads";
+        std::ofstream(path, std::ios::binary | std::ios::trunc) << data;
+        Familytree tree;
+        std::ostringstream output;
+        bool isValid = false;
+        {
+            MappedFile mapped;
+            if(!mapped.open(path.string(), MappedFile::PRIVATE)){
+                report(testName, false, "could not map the datafile");
+                continue;
+            }
+            FamilyLoader loader(threads);
+            isValid = loader.load(mapped.privateData(), mapped.size(), tree,
+                                  output);
+        }
+        Loaded loaded = saved(tree, isValid, output.str(), "mapped.snap");
+        std::string what = difference(loaded, expected);
+        if(what.empty() and readFile(path) != data){
+            what = "the datafile was changed";
+        }
+        report(testName, what.empty(), what);
+    }
+}
+
+/**
+ * @brief batchLines
+ * @param seed
+ * @param persons is the number of persons of the datafile
+ * @return commands for a batch file, also ones with errors
+ */
+std::vector<std::string> batchLines(unsigned seed, int persons)
+{
+    std::mt19937 random(seed);
+    const std::vector<std::string> commands = {
+        "CHILDREN", "PARENTS", "SIBLINGS", "COUSINS", "TALLEST", "SHORTEST",
+        "GRANDCHILDREN", "GRANDPARENTS", "RELATION", "KINSHIP"};
+    auto name = [&random, persons](){
+        return "P" + std::to_string(random() % (persons + persons / 20));
+    };
+    std::vector<std::string> lines;
+    for(int line = 0; line < BATCH_LINES; ++line){
+        std::string command = commands.at(random() % commands.size());
+        std::string text = command + " " + name();
+        if(command == "GRANDCHILDREN" or command == "GRANDPARENTS"){
+            text += " " + std::to_string(1 + random() % 3);
+        }
+        if(command == "RELATION" or command == "KINSHIP"){
+            text += " " + name();
+        }
+        switch(random() % 30){
+        case 0: text = ""; break;
+        case 1: text = "NOSUCHCOMMAND " + name(); break;
+        case 2: text = command; break;
+        case 3: text = "GC " + name() + " x"; break;
+        default: break;
+        }
+        lines.push_back(text);
+    }
+    return lines;
+}
+
+void writeLines(const std::filesystem::path& path,
+                const std::vector<std::string>& lines)
+{
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    for(const std::string& line:lines){
+        file << line << "\n";
+    }
+}
+
+/**
+ * @brief typed
+ * @param cli
+ * @param lines
+ * @param isQuit is set true if a line quit
+ * @return what the prompt printed for the lines typed one by one
+ */
+std::string typed(Cli& cli, const std::vector<std::string>& lines,
+                  bool& isQuit)
+{
+    std::string text = "";
+    for(const std::string& line:lines){
+        text += line + "\n";
+    }
+    std::istringstream input(text);
+    std::ostringstream output;
+    std::streambuf* oldInput = std::cin.rdbuf(input.rdbuf());
+    std::streambuf* oldOutput = std::cout.rdbuf(output.rdbuf());
+    isQuit = false;
+    for(std::size_t line = 0; line < lines.size() and !isQuit; ++line){
+        isQuit = !cli.exec_prompt();
+    }
+    std::cin.rdbuf(oldInput);
+    std::cout.rdbuf(oldOutput);
+    return output.str();
+}
+
+/**
+ * @brief batched
+ * @param cli
+ * @param path
+ * @param isQuit is set true if the batch quit
+ * @return what a BATCH of the file printed
+ */
+std::string batched(Cli& cli, const std::filesystem::path& path,
+                    bool& isQuit)
+{
+    std::ostringstream output;
+    std::streambuf* oldOutput = std::cout.rdbuf(output.rdbuf());
+    isQuit = !cli.exec_batch(path.string());
+    std::cout.rdbuf(oldOutput);
+    return output.str();
+}
+
+/**
+ * @brief testBatch
+ * @param data of a good datafile
+ * @param persons is the number of persons of the datafile
+ * BATCH on every thread count against the same lines typed to the prompt
+ * one by one: the output must be the same, in the same order. A nested
+ * BATCH is typed as the lines of its file after the prompt of its line.
+ */
+void testBatch(const std::string& data, int persons)
+{
+    auto tree = std::make_shared<Familytree>();
+    std::ostringstream ignored;
+    loadSerially(data, *tree, ignored);
+
+    std::filesystem::path outer = directory() / "outer.cmds";
+    std::filesystem::path inner = directory() / "inner.cmds";
+    std::filesystem::path quitting = directory() / "quitting.cmds";
+    std::vector<std::string> first = batchLines(1, persons);
+    std::vector<std::string> nested = batchLines(2, persons);
+    std::vector<std::string> rest = batchLines(3, persons);
+    std::string save = "SAVE " + (directory() / "batch.snap").string();
+    std::string missing = "BATCH " + (directory() / "missing.cmds").string();
+    rest.insert(rest.begin() + 10, save);
+    rest.insert(rest.begin() + 20, missing);
+    rest.insert(rest.begin() + 30, "INBREEDING");
+    std::vector<std::string> lines = first;
+    lines.push_back("BATCH " + inner.string());
+    lines.insert(lines.end(), rest.begin(), rest.end());
+    writeLines(outer, lines);
+    writeLines(inner, nested);
+    //the lines after the quit are not run
+    std::vector<std::string> quit = first;
+    quit.insert(quit.begin() + BATCH_LINES / 2, "QUIT");
+    writeLines(quitting, quit);
+
+    Cli prompt(tree, 1);
+    bool isQuit = false;
+    std::string expected = typed(prompt, first, isQuit) + "> "
+            + typed(prompt, nested, isQuit) + typed(prompt, rest, isQuit);
+    std::string expectedQuit = typed(prompt, quit, isQuit);
+    for(unsigned threads:THREAD_COUNTS){
+        std::string name = ", " + std::to_string(threads) + " threads";
+        Cli cli(tree, threads);
+        std::string output = batched(cli, outer, isQuit);
+        report("batch" + name, output == expected and !isQuit,
+               "the output differs from the lines typed");
+        output = batched(cli, quitting, isQuit);
+        report("batch, quit" + name, output == expectedQuit and isQuit,
+               "the output differs from the lines typed");
+    }
+}
+
+/**
+ * @brief queryOutputs
+ * @param tree
+ * @param persons is the number of persons of the datafile
+ * @return what the queries print on some persons of the tree
+ */
+std::string queryOutputs(const Familytree& tree, int persons)
+{
+    using Query = void (Familytree::*)(Params, std::ostream&) const;
+    const std::vector<Query> ofOne = {
+        &Familytree::printChildren, &Familytree::printParents,
+        &Familytree::printSiblings, &Familytree::printCousins,
+        &Familytree::printTallestInLineage,
+        &Familytree::printShortestInLineage};
+    const std::vector<Query> ofTwo = {
+        &Familytree::printRelation, &Familytree::printKinship};
+    std::ostringstream output;
+    std::string previous = "Nobody";
+    for(int person = 0; person < persons; person += QUERY_STEP){
+        std::string name = "P" + std::to_string(person);
+        for(Query query:ofOne){
+            (tree.*query)({name}, output);
+        }
+        tree.printGrandChildrenN({name, "2"}, output);
+        tree.printGrandParentsN({name, "3"}, output);
+        for(Query query:ofTwo){
+            (tree.*query)({name, previous}, output);
+        }
+        previous = name;
+    }
+    tree.printInbreeding({}, output);
+    return output.str();
+}
+
+//the snapshot bytes with their checksums computed again
+std::string resealed(std::string snapshot)
+{
+    SnapshotHeader header;
+    std::memcpy(&header, snapshot.data(), sizeof(header));
+    header.payloadChecksum_ = snapshotChecksum(
+                snapshot.data() + SNAPSHOT_HEADER_SIZE,
+                snapshot.size() - SNAPSHOT_HEADER_SIZE);
+    header.headerChecksum_ = snapshotChecksum(
+                reinterpret_cast<const char*>(&header),
+                offsetof(SnapshotHeader, headerChecksum_));
+    std::memcpy(&snapshot[0], &header, sizeof(header));
+    return snapshot;
+}
+
+//the value at index of a section of uint32 values (all but NAME_BEGIN)
+void setValue(std::string& snapshot, SnapshotSection section,
+              std::size_t index, std::uint32_t value)
+{
+    SnapshotHeader header;
+    std::memcpy(&header, snapshot.data(), sizeof(header));
+    std::memcpy(&snapshot[header.offsets_[section] + index * sizeof(value)],
+                &value, sizeof(value));
+}
+
+std::uint32_t value(const std::string& snapshot, SnapshotSection section,
+                    std::size_t index)
+{
+    SnapshotHeader header;
+    std::memcpy(&header, snapshot.data(), sizeof(header));
+    std::uint32_t value = 0;
+    std::memcpy(&value,
+                &snapshot[header.offsets_[section] + index * sizeof(value)],
+                sizeof(value));
+    return value;
+}
+
+/**
+ * @brief testRejected
+ * @param name
+ * @param contents of the file to load
+ * @param error is the reason expected in the message
+ * A damaged snapshot must not be loaded, and the tree must stay as it was.
+ */
+void testRejected(const std::string& name, const std::string& contents,
+                  const std::string& error)
+{
+    std::filesystem::path path = directory() / "damaged.snap";
+    std::ofstream(path, std::ios::binary) << contents;
+    Familytree tree;
+    std::ostringstream messages;
+    tree.addNewPerson("Kept", 170, messages);
+    std::ostringstream output;
+    bool isLoaded = tree.loadSnapshot(path.string(), output);
+    std::string expected = "Error in snapshot file: " + error + ".\n";
+    if(isLoaded){
+        report(name, false, "loaded");
+    }
+    else if(output.str() != expected){
+        report(name, false, "the message was " + output.str());
+    }
+    else{
+        std::ostringstream persons;
+        tree.printPersons({}, persons);
+        report(name, persons.str() == "Kept, 170\n",
+               "the tree was changed");
+    }
+}
+
+/**
+ * @brief testSnapshot
+ * @param data of a good datafile
+ * A tree saved, loaded back and saved again gives the same bytes and
+ * answers the queries the same; damaged files are rejected.
+ */
+void testSnapshot(const std::string& data, int persons)
+{
+    Familytree tree;
+    std::ostringstream ignored;
+    loadSerially(data, tree, ignored);
+    std::string snapshot = saved(tree, true, "", "saved.snap").snapshot_;
+
+    Familytree loaded;
+    std::ostringstream output;
+    std::string path = (directory() / "saved.snap").string();
+    if(!loaded.loadSnapshot(path, output)){
+        report("snapshot, loaded", false, output.str());
+        return;
+    }
+    report("snapshot, saved again",
+           saved(loaded, true, "", "again.snap").snapshot_ == snapshot,
+           "the bytes differ");
+    report("snapshot, queries",
+           queryOutputs(loaded, persons) == queryOutputs(tree, persons),
+           "the outputs differ");
+
+    testRejected("snapshot, a datafile", data, "not a snapshot file");
+    std::string damaged = snapshot;
+    damaged.at(damaged.size() / 2) ^= 0x10;
+    testRejected("snapshot, a byte changed", damaged, "checksum mismatch");
+    testRejected("snapshot, truncated",
+                 snapshot.substr(0, snapshot.size() - 1), "wrong size");
+
+    //right checksums, wrong contents, as a faulty writer would save them
+    damaged = snapshot;
+    setValue(damaged, PARENTS, 2 * (persons / 2) + 1, persons + 5);
+    testRejected("snapshot, a parent out of range", resealed(damaged),
+                 "inconsistent contents");
+    damaged = snapshot;
+    setValue(damaged, BY_NAME, 1, value(damaged, BY_NAME, 0));
+    testRejected("snapshot, names not a permutation", resealed(damaged),
+                 "inconsistent contents");
+    damaged = snapshot;
+    std::size_t child = persons / 3;
+    setValue(damaged, CHILD_BEGIN, child,
+             value(damaged, CHILD_BEGIN, child + 1) + 1);
+    testRejected("snapshot, children offsets decreasing", resealed(damaged),
+                 "inconsistent contents");
+}
+}
+
+int main()
+{
+    std::filesystem::remove_all(directory());
+    std::filesystem::create_directories(directory());
+
+    std::string big = makeDatafile(1, BIG_PERSONS);
+    testLoader("loader, small", makeDatafile(2, 40));
+    testLoader("loader, big", big);
+    testLoader("loader, bad line early", makeDatafile(3, BIG_PERSONS, 25),
+               false);
+    testLoader("loader, bad line late",
+               makeDatafile(4, BIG_PERSONS, BIG_PERSONS - 100), false);
+    testLoader("loader, no last line end", big.substr(0, big.size() - 1));
+    testMapped("mapped", big);
+    testMapped("mapped, bad line", makeDatafile(5, BIG_PERSONS, 1000));
+    testSnapshot(big, BIG_PERSONS);
+    testBatch(makeDatafile(6, BATCH_PERSONS), BATCH_PERSONS);
+
+    std::filesystem::remove_all(directory());
+    return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,22 @@
+TEMPLATE = app
+CONFIG += console c++17 thread
+CONFIG -= app_bundle
+CONFIG -= qt
+
+SOURCES += familytest.cpp \
+    cli.cpp \
+    familytree.cpp \
+    familygraph.cpp \
+    familyloader.cpp \
+    kinship.cpp \
+    snapshot.cpp \
+    utils.cpp
+
+HEADERS += \
+    cli.hh \
+    familytree.hh \
+    familygraph.hh \
+    familyloader.hh \
+    kinship.hh \
+    snapshot.hh \
+    utils.hh
@@ -12,8 +12,29 @@
 
 #include "familytree.hh"
 
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
 #include <iostream>
 #include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+/* the scratch of the traversals; every thread has its own, so that the
+ * queries of a BATCH can run side by side */
+struct Scratch
+{
+    //the persons already reached by the traversal being run
+    VisitMarks marks_;
+    //the ancestors RELATION has found from each of the two persons, and
+    //the generations up to them
+    VisitMarks relationMarks_[2];
+    std::vector<int> relationDistance_[2];
+};
+thread_local Scratch scratch;
+}
 
 Familytree::Familytree()
 {
@@ -22,19 +43,13 @@ Familytree::Familytree()
 void Familytree::addNewPerson(const std::string& id, int height,
                               std::ostream& output)
 {
-    /* if not the first time add
-     * the getPointer function will return a pointer
-     * which is not nullptr*/
-    if(getPointer(id)){
+    //if added before, the graph gives no new id
+    if(graph_.addPerson(id, height) == NO_PERSON){
         output << ALREADY_ADDED << std::endl;
         return;
     }
-    //if not added, make the ptr points to the Person type data
-    std::shared_ptr<Person> thisPerson
-            = std::make_shared<Person>(
-                Person{id, height, {nullptr, nullptr}, {}});
-
-    peopleMap_.insert({{id, thisPerson}});
+    ancestorDepth_.clear();
+    kinship_.reset();
     //testTEST(output, "addNewPerson");
 }
 
@@ -42,35 +57,77 @@ void Familytree::addRelation(const std::string& child,
                              const std::vector<std::string>& parents,
                              std::ostream& output)
 {
-    /* try to find parents' pointers with parents' id,
-     * if can't find, the parentA/parentB would be nullptr */
-    Person* parentA = getPointer(parents.at(0));
-    Person* parentB = getPointer(parents.at(1));
+    /* try to find parents' ids with parents' names,
+     * if can't find, the parentA/parentB would be NO_PERSON */
+    PersonId parentA = graph_.find(parents.at(0));
+    PersonId parentB = graph_.find(parents.at(1));
 
     //check if the person exists
-    Person* childToAdd = getPointer(child);
-    if(!childToAdd){
+    PersonId childToAdd = graph_.find(child);
+    if(childToAdd == NO_PERSON){
         printNotFound(child, output);
         return;
     }
-    //find the person and add the parents relation to the person
-    if(peopleMap_.find(child) != peopleMap_.end()){
-        childToAdd->parents_ = {parentA, parentB};
+    //a relation given again for the same child
+    const ParentIds& earlier = graph_.parents(childToAdd);
+    if(earlier.at(0) != NO_PERSON or earlier.at(1) != NO_PERSON){
+        relationReplaced_ = true;
     }
-    //find the parent for that person and add children relation
-    for(auto& parent:{parentA, parentB}){
-        if(parent){
-            getPointer(parent->id_)->children_.push_back(childToAdd);
-        }
+    /* set the parents of the person, and add the person to the children
+     * of the parents */
+    graph_.addRelation(childToAdd, {parentA, parentB});
+    //the parents have new descendants
+    for(PersonId parent:{parentA, parentB}){
+        invalidateLineage(parent);
     }
+    ancestorDepth_.clear();
+    kinship_.reset();
     //testTEST(output, "addRelation");
 }
 
+void Familytree::loadGraph(FamilyGraph&& graph, bool relationReplaced)
+{
+    graph_ = std::move(graph);
+    relationReplaced_ = relationReplaced;
+    //nothing is memoized of the new persons
+    lineage_.clear();
+    lineageState_.clear();
+    ancestorDepth_.clear();
+    kinship_.reset();
+}
+
+bool Familytree::loadSnapshot(const std::string& path, std::ostream& output)
+{
+    FamilyGraph graph;
+    std::uint32_t flags = 0;
+    std::string error = "";
+    if(!graph.load(path, flags, error)){
+        output << "Error in snapshot file: " << error << "." << std::endl;
+        return false;
+    }
+    loadGraph(std::move(graph), (flags & SNAPSHOT_RELATION_REPLACED) != 0);
+    return true;
+}
+
+void Familytree::saveSnapshot(Params params, std::ostream& output) const
+{
+    std::string path = params.at(0);
+    std::uint32_t flags = relationReplaced_ ? SNAPSHOT_RELATION_REPLACED : 0;
+    if(!graph_.save(path, flags)){
+        output << "Error. Could not write " << path << "." << std::endl;
+        return;
+    }
+    output << "Saved " << graph_.size() << " persons to " << path << "."
+           << std::endl;
+}
+
 void Familytree::printPersons(Params, std::ostream& output) const
 {
-    for(auto& person:peopleMap_){
-        //print:       (id),           (height in the Person struct)
-        output << person.first << ", " << person.second->height_ << std::endl;
+    const FamilyGraph& people = graph();
+    for(PersonId person:people.byName()){
+        //print:       (id),           (height)
+        output << people.name(person) << ", " << people.height(person)
+               << std::endl;
     }
 }
 
@@ -82,16 +139,16 @@ void Familytree::printChildren(Params params, std::ostream& output) const
     //get the person's name from user's input
     std::string thisPersonName = params.at(0);
     //search the person in the dataset by name
-    Person* thisPerson = getPointer(thisPersonName);
-    //if not found (getPointer return nullptr)
-    if(!thisPerson){
+    PersonId thisPerson = graph().find(thisPersonName);
+    //if not found
+    if(thisPerson == NO_PERSON){
         printNotFound(thisPersonName, output);
         return;
     }
     //else, creat the container to put the output name list
-    IdSet namelist = {};
+    PersonIdList namelist = {};
     //collect the children data
-    collectRelationsWithDepth(thisPersonName, namelist, "child");
+    collectRelationsWithDepth(thisPerson, namelist, Direction::CHILD);
     //print the name list
     printGroup(thisPersonName, groupName, namelist, output);
 }
@@ -104,16 +161,16 @@ void Familytree::printParents(Params params, std::ostream& output) const
     //get the person's name from user's input
     std::string thisPersonName = params.at(0);
     //search the person in the dataset by name
-    Person* thisPerson = getPointer(thisPersonName);
-    //if not found (getPointer return nullptr)
-    if(!thisPerson){
+    PersonId thisPerson = graph().find(thisPersonName);
+    //if not found
+    if(thisPerson == NO_PERSON){
         printNotFound(thisPersonName, output);
         return;
     }
     //else, creat the container to put the output name list
-    IdSet namelist = {};
+    PersonIdList namelist = {};
     //collect the parent data
-    collectRelationsWithDepth(thisPersonName, namelist, "parent");
+    collectRelationsWithDepth(thisPerson, namelist, Direction::PARENT);
     //print the name list
     printGroup(thisPersonName, groupName, namelist, output);
 }
@@ -126,28 +183,29 @@ void Familytree::printSiblings(Params params, std::ostream& output) const
     //get the person's name from user's input
     std::string thisPersonName = params.at(0);
     //search the person in the dataset by name
-    Person* thisPerson = getPointer(thisPersonName);
-    //if not found (getPointer return nullptr)
-    if(!thisPerson){
+    PersonId thisPerson = graph().find(thisPersonName);
+    //if not found
+    if(thisPerson == NO_PERSON){
         printNotFound(thisPersonName, output);
         return;
     }
     //else, creat the container to put the output name list
-    IdSet namelist = {};
+    PersonIdList namelist = {};
     //helper container, to put the parents name list
-    IdSet namelistParent = {};
+    PersonIdList namelistParent = {};
 
     //find the parents
-    collectRelationsWithDepth(thisPersonName, namelistParent, "parent");
+    collectRelationsWithDepth(thisPerson, namelistParent, Direction::PARENT);
 
 
     //find the children of this person's parents
-    for(auto& parentName:namelistParent){
-        collectRelationsWithDepth(parentName, namelist, "child");
+    for(auto& parent:namelistParent){
+        collectRelationsWithDepth(parent, namelist, Direction::CHILD);
     }
     /* siblings are the children from this person's parent
      * but except this person her/himself */
-    namelist.erase(thisPersonName);
+    namelist.erase(std::remove(namelist.begin(), namelist.end(), thisPerson),
+                   namelist.end());
     //print the name list
     printGroup(thisPersonName, groupName, namelist, output);
 }
@@ -162,43 +220,45 @@ void Familytree::printCousins(Params params, std::ostream& output) const
     //get the person's name from user's input
     std::string thisPersonName = params.at(0);
     //search the person in the dataset by name
-    Person* thisPerson = getPointer(thisPersonName);
-    //if not found (getPointer return nullptr)
-    if(!thisPerson){
+    PersonId thisPerson = graph().find(thisPersonName);
+    //if not found
+    if(thisPerson == NO_PERSON){
         printNotFound(thisPersonName, output);
         return;
     }
     //else, creat the container to put the output name list
-    IdSet namelist = {};
+    PersonIdList namelist = {};
     //helper container, to put the name list of parents
-    IdSet namelistParents = {};
+    PersonIdList namelistParents = {};
     //helper container, to put the name list of grandparents
-    IdSet namelistGrandparents = {};
+    PersonIdList namelistGrandparents = {};
     //helper container, to put the name list of children of grandparents
-    IdSet namelistAuntUncle = {};
+    PersonIdList namelistAuntUncle = {};
 
     //find the parents
-    collectRelationsWithDepth(thisPersonName, namelistParents,
-                              "parent");
+    collectRelationsWithDepth(thisPerson, namelistParents,
+                              Direction::PARENT);
 
     //find the grandparents
-    collectRelationsWithDepth(thisPersonName, namelistGrandparents,
-                              "parent", 1);
+    collectRelationsWithDepth(thisPerson, namelistGrandparents,
+                              Direction::PARENT, 1);
 
     //find the siblings of the person's parents ==> aunts and uncles
-    for(auto& auntUncleName:namelistGrandparents){
+    for(auto& grandparent:namelistGrandparents){
         collectRelationsWithDepth
-                (auntUncleName, namelistAuntUncle, "child");
+                (grandparent, namelistAuntUncle, Direction::CHILD);
     }
     /* parents' siblings are the children from grandparents
      * but except parents themselves */
-    for(auto& parentName:namelistParents){
-        namelistAuntUncle.erase(parentName);
+    for(auto& parent:namelistParents){
+        namelistAuntUncle.erase(std::remove(namelistAuntUncle.begin(),
+                                            namelistAuntUncle.end(), parent),
+                                namelistAuntUncle.end());
     }
 
     //find the children of aunts and uncles ==> cousins
-    for(auto& cousinsName:namelistAuntUncle){
-        collectRelationsWithDepth(cousinsName, namelist, "child");
+    for(auto& auntUncle:namelistAuntUncle){
+        collectRelationsWithDepth(auntUncle, namelist, Direction::CHILD);
     }
     //print the name list
     printGroup(thisPersonName, groupName, namelist, output);
@@ -210,23 +270,22 @@ void Familytree::printTallestInLineage(Params params,
     //get the person's name from user's input
     std::string thisPersonName = params.at(0);
     //search the person in the dataset by name
-    Person* thisPerson = getPointer(thisPersonName);
-    //if not found (getPointer return nullptr)
-    if(!thisPerson){
+    PersonId thisPerson = graph().find(thisPersonName);
+    //if not found
+    if(thisPerson == NO_PERSON){
         printNotFound(thisPersonName, output);
         return;
     }
     //not for finding the shortest ==> for tallest
     bool isForShortest = false;
     //initialize the tallest person's name
-    std::string resultName = "";
+    PersonId resultId = NO_PERSON;
     //initialize the height of the tallest person
     int resultHeight = NO_HEIGHT;
     //collect the data of height and name for the tallest person
-    collectHeightResult(thisPersonName, resultName, resultHeight,
-                        isForShortest);
+    collectHeightResult(thisPerson, resultId, resultHeight, isForShortest);
     //print the data
-    printHeightResult(thisPersonName, resultName, resultHeight,
+    printHeightResult(thisPerson, resultId, resultHeight,
                       isForShortest, output);
 }
 
@@ -236,23 +295,22 @@ void Familytree::printShortestInLineage(Params params,
     //get the person's name from user's input
     std::string thisPersonName = params.at(0);
     //search the person in the dataset by name
-    Person* thisPerson = getPointer(thisPersonName);
-    //if not found (getPointer return nullptr)
-    if(!thisPerson){
+    PersonId thisPerson = graph().find(thisPersonName);
+    //if not found
+    if(thisPerson == NO_PERSON){
         printNotFound(thisPersonName, output);
         return;
     }
 
     bool isForShortest = true;
     //initialize the shortest person's name
-    std::string resultName = "";
+    PersonId resultId = NO_PERSON;
     //initialize the height of the shortest person
     int resultHeight = NO_HEIGHT;
     //collect the data of height and name for the shortest person
-    collectHeightResult(thisPersonName, resultName, resultHeight,
-                        isForShortest);
+    collectHeightResult(thisPerson, resultId, resultHeight, isForShortest);
     //print the data
-    printHeightResult(thisPersonName, resultName, resultHeight,
+    printHeightResult(thisPerson, resultId, resultHeight,
                       isForShortest, output);
 }
 
@@ -264,14 +322,14 @@ void Familytree::printGrandChildrenN(Params params, std::ostream& output) const
     //get the person's name from user's input
     std::string thisPersonName = params.at(0);
     //search the person in the dataset by name
-    Person* thisPerson = getPointer(thisPersonName);
-    //if not found (getPointer return nullptr)
-    if(!thisPerson){
+    PersonId thisPerson = graph().find(thisPersonName);
+    //if not found
+    if(thisPerson == NO_PERSON){
         printNotFound(thisPersonName, output);
         return;
     }
     //else, creat the container to put the output name list
-    IdSet namelist = {};
+    PersonIdList namelist = {};
     //get the searching depth from the user's input
     int depth = stoi(params.at(1));
     //level should always be no less than 1 (children is 0)
@@ -280,7 +338,7 @@ void Familytree::printGrandChildrenN(Params params, std::ostream& output) const
         return;
     }
     //collect the data of all the members with certain depth
-    collectRelationsWithDepth(thisPersonName, namelist, "child", depth);
+    collectRelationsWithDepth(thisPerson, namelist, Direction::CHILD, depth);
     //print the data
     printGroup(thisPersonName, groupName, namelist, output, depth);
 }
@@ -293,14 +351,14 @@ void Familytree::printGrandParentsN(Params params, std::ostream& output) const
     //get the person's name from user's input
     std::string thisPersonName = params.at(0);
     //search the person in the dataset by name
-    Person* thisPerson = getPointer(thisPersonName);
-    //if not found (getPointer return nullptr)
-    if(!thisPerson){
+    PersonId thisPerson = graph().find(thisPersonName);
+    //if not found
+    if(thisPerson == NO_PERSON){
         printNotFound(thisPersonName, output);
         return;
     }
     //else, creat the container to put the output name list
-    IdSet namelist = {};
+    PersonIdList namelist = {};
     //get the searching depth from the user's input
     int depth = stoi(params.at(1));
     //level should always be no less than 1 (parent is 0)
@@ -309,21 +367,126 @@ void Familytree::printGrandParentsN(Params params, std::ostream& output) const
         return;
     }
     //collect the data of all the members with certain depth
-    collectRelationsWithDepth(thisPersonName, namelist, "parent", depth);
+    collectRelationsWithDepth(thisPerson, namelist, Direction::PARENT,
+                              depth);
     //print the data
     printGroup(thisPersonName, groupName, namelist, output, depth);
 }
 
-//======== below are private functions ========
+void Familytree::printRelation(Params params, std::ostream& output) const
+{
+    //get the persons' names from user's input
+    std::string firstName = params.at(0);
+    std::string secondName = params.at(1);
+    //search the persons in the dataset by name
+    PersonId first = graph().find(firstName);
+    PersonId second = graph_.find(secondName);
+    //if not found
+    for(auto& [person, name]:{std::make_pair(first, firstName),
+                              std::make_pair(second, secondName)}){
+        if(person == NO_PERSON){
+            printNotFound(name, output);
+            return;
+        }
+    }
+    if(first == second){
+        output << firstName << " and " << secondName
+               << " are the same person." << std::endl;
+        return;
+    }
+    int fromFirst = 0;
+    int fromSecond = 0;
+    PersonIdList ancestors = {};
+    if(!findCommonAncestors(first, second, fromFirst, fromSecond,
+                            ancestors)){
+        output << firstName << " and " << secondName
+               << " are not related." << std::endl;
+        return;
+    }
+    bool isHalf = ancestors.size() == 1;
+    output << firstName << " is " << secondName << "'s "
+           << relationName(first, fromFirst, fromSecond, isHalf) << "."
+           << std::endl;
+}
 
-Person *Familytree::getPointer(const std::string& id) const
+void Familytree::printKinship(Params params, std::ostream& output) const
 {
-    //if person not found
-    if(peopleMap_.find(id) == peopleMap_.end()){
-        return nullptr;
+    //get the persons' names from user's input
+    std::string firstName = params.at(0);
+    std::string secondName = params.at(1);
+    //search the persons in the dataset by name
+    PersonId first = graph().find(firstName);
+    PersonId second = graph_.find(secondName);
+    const std::vector<int>& depths = ancestorDepths();
+    for(auto& [person, name]:{std::make_pair(first, firstName),
+                              std::make_pair(second, secondName)}){
+        //if not found
+        if(person == NO_PERSON){
+            printNotFound(name, output);
+            return;
+        }
+        //the generations of the ancestors are needed
+        if(depths.at(person) == INT_MAX){
+            printCycle(name, output);
+            return;
+        }
+    }
+    double coefficient = 0.0;
+    {
+        std::lock_guard<std::mutex> lock(memoMutex_);
+        coefficient = kinship_.kinship(graph_, depths, first, second);
     }
-    //else return the Person pointer of this person
-    return peopleMap_.at(id).get();
+    output << "The kinship coefficient of " << firstName << " and "
+           << secondName << " is " << coefficient << "." << std::endl;
+}
+
+void Familytree::printInbreeding(Params, std::ostream& output) const
+{
+    const FamilyGraph& persons = graph();
+    const std::vector<int>& depths = ancestorDepths();
+    unsigned threads = std::thread::hardware_concurrency();
+    //KINSHIP may fill the same memo on another thread
+    std::lock_guard<std::mutex> lock(memoMutex_);
+    const std::vector<double>& inbreeding =
+            kinship_.computeAll(persons, depths, threads);
+    //the inbred ones in the alphabetical order
+    std::vector<PersonId> inbred = {};
+    std::size_t onCycle = 0;
+    for(PersonId person:persons.byName()){
+        if(inbreeding.at(person) < 0.0){
+            ++onCycle;
+        }
+        else if(inbreeding.at(person) > 0.0){
+            inbred.push_back(person);
+        }
+    }
+    if(inbred.empty()){
+        output << "No one is inbred." << std::endl;
+    }
+    else{
+        output << inbred.size()
+               << (inbred.size() == 1 ? " person is" : " persons are")
+               << " inbred:" << std::endl;
+        for(PersonId person:inbred){
+            output << persons.name(person) << ", "
+                   << inbreeding.at(person) << std::endl;
+        }
+    }
+    if(onCycle > 0){
+        output << onCycle
+               << (onCycle == 1 ? " person has" : " persons have")
+               << " a cycle in their ancestors." << std::endl;
+    }
+}
+
+//======== below are private functions ========
+
+const FamilyGraph& Familytree::graph() const
+{
+    //build the CSR and the sorted names if something has been added
+    std::lock_guard<std::mutex> lock(memoMutex_);
+    graph_.freeze();
+    return graph_;
 }
 
 void Familytree::printNotFound(const std::string& id,
@@ -332,26 +495,22 @@ void Familytree::printNotFound(const std::string& id,
     output << "Error. " << id << " not found." << std::endl;
 }
 
-IdSet Familytree::vectorToIdSet(const std::vector<Person*>& container) const
+void Familytree::printCycle(const std::string& id,
+                            std::ostream& output) const
 {
-    IdSet idList = {};
-    /* With the given container contains members' pointers,
-     * if the pointer is valid (not nullptr),
-     * then the id(string) of this person can be added to the idSet */
-    for(auto person:container){
-        if(person){
-            idList.insert(person->id_);
-        }
-    }
-    return idList;
+    output << "Error. " << id << "'s ancestors form a cycle." << std::endl;
 }
 
 void Familytree::printGroup(const std::string& id, const std::string& group,
-                            const IdSet& container, std::ostream& output,
-                            const int depth) const
+                            const PersonIdList& container,
+                            std::ostream& output, const int depth) const
 {
+    //the members in the alphabetical order, without the duplicates
+    std::vector<PersonId> members(container.begin(), container.end());
+    graph_.sortByName(members);
+
     //no id in the container ==> no result in previous searching
-    if(container.empty()){
+    if(members.empty()){
         output << id << " has no ";
         /* when depth = 1, it is searching grandchildren/grandparents,
          * still no need to use any "great-" string.
@@ -365,7 +524,7 @@ void Familytree::printGroup(const std::string& id, const std::string& group,
     }
     /* when there is at least one id:
      * the size of the container is the amount of target members */
-    output << id << " has " << container.size() << " " ;
+    output << id << " has " << members.size() << " " ;
     /* when depth = 1, it is searching grandchildren/grandparents,
      * still no need to use any "great-" string.
      * So this branch should start from depth = 2
@@ -375,91 +534,440 @@ void Familytree::printGroup(const std::string& id, const std::string& group,
     }
     output << group << ":" << std::endl;
     //print every member's name
-    for(auto& memberName:container){
-        output << memberName << std::endl;
+    for(PersonId member:members){
+        output << graph_.name(member) << std::endl;
     }
 }
 
 //======== below are my addition private functions ========
 
-void Familytree::collectDescendants(const std::string& id,
-                                    IdSet& descendantsList) const
+IdRange Familytree::relatives(PersonId person, Direction direction) const
 {
-    //get the pointer with the name of the person in current round
-    Person* eachPerson = getPointer(id);
-    //when it is nullptr ==> last round is the end of the branch of tree
-    if(!eachPerson){
-        return;
+    if(direction == Direction::PARENT){
+        const ParentIds& parents = graph_.parents(person);
+        return {parents.data(), parents.data() + parents.size()};
+    }
+    return graph_.children(person);
+}
+
+void Familytree::collectDescendants(PersonId person,
+                                    PersonIdList& descendantsList) const
+{
+    VisitMarks& marks = scratch.marks_;
+    marks.start(graph_.size());
+    /* the descendants found are also the queue of the persons whose
+     * children are still to be found */
+    std::size_t next = descendantsList.size();
+    PersonId eachPerson = person;
+    while(true){
+        //in the children group of current person
+        for(PersonId child:graph_.children(eachPerson)){
+            //a child met on an earlier line is not expanded again
+            if(marks.mark(child)){
+                descendantsList.push_back(child);
+            }
+        }
+        if(next == descendantsList.size()){
+            break;
+        }
+        eachPerson = descendantsList.at(next++);
+    }
+}
+
+void Familytree::collectRelationsWithDepth(PersonId person,
+                                           PersonIdList& membersList,
+                                           Direction direction,
+                                           int maxDepth) const
+{
+    //the persons of the current level, e.g. the person's parents
+    PersonIdList level = {person};
+    PersonIdList nextLevel = {};
+    VisitMarks& marks = scratch.marks_;
+    for(int depth = 0; depth <= maxDepth and !level.empty(); ++depth){
+        //a person reached on many lines is kept only once on a level
+        marks.start(graph_.size());
+        nextLevel.clear();
+        for(PersonId eachPerson:level){
+            for(PersonId member:relatives(eachPerson, direction)){
+                //an unknown parent ==> the end of the branch of tree
+                if(member != NO_PERSON and marks.mark(member)){
+                    nextLevel.push_back(member);
+                }
+            }
+        }
+        level.swap(nextLevel);
+    }
+    //level is empty if the tree ended before the target depth
+    membersList.insert(membersList.end(), level.begin(), level.end());
+}
+
+
+bool Familytree::memoizeLineage(PersonId person) const
+{
+    lineage_.resize(graph_.size());
+    lineageState_.resize(graph_.size(), UNKNOWN);
+    if(lineageState_.at(person) == DONE){
+        return true;
     }
-    //in the children group of current person
-    for(auto& child:eachPerson->children_){
-        //if the element inside the children group is valid
-        if(child){
-            //then the element is one of the descendant
-            descendantsList.insert(child->id_);
-            //recurssively find the children of each child and so on...
-            collectDescendants(child->id_, descendantsList);
+    //tell if a descendant is better than the best found so far
+    auto isBetter = [this](PersonId candidate, PersonId best,
+                           bool isForShortest){
+        if(best == NO_PERSON){
+            return true;
+        }
+        int candidateHeight = graph_.height(candidate);
+        int bestHeight = graph_.height(best);
+        if(candidateHeight != bestHeight){
+            return isForShortest ? candidateHeight < bestHeight
+                                 : candidateHeight > bestHeight;
+        }
+        //the same height: the later one in the alphabetical order
+        return graph_.rank(candidate) > graph_.rank(best);
+    };
+
+    //depth-first, a person is done when all her/his children are
+    std::vector<std::pair<PersonId, std::size_t>> path = {{person, 0}};
+    lineageState_.at(person) = VISITING;
+    while(!path.empty()){
+        PersonId eachPerson = path.back().first;
+        IdRange children = graph_.children(eachPerson);
+        std::size_t& nextChild = path.back().second;
+        if(nextChild < children.size()){
+            PersonId child = children.begin()[nextChild++];
+            if(lineageState_.at(child) == VISITING){
+                //a cycle: the persons on the path stay unknown
+                for(auto& step:path){
+                    lineageState_.at(step.first) = UNKNOWN;
+                }
+                return false;
+            }
+            if(lineageState_.at(child) == UNKNOWN){
+                lineageState_.at(child) = VISITING;
+                path.push_back({child, 0});
+            }
+            continue;
+        }
+        LineageExtremes best;
+        for(PersonId child:children){
+            const LineageExtremes& childBest = lineage_.at(child);
+            for(PersonId candidate:{child, childBest.tallest_}){
+                if(candidate != NO_PERSON
+                        and isBetter(candidate, best.tallest_, false)){
+                    best.tallest_ = candidate;
+                }
+            }
+            for(PersonId candidate:{child, childBest.shortest_}){
+                if(candidate != NO_PERSON
+                        and isBetter(candidate, best.shortest_, true)){
+                    best.shortest_ = candidate;
+                }
+            }
         }
+        lineage_.at(eachPerson) = best;
+        lineageState_.at(eachPerson) = DONE;
+        path.pop_back();
     }
+    return true;
 }
 
-void Familytree::collectRelationsWithDepth(const std::string& id,
-                                             IdSet& membersList,
-                                             std::string direction,
-                                             int maxDepth,
-                                             int currentDepth) const
+void Familytree::invalidateLineage(PersonId person)
 {
-    //if the search exceeds the depth, then stop
-    if(currentDepth > maxDepth){
+    if(person == NO_PERSON or lineageState_.empty()){
         return;
     }
-    //get the pointer with the name of the person in current round
-    Person* eachPerson = getPointer(id);
-    //when it is nullptr ==> last round is the end of the branch of tree
-    if(!eachPerson){
+    if(relationReplaced_){
+        lineageState_.assign(lineageState_.size(), UNKNOWN);
         return;
     }
-    //decide the target relation direction of current person
-    std::vector<Person*> membersToSearch;
-    if(direction == "parent"){
-        membersToSearch = eachPerson->parents_;
-    }
-    else if(direction == "child"){
-        membersToSearch = eachPerson->children_;
-    }
-    //in the target group of current person
-    for(auto& member:membersToSearch){
-        if(member){
-            /* add the name of the target ralation only when
-             * the recursion reaches the exact target depth */
-            if(currentDepth == maxDepth){
-                membersList.insert(member->id_);
+    //the ancestors of an unknown person are unknown already
+    std::vector<PersonId> toForget = {person};
+    while(!toForget.empty()){
+        PersonId eachPerson = toForget.back();
+        toForget.pop_back();
+        if(eachPerson >= lineageState_.size()
+                or lineageState_.at(eachPerson) != DONE){
+            continue;
+        }
+        lineageState_.at(eachPerson) = UNKNOWN;
+        for(PersonId parent:graph_.parents(eachPerson)){
+            if(parent != NO_PERSON){
+                toForget.push_back(parent);
+            }
+        }
+    }
+}
+
+const std::vector<int>& Familytree::ancestorDepths() const
+{
+    std::lock_guard<std::mutex> lock(memoMutex_);
+    std::size_t count = graph_.size();
+    if(ancestorDepth_.size() == count){
+        return ancestorDepth_;
+    }
+    //the persons whose known parents all have a depth (Kahn's algorithm)
+    std::vector<std::uint32_t> parentsLeft(count, 0);
+    for(PersonId person = 0; person < count; ++person){
+        for(PersonId child:graph_.children(person)){
+            ++parentsLeft.at(child);
+        }
+    }
+    ancestorDepth_.assign(count, 0);
+    PersonIdList ready = {};
+    for(PersonId person = 0; person < count; ++person){
+        if(parentsLeft.at(person) == 0){
+            ready.push_back(person);
+        }
+    }
+    while(!ready.empty()){
+        PersonId parent = ready.back();
+        ready.pop_back();
+        for(PersonId child:graph_.children(parent)){
+            int& depth = ancestorDepth_.at(child);
+            depth = std::max(depth, ancestorDepth_.at(parent) + 1);
+            if(--parentsLeft.at(child) == 0){
+                ready.push_back(child);
+            }
+        }
+    }
+    //the persons on or below a cycle are never ready
+    for(PersonId person = 0; person < count; ++person){
+        if(parentsLeft.at(person) != 0){
+            ancestorDepth_.at(person) = INT_MAX;
+        }
+    }
+    return ancestorDepth_;
+}
+
+bool Familytree::findCommonAncestors(PersonId first, PersonId second,
+                                     int& fromFirst, int& fromSecond,
+                                     PersonIdList& ancestors) const
+{
+    const std::vector<int>& depths = ancestorDepths();
+    //the ancestors found from one person, by the generations up
+    struct Side
+    {
+        VisitMarks& found_;
+        std::vector<int>& distance_;
+        PersonIdList frontier_;
+        int level_ = 0;
+        int youngest_ = 0;
+    };
+    Side sides[2] = {
+        {scratch.relationMarks_[0], scratch.relationDistance_[0], {}, 0, 0},
+        {scratch.relationMarks_[1], scratch.relationDistance_[1], {}, 0, 0}};
+    for(int i = 0; i < 2; ++i){
+        PersonId person = i == 0 ? first : second;
+        sides[i].found_.start(graph_.size());
+        sides[i].distance_.resize(graph_.size());
+        sides[i].found_.mark(person);
+        sides[i].distance_.at(person) = 0;
+        sides[i].frontier_ = {person};
+        sides[i].youngest_ = depths.at(person);
+    }
+    //the fewest generations in between found so far
+    int best = INT_MAX;
+    std::vector<std::pair<int, PersonId>> meetings = {};
+
+    while(true){
+        //a side going up finds ancestors at least level_ + 1 away
+        bool canGo[2];
+        for(int i = 0; i < 2; ++i){
+            canGo[i] = !sides[i].frontier_.empty()
+                    and sides[i].level_ + 1 <= best;
+        }
+        if(!canGo[0] and !canGo[1]){
+            break;
+        }
+        int go = canGo[0] ? 0 : 1;
+        if(canGo[0] and canGo[1]){
+            const Side& a = sides[0];
+            const Side& b = sides[1];
+            if(a.youngest_ != b.youngest_){
+                go = a.youngest_ > b.youngest_ ? 0 : 1;
             }
             else{
-                /* recurssively find the children/parents of
-                 * each child/parent (depends on the direction) and so on... */
-                collectRelationsWithDepth(member->id_, membersList,
-                                          direction,
-                                          maxDepth, currentDepth + 1);
+                go = a.frontier_.size() <= b.frontier_.size() ? 0 : 1;
             }
         }
+        Side& side = sides[go];
+        const Side& other = sides[1 - go];
+        PersonIdList nextFrontier = {};
+        int youngest = 0;
+        for(PersonId eachPerson:side.frontier_){
+            for(PersonId parent:graph_.parents(eachPerson)){
+                if(parent == NO_PERSON or !side.found_.mark(parent)){
+                    continue;
+                }
+                side.distance_[parent] = side.level_ + 1;
+                nextFrontier.push_back(parent);
+                youngest = std::max(youngest, depths.at(parent));
+                /* a common ancestor (the other person her/himself, if an
+                 * ancestor of this one) */
+                if(!other.found_.isMarked(parent)){
+                    continue;
+                }
+                int fromOther = other.distance_[parent];
+                int between = side.level_ + 1 + fromOther;
+                if(between < best){
+                    best = between;
+                    meetings.clear();
+                }
+                if(between == best){
+                    int fromThis = side.level_ + 1;
+                    int fromFirstPerson = go == 0 ? fromThis : fromOther;
+                    meetings.push_back({fromFirstPerson, parent});
+                }
+            }
+        }
+        side.frontier_.swap(nextFrontier);
+        side.youngest_ = youngest;
+        ++side.level_;
+    }
+    if(meetings.empty()){
+        return false;
+    }
+    //of the nearest, the ones with the most even distances
+    auto evenness = [best](int fromFirstPerson){
+        return std::abs(best - 2 * fromFirstPerson);
+    };
+    int mostEven = INT_MAX;
+    for(auto& meeting:meetings){
+        mostEven = std::min(mostEven, evenness(meeting.first));
     }
+    fromFirst = -1;
+    for(auto& meeting:meetings){
+        if(evenness(meeting.first) != mostEven){
+            continue;
+        }
+        //the same evenness both ways: the nearer to the first person
+        if(fromFirst == -1 or meeting.first < fromFirst){
+            fromFirst = meeting.first;
+            ancestors.clear();
+        }
+        if(meeting.first == fromFirst){
+            ancestors.push_back(meeting.second);
+        }
+    }
+    fromSecond = best - fromFirst;
+    return true;
 }
 
+std::string Familytree::relationName(PersonId person, int fromPerson,
+                                     int fromOther, bool isHalf) const
+{
+    //"great-" for every generation past the second
+    auto greats = [](int generations){
+        std::string prefix = "";
+        for(int i = 2; i < generations; ++i){
+            prefix += "great-";
+        }
+        return prefix;
+    };
+    //the person is an ancestor of the other
+    if(fromPerson == 0){
+        return greats(fromOther)
+                + (fromOther >= 2 ? "grandparent" : "parent");
+    }
+    //the person is a descendant of the other
+    if(fromOther == 0){
+        return greats(fromPerson)
+                + (fromPerson >= 2 ? "grandchild" : "child");
+    }
+    std::string half = isHalf ? "half-" : "";
+    if(fromPerson == 1 and fromOther == 1){
+        return half + "sibling";
+    }
+    //the person is a sibling of an ancestor of the other
+    if(fromPerson == 1){
+        return half + greats(fromOther)
+                + genderedName(person, "aunt", "uncle");
+    }
+    //the person is a descendant of a sibling of the other
+    if(fromOther == 1){
+        return half + greats(fromPerson)
+                + genderedName(person, "niece", "nephew");
+    }
+    const std::vector<std::string> ORDINALS = {
+        "first", "second", "third", "fourth", "fifth",
+        "sixth", "seventh", "eighth", "ninth", "tenth"};
+    int degree = std::min(fromPerson, fromOther) - 1;
+    int removed = std::abs(fromPerson - fromOther);
+    std::string name = isHalf ? "half " : "";
+    if(degree <= static_cast<int>(ORDINALS.size())){
+        name += ORDINALS.at(degree - 1);
+    }
+    //11th, 12th, 13th, but 21st, 22nd, 23rd
+    else{
+        std::string suffix = "th";
+        if(degree % 100 < 11 or degree % 100 > 13){
+            const std::string SUFFIXES[] = {"th", "st", "nd", "rd"};
+            suffix = degree % 10 <= 3 ? SUFFIXES[degree % 10] : "th";
+        }
+        name += std::to_string(degree) + suffix;
+    }
+    name += " cousin";
+    if(removed == 1){
+        name += " once removed";
+    }
+    else if(removed == 2){
+        name += " twice removed";
+    }
+    else if(removed > 2){
+        name += " " + std::to_string(removed) + " times removed";
+    }
+    return name;
+}
+
+std::string Familytree::genderedName(PersonId person,
+                                     const std::string& female,
+                                     const std::string& male) const
+{
+    for(PersonId child:graph_.children(person)){
+        const ParentIds& parents = graph_.parents(child);
+        if(parents.at(0) == person){
+            return male;
+        }
+        if(parents.at(1) == person){
+            return female;
+        }
+    }
+    return female + "/" + male;
+}
 
-void Familytree::collectHeightResult(const std::string& id,
-                                     std::string& resultId,
+void Familytree::collectHeightResult(PersonId person, PersonId& resultId,
                                      int& resultHeight,
                                      bool isForShortest) const
 {
-    //container to put the output name list
-    IdSet namelist;
-    collectDescendants(id, namelist);
     //initialize the result by the person's height
-    resultHeight = getPointer(id)->height_;
+    resultHeight = graph_.height(person);
+    resultId = person;
+    std::unique_lock<std::mutex> lock(memoMutex_);
+    if(memoizeLineage(person)){
+        LineageExtremes best = lineage_.at(person);
+        lock.unlock();
+        PersonId descendant = isForShortest ? best.shortest_ : best.tallest_;
+        if(descendant == NO_PERSON){
+            return;
+        }
+        //a descendant as tall/short as the person is the one named
+        int descendantHeight = graph_.height(descendant);
+        if(isForShortest ? descendantHeight <= resultHeight
+                         : descendantHeight >= resultHeight){
+            resultHeight = descendantHeight;
+            resultId = descendant;
+        }
+        return;
+    }
+
+    lock.unlock();
+    //a cycle in the data: search the descendants of the person
+    //container to put the output list, in the alphabetical order
+    PersonIdList namelist;
+    collectDescendants(person, namelist);
+    graph_.sortByName(namelist);
     //find the target height
-    for(auto& eachDescendant:namelist){
-        int eachDescendantHeight = getPointer(eachDescendant)->height_;
+    for(PersonId eachDescendant:namelist){
+        int eachDescendantHeight = graph_.height(eachDescendant);
         //set the conparison rule: whether it is finding the shortest person
         if(isForShortest){
             if(resultHeight > eachDescendantHeight){
@@ -473,19 +981,17 @@ void Familytree::collectHeightResult(const std::string& id,
             }
         }
     }
-    //find the target person
-    resultId = id;
-    for(auto& eachDescendant:namelist){
-        int eachDescendantHeight = getPointer(eachDescendant)->height_;
-        //when this person's height = the target height, store the name
-        if(eachDescendantHeight == resultHeight){
+    /* find the target person: the last one in the alphabetical order
+     * with the target height, or the person her/himself */
+    for(PersonId eachDescendant:namelist){
+        //when this person's height = the target height, store the id
+        if(graph_.height(eachDescendant) == resultHeight){
             resultId = eachDescendant;
         }
     }
 }
 
-void Familytree::printHeightResult(const std::string& id,
-                                   const std::string& resultId,
+void Familytree::printHeightResult(PersonId person, PersonId resultId,
                                    int resultHeight, bool isForShortest,
                                    std::ostream& output) const
 {
@@ -500,19 +1006,19 @@ void Familytree::printHeightResult(const std::string& id,
         forFunction = "shortest";
     }
     //if the target person is the person her/himself
-    if(resultId == id){
+    if(resultId == person){
         output << "With the height of " << resultHeight << ", "
-                << id
+                << graph_.name(person)
                 << " is the " << forFunction
                 << " person in his/her lineage." << std::endl;
     }
     //if the target person is someone else
     else{
         output << "With the height of " << resultHeight << ", "
-                << resultId
+                << graph_.name(resultId)
                 << " is the " << forFunction
                 << " person in "
-                << id << "'s lineage." << std::endl;
+                << graph_.name(person) << "'s lineage." << std::endl;
     }
 }
 
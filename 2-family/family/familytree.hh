@@ -4,8 +4,8 @@
 # Project: Suku on pahin / All in the family                                #
 # File: familytree.hh                                                       #
 # Description: Familytree class                                             #
-#   Contains a datastructure that is populated with Person structs and      #
-#   provides some query functions.                                          #
+#   Contains a datastructure that is populated with the persons and their   #
+#   relations (see familygraph.hh) and provides some query functions.       #
 # Notes: * This is a part of an exercise program                            #
 #        * Student's aren't allowed to alter public interface!              #
 #        * All changes to private side are allowed.                         #
@@ -28,10 +28,13 @@
 
 #include <string>
 #include <vector>
-#include <set>
 #include <map>
 #include <iostream>
 #include <memory>
+#include <mutex>
+
+#include "familygraph.hh"
+#include "kinship.hh"
 
 using Params = const std::vector<std::string>&;
 
@@ -43,16 +46,7 @@ const int NO_HEIGHT = -1;
 const std::string ALREADY_ADDED = "Error. Person already added.";
 const std::string WRONG_LEVEL = "Error. Level can't be less than 1.";
 
-// Struct for the persons data.
-struct Person
-{
-    std::string id_ = NO_ID;
-    int height_ = NO_HEIGHT;
-    std::vector<Person*> parents_{nullptr, nullptr};
-    std::vector<Person*> children_;
-};
-
-using IdSet = std::set<std::string>;
+using PersonIdList = std::vector<PersonId>;
 
 /**
  * @brief The Familytree class
@@ -86,6 +80,34 @@ public:
                      const std::vector<std::string>& parents,
                      std::ostream& output);
 
+    /**
+     * @brief loadGraph
+     * @param graph has all the persons and relations of the datafile
+     * @param relationReplaced is true if a relation was given again for
+     *        a child who had parents already
+     * Replace the persons with the ones loaded at once by FamilyLoader.
+     */
+    void loadGraph(FamilyGraph&& graph, bool relationReplaced);
+
+    /**
+     * @brief loadSnapshot
+     * @param path
+     * @param output is for the error message
+     * @return true if the file is a valid snapshot
+     * Replace the persons with the ones of the snapshot file saved by
+     * SAVE. The file is mapped and queried in place.
+     */
+    bool loadSnapshot(const std::string& path, std::ostream& output);
+
+    /**
+     * @brief saveSnapshot
+     * @param params (contains the path of the file)
+     * @param output
+     * Save the persons and the relations as a binary snapshot file,
+     * which can be given as the input file instead of the datafile.
+     */
+    void saveSnapshot(Params params, std::ostream& output) const;
+
     /**
      * @brief printPersons
      * @param output
@@ -157,6 +179,34 @@ public:
      */
     void printGrandParentsN(Params params, std::ostream& output) const;
 
+    /**
+     * @brief printRelation
+     * @param params (contains two persons' ids)
+     * @param output
+     * Print how the first person is related to the second one, e.g.
+     * "A is B's first cousin twice removed.", by the nearest common
+     * ancestors of them.
+     */
+    void printRelation(Params params, std::ostream& output) const;
+
+    /**
+     * @brief printKinship
+     * @param params (contains two persons' ids)
+     * @param output
+     * Print the kinship coefficient of the persons: the probability that
+     * a gene taken at random from each of them is identical by descent.
+     */
+    void printKinship(Params params, std::ostream& output) const;
+
+    /**
+     * @brief printInbreeding
+     * @param params
+     * @param output
+     * Print the inbred persons, the ones whose parents are related, with
+     * their inbreeding coefficients in the alphabetical order.
+     */
+    void printInbreeding(Params params, std::ostream& output) const;
+
 private:
     /* The following functions are meant to make project easier.
      * You can implement them if you want and/or create your own.
@@ -166,21 +216,55 @@ private:
 
     //======== below is the private variable I add ========
 
-    /* the structure and the logic is basically like this:
-     * map<id, a smart ptr points to a Person type data>
-     *     ==ptr=>Person{id,
-     *                   height,
-     *                   (vector){ptr to parentA, ptr to parentB},
-     *                   (vector){ptr to children...}}*/
-    std::map<std::string, std::shared_ptr<Person>> peopleMap_;
+    /* the persons and the relations, by dense integer ids:
+     * string table of the names, two parent slots per person,
+     * children in CSR, and the ids sorted by name (see familygraph.hh).
+     * Every query below works on the ids; the names are only looked up
+     * for the input and the output.
+     * The graph is frozen (CSR and sorted names built) on the first query
+     * after persons or relations have been added, hence mutable. */
+    mutable FamilyGraph graph_;
+    /* the queries may run side by side (BATCH, see cli.hh): the graph is
+     * frozen and the memos below are filled under this lock, and the
+     * traversals have their scratch marks per thread (familytree.cpp) */
+    mutable std::mutex memoMutex_;
+
+    enum class Direction { PARENT, CHILD };
+
+    /* the memo of the lineage heights: for every person, the descendant
+     * TALLEST/SHORTEST would name if no one else is taller/shorter than
+     * the person her/himself (NO_PERSON if no descendants).
+     * A person is DONE only when all her/his descendants are DONE; thus
+     * the ancestors of an UNKNOWN person are UNKNOWN too, which lets the
+     * invalidation stop at the first UNKNOWN person. */
+    enum LineageState : char { UNKNOWN, VISITING, DONE };
+    struct LineageExtremes
+    {
+        PersonId tallest_ = NO_PERSON;
+        PersonId shortest_ = NO_PERSON;
+    };
+    mutable std::vector<LineageExtremes> lineage_;
+    mutable std::vector<LineageState> lineageState_;
+    /* a relation given again for a child leaves the child to the children
+     * of the earlier parents, which the parents of the child no longer
+     * tell; then the memo is always invalidated as a whole */
+    bool relationReplaced_ = false;
+
+    /* the ancestor-depth index: for every person, the number of
+     * generations above her/him on the longest line of ancestors
+     * (0 for a person with no known parents). Computed on the first
+     * RELATION after a change. */
+    mutable std::vector<int> ancestorDepth_;
+    /* the inbreeding coefficients and the kinship coefficients asked,
+     * computed in the generation order of the ancestor-depth index */
+    mutable Kinship kinship_;
 
     //====== below are the private functions offered by the template =======
     /**
-     * @brief getPointer
-     * @param id
-     * @return the pointer to Person object with the given id.
+     * @brief graph
+     * @return the graph, frozen for the queries
      */
-    Person* getPointer(const std::string& id) const;
+    const FamilyGraph& graph() const;
 
     /**
      * @brief printNotFound
@@ -191,12 +275,12 @@ private:
     void printNotFound(const std::string& id, std::ostream& output) const;
 
     /**
-     * @brief vectorToIdSet
-     * @param container
-     * @return set of ids of those persons included in the given container
-     * vector.
+     * @brief printCycle
+     * @param id
+     * @param output
+     * Print the error message for a person whose ancestors form a cycle.
      */
-    IdSet vectorToIdSet(const std::vector<Person*>& container) const;
+    void printCycle(const std::string& id, std::ostream& output) const;
 
     /**
      * @brief printGroup
@@ -206,61 +290,155 @@ private:
      * @param output
      * @param depth is used for print the message for great-...-grand-
      *        children/parents
-     * Print the data in the container.
+     * Print the names of the members in the alphabetical order, each once.
      * NOTE Compared to the original printGroup function offered by template,
      * I added a parameter depth to simplify the print for "great-" prefix.
      */
     void printGroup(const std::string& id, const std::string& group,
-                    const IdSet& container, std::ostream& output,
+                    const PersonIdList& container, std::ostream& output,
                     const int depth = 0) const;
 
     //======== below are the private functions I add ========
 
+    /**
+     * @brief relatives
+     * @param person
+     * @param direction
+     * @return the parents (NO_PERSON for an unknown one) or the children
+     *         of the person
+     */
+    IdRange relatives(PersonId person, Direction direction) const;
+
     /**
      * @brief collectDescendants
-     * @param id
+     * @param person
      * @param descendantsList collects the ids of all the descendants
      *        of the given person
      * Collects all the ids of descendants and put into the descendantsList.
+     * Every descendant is visited once, however many lines lead to
+     * her/him, so the cost is the number of descendants and their
+     * children, not the number of lines.
      */
-    void collectDescendants(const std::string& id,
-                            IdSet& descendantsList) const;
+    void collectDescendants(PersonId person,
+                            PersonIdList& descendantsList) const;
 
     /**
      * @brief collectRelationsWithDepth
-     * @param id
+     * @param person
      * @param memberList collects the ids of all the descendants/ancestors
      *        of the given person at the given depth,
      *        according to the direction.
      * @param direction shows the searching direction
-     *        e.g. "parent" is for ancestors,
-     *             "child" is for descendants
+     *        e.g. PARENT is for ancestors,
+     *             CHILD is for descendants
      * @param maxDepth e.g. children = 0, grandchildren = 1
-     * @param currentDepth is the current depth inside the recursion
      * Collects all the ids of target members at a certain level
      * and put into the memberList.
+     * The search goes one level (generation) at a time, and keeps every
+     * person only once on a level, however many lines lead to her/him;
+     * a level costs at most the number of persons on it and their
+     * relations.
      */
-    void collectRelationsWithDepth(const std::string& id,
-                                   IdSet& memberList, std::string direction,
-                                   int maxDepth = 0,
-                                   int currentDepth = 0) const;
+    void collectRelationsWithDepth(PersonId person,
+                                   PersonIdList& memberList,
+                                   Direction direction,
+                                   int maxDepth = 0) const;
+
+    /**
+     * @brief memoizeLineage
+     * @param person
+     * @return false if the lineage of the person has a cycle (a person is
+     *         her/his own descendant), true when the memo of the person
+     *         is DONE
+     * Fill the memo of the person and her/his descendants, children
+     * before parents (reverse topological order), each person only once:
+     * the best descendant of a person is the better of every child and
+     * the best descendant of that child. Called with memoMutex_ locked.
+     */
+    bool memoizeLineage(PersonId person) const;
+
+    /**
+     * @brief invalidateLineage
+     * @param person
+     * Forget the memo of the person and her/his ancestors, when her/his
+     * descendants have changed.
+     */
+    void invalidateLineage(PersonId person);
+
+    /**
+     * @brief ancestorDepths
+     * @return the ancestor-depth index, computed if there were changes
+     * The depths are given in the topological order from the persons with
+     * no parents down; a person on a cycle gets the depth INT_MAX.
+     * Locks memoMutex_ while computing.
+     */
+    const std::vector<int>& ancestorDepths() const;
+
+    /**
+     * @brief findCommonAncestors
+     * @param first
+     * @param second
+     * @param fromFirst is the number of generations from the first person
+     *        up to the nearest common ancestors (0 if it is her/himself)
+     * @param fromSecond the same from the second person
+     * @param ancestors collects the nearest common ancestors
+     * @return false if the persons have no common ancestors
+     * Search the ancestors of both persons at the same time, breadth-first
+     * (bidirectional), until no nearer common ancestor can be found. The
+     * nearest are the ones with the fewest generations in between; of
+     * those, the ones with the most even distances (cousins rather than
+     * aunts). At each step the side with the youngest generation in its
+     * frontier (by the ancestor-depth index) goes up, since the other
+     * side's frontier can't reach down to it.
+     */
+    bool findCommonAncestors(PersonId first, PersonId second,
+                             int& fromFirst, int& fromSecond,
+                             PersonIdList& ancestors) const;
+
+    /**
+     * @brief relationName
+     * @param person
+     * @param fromPerson is the number of generations from the person to
+     *        the nearest common ancestors
+     * @param fromOther the same from the other person
+     * @param isHalf is whether there is only one nearest common ancestor
+     * @return the name of the relation of the person to the other person,
+     *         e.g. "grandparent", "half-sibling", "great-aunt",
+     *         "second cousin once removed"
+     */
+    std::string relationName(PersonId person, int fromPerson, int fromOther,
+                             bool isHalf) const;
+
+    /**
+     * @brief genderedName
+     * @param person
+     * @param female
+     * @param male
+     * @return the name by the gender of the person, known if the person is
+     *         the mother or the father of someone; both names if unknown
+     */
+    std::string genderedName(PersonId person, const std::string& female,
+                             const std::string& male) const;
 
     /**
      * @brief collectHeightResult
-     * @param id
+     * @param person
      * @param resultId is the id of the tallest/shortest person
      * @param resultHeight is the height of the tallest/shortest person
      * @param isForShortest is whether this call is for
      *        the printShortestInLineage funtion
-     * Collect the data about tallest/shortest person's id and height.
+     * Collect the data about tallest/shortest person's id and height:
+     * the tallest/shortest height of the person and the descendants, and
+     * the last one of the descendants in the alphabetical order with that
+     * height, or the person her/himself if no descendant has it.
+     * The memo is used; without it (a cycle) the descendants are searched.
      */
-    void collectHeightResult(const std::string& id,
-                             std::string& resultId,
+    void collectHeightResult(PersonId person, PersonId& resultId,
                              int& resultHeight, bool isForShortest) const;
 
     /**
      * @brief printHeightResult
-     * @param id
+     * @param person
      * @param resultId is the id of the tallest/shortest person
      * @param resultHeight is the height of the tallest/shortest person
      * @param isForShortest is whether it is for
@@ -268,9 +446,9 @@ private:
      * @param output
      * Print the message about tallest/shortest person's id and height.
      */
-    void printHeightResult(const std::string& id,
-                           const std::string& resultId, int resultHeight,
-                           bool isForShortest, std::ostream& output) const;
+    void printHeightResult(PersonId person, PersonId resultId,
+                           int resultHeight, bool isForShortest,
+                           std::ostream& output) const;
 
 
     //for personal test ONLY
@@ -0,0 +1,278 @@
+//Description:
+/* This file implements the functions for class Kinship.
+ * The file contains all the implementations for the member functions
+ * and the comments on the functions' logic.
+ *
+ * File author
+ * Name: Ruowen Liu
+ * Student number: -
+ * UserID: -
+ * E-Mail: ruowen.liu@tuni.fi
+ * */
+
+#include "kinship.hh"
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <thread>
+
+namespace
+{
+//not computed yet
+const double UNKNOWN = -1.0;
+//a generation this small is not worth starting threads for
+const std::size_t MIN_PARALLEL_GENERATION = 256;
+
+//the rounding errors of the sums, not inbreeding
+double cleaned(double coefficient)
+{
+    return std::fabs(coefficient) < 1e-12 ? 0.0 : coefficient;
+}
+
+//d(person); the inbreeding coefficients of the parents must be known
+double ownShare(const FamilyGraph& graph,
+                const std::vector<double>& inbreeding, PersonId person)
+{
+    const ParentIds& parents = graph.parents(person);
+    bool hasFather = parents[0] != NO_PERSON;
+    bool hasMother = parents[1] != NO_PERSON;
+    if(hasFather and hasMother){
+        return 0.5 - (inbreeding[parents[0]] + inbreeding[parents[1]]) / 4.0;
+    }
+    if(hasFather or hasMother){
+        return 0.75 - inbreeding[parents[hasFather ? 0 : 1]] / 4.0;
+    }
+    return 1.0;
+}
+
+//the key of two persons in the kinship table, the same both ways
+std::uint64_t pairKey(PersonId first, PersonId second)
+{
+    if(first > second){
+        std::swap(first, second);
+    }
+    return (std::uint64_t(first) << 32) | second;
+}
+}
+
+void Kinship::reset()
+{
+    inbreeding_.clear();
+    kinship_.clear();
+}
+
+double Kinship::kinship(const FamilyGraph& graph,
+                        const std::vector<int>& depths,
+                        PersonId first, PersonId second)
+{
+    if(first == second){
+        return (1.0 + inbreeding(graph, depths, first)) / 2.0;
+    }
+    auto known = kinship_.find(pairKey(first, second));
+    if(known != kinship_.end()){
+        return known->second;
+    }
+    inbreeding_.resize(graph.size(), UNKNOWN);
+    first_.trace(graph, depths, first);
+    computeAncestors(graph, depths, first_);
+    second_.trace(graph, depths, second);
+    computeAncestors(graph, depths, second_);
+    double coefficient = cleaned(relationship(graph, first_, second_) / 2.0);
+    kinship_.emplace(pairKey(first, second), coefficient);
+    return coefficient;
+}
+
+double Kinship::inbreeding(const FamilyGraph& graph,
+                           const std::vector<int>& depths, PersonId person)
+{
+    inbreeding_.resize(graph.size(), UNKNOWN);
+    if(inbreeding_.at(person) != UNKNOWN){
+        return inbreeding_.at(person);
+    }
+    first_.trace(graph, depths, person);
+    computeAncestors(graph, depths, first_);
+    return inbreeding_.at(person);
+}
+
+const std::vector<double>& Kinship::computeAll(
+        const FamilyGraph& graph, const std::vector<int>& depths,
+        unsigned threads)
+{
+    inbreeding_.resize(graph.size(), UNKNOWN);
+    //the persons not computed yet, by the generations
+    std::vector<std::vector<PersonId>> generations;
+    for(PersonId person = 0; person < graph.size(); ++person){
+        int depth = depths.at(person);
+        if(depth == INT_MAX or inbreeding_.at(person) != UNKNOWN){
+            continue;
+        }
+        if(generations.size() <= static_cast<std::size_t>(depth)){
+            generations.resize(depth + 1);
+        }
+        generations.at(depth).push_back(person);
+    }
+
+    threads = std::max(1u, threads);
+    std::vector<Tracer> tracers(threads);
+    //the inbreeding of a person; the earlier generations are computed
+    auto compute = [this, &graph, &depths](Tracer& tracer, PersonId person){
+        const ParentIds& parents = graph.parents(person);
+        double coefficient = 0.0;
+        if(parents.at(0) != NO_PERSON and parents.at(1) != NO_PERSON){
+            coefficient = cleaned(
+                        tracer.trace(graph, depths, person, &inbreeding_)
+                        - 1.0);
+        }
+        inbreeding_.at(person) = coefficient;
+    };
+    //the same parents in either order
+    auto parentKey = [&graph](PersonId person){
+        const ParentIds& parents = graph.parents(person);
+        return pairKey(parents.at(0), parents.at(1));
+    };
+    std::vector<PersonId> firstSiblings;
+    /* the persons of a generation only need the earlier generations,
+     * thus the threads can share a generation without locks: each one
+     * writes the coefficients of its own persons only */
+    for(auto& generation:generations){
+        //the full siblings next to each other, the first one computed
+        std::sort(generation.begin(), generation.end(),
+                  [&parentKey](PersonId a, PersonId b){
+            return parentKey(a) < parentKey(b);
+        });
+        firstSiblings.clear();
+        for(std::size_t i = 0; i < generation.size(); ++i){
+            if(i == 0 or parentKey(generation.at(i))
+                    != parentKey(generation.at(i - 1))){
+                firstSiblings.push_back(generation.at(i));
+            }
+        }
+
+        std::size_t used = std::min<std::size_t>(
+                    threads, firstSiblings.size() / MIN_PARALLEL_GENERATION);
+        if(used <= 1){
+            for(PersonId person:firstSiblings){
+                compute(tracers.at(0), person);
+            }
+        }
+        else{
+            std::vector<std::thread> workers;
+            for(std::size_t worker = 0; worker < used; ++worker){
+                workers.emplace_back([&, worker](){
+                    for(std::size_t i = worker; i < firstSiblings.size();
+                        i += used){
+                        compute(tracers.at(worker), firstSiblings.at(i));
+                    }
+                });
+            }
+            for(auto& thread:workers){
+                thread.join();
+            }
+        }
+        //the rest of the full siblings
+        for(std::size_t i = 1; i < generation.size(); ++i){
+            if(inbreeding_.at(generation.at(i)) == UNKNOWN){
+                inbreeding_.at(generation.at(i)) =
+                        inbreeding_.at(generation.at(i - 1));
+            }
+        }
+    }
+    //the persons on a cycle stay UNKNOWN
+    return inbreeding_;
+}
+
+double Kinship::Tracer::trace(const FamilyGraph& graph,
+                              const std::vector<int>& depths,
+                              PersonId person,
+                              const std::vector<double>* inbreeding)
+{
+    //forget the last trace
+    for(PersonId id:reached_){
+        share_[id] = 0.0;
+    }
+    reached_.clear();
+    share_.resize(graph.size(), 0.0);
+    marks_.start(graph.size());
+
+    int depth = depths.at(person);
+    if(generations_.size() <= static_cast<std::size_t>(depth)){
+        generations_.resize(depth + 1);
+    }
+    double relationship = 0.0;
+    share_[person] = 1.0;
+    marks_.mark(person);
+    reached_.push_back(person);
+    generations_.at(depth).push_back(person);
+    //a parent is always in an older generation than the child
+    for(; depth >= 0; --depth){
+        std::vector<PersonId>& generation = generations_.at(depth);
+        for(PersonId eachPerson:generation){
+            /* all the lines from the person have reached this ancestor,
+             * since the persons on them are younger: the share is final,
+             * pass half of it up */
+            double share = share_[eachPerson];
+            if(inbreeding != nullptr){
+                relationship += share * share
+                        * ownShare(graph, *inbreeding, eachPerson);
+            }
+            for(PersonId parent:graph.parents(eachPerson)){
+                if(parent == NO_PERSON){
+                    continue;
+                }
+                if(marks_.mark(parent)){
+                    reached_.push_back(parent);
+                    generations_[depths[parent]].push_back(parent);
+                }
+                share_[parent] += share / 2.0;
+            }
+        }
+        generation.clear();
+    }
+    return relationship;
+}
+
+double Kinship::relationship(const FamilyGraph& graph, const Tracer& first,
+                             const Tracer& second) const
+{
+    //the common ones are among the fewer reached
+    const Tracer& fewer = first.reached().size() <= second.reached().size()
+            ? first : second;
+    const Tracer& other = &fewer == &first ? second : first;
+    double sum = 0.0;
+    for(PersonId ancestor:fewer.reached()){
+        double otherShare = other.share(ancestor);
+        if(otherShare != 0.0){
+            sum += fewer.share(ancestor) * otherShare
+                    * ownShare(graph, inbreeding_, ancestor);
+        }
+    }
+    return sum;
+}
+
+void Kinship::computeAncestors(const FamilyGraph& graph,
+                               const std::vector<int>& depths,
+                               const Tracer& tracer)
+{
+    std::vector<PersonId> unknown;
+    for(PersonId ancestor:tracer.reached()){
+        if(inbreeding_.at(ancestor) == UNKNOWN){
+            unknown.push_back(ancestor);
+        }
+    }
+    //the oldest first: the ancestors of an ancestor are known before her/him
+    std::sort(unknown.begin(), unknown.end(),
+              [&depths](PersonId a, PersonId b){
+        return depths.at(a) < depths.at(b);
+    });
+    for(PersonId ancestor:unknown){
+        const ParentIds& parents = graph.parents(ancestor);
+        double coefficient = 0.0;
+        if(parents.at(0) != NO_PERSON and parents.at(1) != NO_PERSON){
+            coefficient = cleaned(
+                        work_.trace(graph, depths, ancestor, &inbreeding_)
+                        - 1.0);
+        }
+        inbreeding_.at(ancestor) = coefficient;
+    }
+}
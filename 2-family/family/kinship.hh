@@ -0,0 +1,160 @@
+//Description:
+/* This file defines the class Kinship, which computes the kinship
+ * coefficients of two persons and the inbreeding coefficients of the
+ * persons of a FamilyGraph.
+ *   The kinship coefficient of A and B is the probability that a gene
+ * taken at random from A and one from B are identical by descent; the
+ * inbreeding coefficient of a person is the kinship of her/his parents.
+ *   Both come from the relationship of two persons,
+ *     a(A, B) = sum over the common ancestors K (and A, B themselves) of
+ *               l(A, K) * l(B, K) * d(K),
+ * where l(A, K) is the share of K's genes in A (1 for A, and each step up
+ * halves it, summed over all the lines from A to K), and d(K) the share
+ * of K's genes not from her/his parents:
+ *     1 for no known parents, 3/4 - F(P)/4 for one known parent P,
+ *     1/2 - (F(father) + F(mother))/4 for two.
+ * Then kinship(A, B) = a(A, B) / 2 and F(A) = a(A, A) - 1 (the method of
+ * Meuwissen and Luo). The shares of a person are found by going up her/his
+ * ancestors in the generation order, the youngest first, so that all
+ * the lines to an ancestor are summed before going past her/him; this
+ * costs the number of ancestors, however many lines lead to them.
+ * Full siblings have the same inbreeding, which is computed only once.
+ *   d(K) needs the inbreeding of K's parents, thus the coefficients are
+ * computed generation by generation and memoized; all the persons of one
+ * generation can be computed at the same time, on several threads. The
+ * kinship coefficients asked are memoized in a sparse table.
+ *   The generations come from the ancestor depths (the longest line of
+ * ancestors above a person); a person on a cycle must not be asked.
+ *
+ * File author
+ * Name: Ruowen Liu
+ * Student number: -
+ * UserID: -
+ * E-Mail: ruowen.liu@tuni.fi
+ * */
+
+#ifndef KINSHIP_HH
+#define KINSHIP_HH
+
+#include "familygraph.hh"
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+class Kinship
+{
+public:
+    /**
+     * @brief reset
+     * Forget the memoized coefficients, when the graph has changed.
+     */
+    void reset();
+
+    /**
+     * @brief kinship
+     * @param graph (frozen)
+     * @param depths are the ancestor depths of the persons
+     * @param first
+     * @param second
+     * @return the kinship coefficient of the persons
+     */
+    double kinship(const FamilyGraph& graph, const std::vector<int>& depths,
+                   PersonId first, PersonId second);
+
+    /**
+     * @brief inbreeding
+     * @param graph (frozen)
+     * @param depths are the ancestor depths of the persons
+     * @param person
+     * @return the inbreeding coefficient of the person
+     */
+    double inbreeding(const FamilyGraph& graph,
+                      const std::vector<int>& depths, PersonId person);
+
+    /**
+     * @brief computeAll
+     * @param graph (frozen)
+     * @param depths are the ancestor depths of the persons
+     * @param threads is the number of threads to use
+     * @return the inbreeding coefficients of all the persons, by the ids
+     *         (-1 for a person on a cycle)
+     * Compute the inbreeding coefficients of everybody, one generation at
+     * a time, the persons of a generation shared by the threads.
+     */
+    const std::vector<double>& computeAll(const FamilyGraph& graph,
+                                          const std::vector<int>& depths,
+                                          unsigned threads);
+
+private:
+    /**
+     * @brief The Tracer class - the shares of the ancestors in one person
+     */
+    class Tracer
+    {
+    public:
+        /**
+         * @brief trace
+         * @param graph
+         * @param depths
+         * @param person
+         * @param inbreeding are the inbreeding coefficients, or nullptr
+         * @return a(person, person) if the inbreeding coefficients are
+         *         given (those of the ancestors must be known), else 0
+         * Find the shares l(person, K) of the person and her/his
+         * ancestors K.
+         */
+        double trace(const FamilyGraph& graph, const std::vector<int>& depths,
+                     PersonId person,
+                     const std::vector<double>* inbreeding = nullptr);
+
+        //the person and the ancestors of the last trace
+        const std::vector<PersonId>& reached() const { return reached_; }
+        //the share of an ancestor; 0 if not reached
+        double share(PersonId id) const
+        {
+            return id < share_.size() ? share_[id] : 0.0;
+        }
+
+    private:
+        //by the ids, 0 for the ones not reached
+        std::vector<double> share_;
+        std::vector<PersonId> reached_;
+        VisitMarks marks_;
+        //the ancestors to go up from, by their ancestor depths
+        std::vector<std::vector<PersonId>> generations_;
+    };
+
+    //the inbreeding coefficients by the ids, UNKNOWN if not computed yet
+    std::vector<double> inbreeding_;
+    std::unordered_map<std::uint64_t, double> kinship_;
+    Tracer first_;
+    Tracer second_;
+    //for computing the inbreeding of the ancestors
+    Tracer work_;
+
+    /**
+     * @brief relationship
+     * @param graph
+     * @param first is traced already
+     * @param second is traced already
+     * @return a(first, second); the inbreeding coefficients of all the
+     *         persons reached must be known
+     */
+    double relationship(const FamilyGraph& graph, const Tracer& first,
+                        const Tracer& second) const;
+
+    /**
+     * @brief computeAncestors
+     * @param graph
+     * @param depths
+     * @param tracer has traced the person
+     * Compute the unknown inbreeding coefficients of the traced person and
+     * her/his ancestors, the oldest generation first.
+     */
+    void computeAncestors(const FamilyGraph& graph,
+                          const std::vector<int>& depths,
+                          const Tracer& tracer);
+};
+
+#endif // KINSHIP_HH
@@ -15,107 +15,67 @@
 #############################################################################
 */
 #include "familytree.hh"
+#include "familyloader.hh"
+#include "snapshot.hh"
 #include "cli.hh"
-#include "utils.hh"
 
+#include <algorithm>
 #include <iostream>
 #include <vector>
 #include <fstream>
+#include <sstream>
 #include <string>
 
-// Constants to make CSV-parsing more readable.
-const char CSV_DELIMITER = ';';
-enum CsvFields { CSV_NAME, CSV_HEIGHT, CSV_FATHER, CSV_MOTHER, CSV_VALUES };
-
-// Struct for parent-child relations.
-struct Relation
-{
-    std::string child_;
-    std::vector<std::string> parents_;
-};
-
 /**
- * @brief parsePerson
- * @param line: string to be parsed
- * @param relations
- * @return Person struct that was created, in erroneuos input the fields id_
- *         and height_ keep their initial values (NO_NAME and NO_HEIGTH)
- * Parse the given line to a new person and child-parent relationship.
+ * @brief populateDatabase
+ * @param filename
+ * @param datafile
+ * @param database
+ * @return true iff there were no errors in the datafile
+ * Read the datafile and populate database with its content. The lines are
+ * parsed and the relations linked on all the cores by FamilyLoader.
  */
-Person parsePerson(const std::string& line, std::vector<Relation> &relations)
+bool populateDatabase(const std::string& filename, std::ifstream& datafile,
+                      std::shared_ptr<Familytree> database)
 {
-    Person new_person;
-    Relation new_relation;
-    std::vector<std::string> parsed_data = Utils::split(line, CSV_DELIMITER);
+    FamilyLoader loader;
 
-    // Check that there was correct amount of fields in the line.
-    if( parsed_data.size() == CSV_VALUES )
+    // A regular file is mapped privately, and parsed right in its pages.
+    MappedFile mapped;
+    if( mapped.open(filename, MappedFile::PRIVATE) )
     {
-        new_person.id_ = parsed_data[CSV_NAME];
-
-        if( Utils::isNumeric(parsed_data[CSV_HEIGHT]) )
-        {
-            new_person.height_ = std::stoi(parsed_data[CSV_HEIGHT]);
-        }
-        else
-        {
-            std::cout << "Invalid argument." << std::endl;
-        }
-
-        new_relation.child_ = parsed_data[CSV_NAME];
-        new_relation.parents_.push_back(parsed_data[CSV_FATHER]);
-        new_relation.parents_.push_back(parsed_data[CSV_MOTHER]);
-        relations.push_back(new_relation);
+        return loader.load(mapped.privateData(), mapped.size(), *database,
+                           std::cout);
     }
 
-    return new_person;
+    // Not a regular file, e.g. a pipe, or an empty file.
+    datafile.clear();
+    std::ostringstream buffer;
+    buffer << datafile.rdbuf();
+    std::string data = buffer.str();
+    return loader.load(&data[0], data.size(), *database, std::cout);
 }
 
 /**
- * @brief populateDatabase
+ * @brief isSnapshot
  * @param datafile
- * @param database
- * @return true iff there were no errors in the datafile
- * Read the datafile and populate database with its content
+ * @return true iff the file starts like a snapshot file
  */
-bool populateDatabase(std::ifstream& datafile,
-                      std::shared_ptr<Familytree> database)
+bool isSnapshot(std::ifstream& datafile)
 {
-    std::string line = "";
-    std::vector<std::string> parsed_line;
-    std::vector<Relation> relations;
-    int line_number = 0;
-
-    while( std::getline(datafile, line) )
-    {
-        // Linenumbering for error-printing.
-        ++line_number;
-
-        // Skip empty and commented lines.
-        if( line.empty() or line[0] == '#' )
-        {
-            continue;
-        }
-
-        // Parse the line to a new person and relation.
-        Person new_person = parsePerson(line, relations);
-        if( new_person.id_ == NO_ID or new_person.height_ == NO_HEIGHT )
-        {
-            std::cout << "Error in datafile, line " << line_number
-                      << std::endl;
-            return false;
-        }
-
-        // Add the new person to the database.
-        database->addNewPerson(new_person.id_, new_person.height_, std::cout);
-    }
-
-    // After the persons have been created, add the child-parent relations.
-    for( auto iter = relations.begin(); iter != relations.end(); ++iter )
+    // Only a regular file can be mapped, and rewound after the check.
+    if( datafile.tellg() < 0 )
     {
-        database->addRelation(iter->child_, iter->parents_, std::cout);
+        datafile.clear();
+        return false;
     }
-    return true;
+    char magic[sizeof(SNAPSHOT_MAGIC)] = {};
+    datafile.read(magic, sizeof(magic));
+    bool isSnapshot = datafile.gcount() == sizeof(magic)
+            and std::equal(magic, magic + sizeof(magic), SNAPSHOT_MAGIC);
+    datafile.clear();
+    datafile.seekg(0, std::ios::beg);
+    return isSnapshot;
 }
 
 /**
@@ -139,7 +99,15 @@ int main()
         return EXIT_FAILURE;
     }
 
-    if( not populateDatabase(datafile, database) )
+    // A snapshot saved by SAVE is mapped and queried as is.
+    if( isSnapshot(datafile) )
+    {
+        if( not database->loadSnapshot(cmd_string, std::cout) )
+        {
+            return EXIT_FAILURE;
+        }
+    }
+    else if( not populateDatabase(cmd_string, datafile, database) )
     {
         return EXIT_FAILURE;
     }
@@ -0,0 +1,163 @@
+//Description:
+/* This file is a benchmark of the queries of class Familytree on
+ * a synthetic collapsed pedigree: many generations of a small population,
+ * where everybody's parents are chosen from the generation before. Every
+ * founder is the ancestor of everybody a few generations later along
+ * a huge number of lines, as happens in real genealogies when cousins
+ * marry.
+ *   Usage: pedigreebench [generations] [persons per generation] [datafile]
+ * The defaults are 40 generations of 64 persons. The pedigree is written
+ * as datafile text and loaded by FamilyLoader like main.cpp does: the
+ * lines are parsed, the names resolved to ids and the graph built in
+ * phases shared by all the cores (see familyloader.hh). Then every query
+ * is timed, from a person of the youngest generation for the ancestors and
+ * from a founder with children for the descendants. If a datafile is
+ * given, the pedigree is also written there, so that another build of the
+ * family program can be run on the same data.
+ *
+ * File author
+ * Name: Ruowen Liu
+ * Student number: -
+ * UserID: -
+ * E-Mail: ruowen.liu@tuni.fi
+ * */
+
+#include "familytree.hh"
+#include "familyloader.hh"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+using Clock = std::chrono::steady_clock;
+using Query = void (Familytree::*)(Params, std::ostream&) const;
+
+std::string personName(int generation, int person)
+{
+    return "G" + std::to_string(generation) + "P" + std::to_string(person);
+}
+
+/**
+ * @brief timeQuery
+ * @param tree
+ * @param label
+ * @param query
+ * @param params
+ * Run the query once and print the time and the size of its output.
+ */
+void timeQuery(const Familytree& tree, const std::string& label,
+               Query query, const std::vector<std::string>& params)
+{
+    std::ostringstream result;
+    Clock::time_point start = Clock::now();
+    (tree.*query)(params, result);
+    double millis = std::chrono::duration<double, std::milli>(
+                Clock::now() - start).count();
+    std::string text = result.str();
+    std::size_t lines = static_cast<std::size_t>(
+                std::count(text.begin(), text.end(), '\n'));
+    std::cout << std::left << std::setw(24) << label << std::right
+              << std::setw(12) << std::fixed << std::setprecision(3)
+              << millis << " ms" << std::setw(10) << lines << " lines"
+              << std::endl;
+}
+}
+
+int main(int argc, char* argv[])
+{
+    int generations = argc > 1 ? std::atoi(argv[1]) : 40;
+    int width = argc > 2 ? std::atoi(argv[2]) : 64;
+    if(argc > 4 or generations < 3 or width < 2){
+        std::cerr << "Usage: " << argv[0]
+                  << " [generations >= 3] [persons per generation >= 2]"
+                  << " [datafile]" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    //the same pedigree on every run
+    std::mt19937 random(2024);
+    std::uniform_int_distribution<int> pick(0, width - 1);
+    std::uniform_int_distribution<int> height(150, 199);
+    std::ostringstream data;
+    Familytree tree;
+    //a founder with children, the father of the first in generation 1
+    std::string founder = "";
+    for(int generation = 0; generation < generations; ++generation){
+        for(int person = 0; person < width; ++person){
+            std::string father = "-";
+            std::string mother = "-";
+            if(generation > 0){
+                int fatherIndex = pick(random);
+                int motherIndex = pick(random);
+                while(motherIndex == fatherIndex){
+                    motherIndex = pick(random);
+                }
+                father = personName(generation - 1, fatherIndex);
+                mother = personName(generation - 1, motherIndex);
+                if(founder.empty()){
+                    founder = father;
+                }
+            }
+            std::string name = personName(generation, person);
+            int personHeight = height(random);
+            data << name << ";" << personHeight << ";" << father << ";"
+                 << mother << "\n";
+        }
+    }
+    //the loader may unquote the text in place
+    std::string text = data.str();
+    FamilyLoader loader;
+    if(!loader.load(&text[0], text.size(), tree, std::cout)){
+        return EXIT_FAILURE;
+    }
+    std::cout << generations << " generations x " << width << " persons"
+              << std::endl;
+
+    if(argc > 3){
+        std::ofstream datafile(argv[3]);
+        datafile << data.str();
+        if(!datafile){
+            std::cerr << "Error: could not write " << argv[3] << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    std::string youngest = personName(generations - 1, 0);
+    std::string all = std::to_string(generations - 2);
+    std::string half = std::to_string(generations / 2);
+    //the first query also builds the graph for the queries
+    timeQuery(tree, "PARENTS (first query)", &Familytree::printParents,
+              {youngest});
+    timeQuery(tree, "SIBLINGS", &Familytree::printSiblings, {youngest});
+    timeQuery(tree, "COUSINS", &Familytree::printCousins, {youngest});
+    timeQuery(tree, "GRANDPARENTS " + half, &Familytree::printGrandParentsN,
+              {youngest, half});
+    timeQuery(tree, "GRANDPARENTS " + all, &Familytree::printGrandParentsN,
+              {youngest, all});
+    timeQuery(tree, "GRANDCHILDREN " + half,
+              &Familytree::printGrandChildrenN, {founder, half});
+    timeQuery(tree, "GRANDCHILDREN " + all, &Familytree::printGrandChildrenN,
+              {founder, all});
+    timeQuery(tree, "TALLEST", &Familytree::printTallestInLineage,
+              {founder});
+    timeQuery(tree, "SHORTEST", &Familytree::printShortestInLineage,
+              {founder});
+    //the lineage heights are memoized by the first ones
+    timeQuery(tree, "TALLEST (again)", &Familytree::printTallestInLineage,
+              {founder});
+    timeQuery(tree, "TALLEST " + youngest, &Familytree::printTallestInLineage,
+              {youngest});
+    std::string cousin = personName(generations - 1, 1);
+    timeQuery(tree, "KINSHIP", &Familytree::printKinship, {youngest, cousin});
+    timeQuery(tree, "INBREEDING", &Familytree::printInbreeding, {});
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,20 @@
+TEMPLATE = app
+CONFIG += console c++17 thread
+CONFIG -= app_bundle
+CONFIG -= qt
+
+SOURCES += pedigreebench.cpp \
+    familytree.cpp \
+    familygraph.cpp \
+    familyloader.cpp \
+    kinship.cpp \
+    snapshot.cpp \
+    utils.cpp
+
+HEADERS += \
+    familytree.hh \
+    familygraph.hh \
+    familyloader.hh \
+    kinship.hh \
+    snapshot.hh \
+    utils.hh
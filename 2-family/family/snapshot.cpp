@@ -0,0 +1,118 @@
+//Description:
+/* This file implements the functions for the snapshot file and for
+ * class MappedFile.
+ *
+ * File author
+ * Name: Ruowen Liu
+ * Student number: -
+ * UserID: -
+ * E-Mail: ruowen.liu@tuni.fi
+ * */
+
+#include "snapshot.hh"
+
+#include <cstring>
+#include <fstream>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define SNAPSHOT_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+const std::uint64_t PRIME1 = 0x9E3779B185EBCA87ULL;
+const std::uint64_t PRIME2 = 0xC2B2AE3D27D4EB4FULL;
+
+std::uint64_t rotate(std::uint64_t value, int bits)
+{
+    return (value << bits) | (value >> (64 - bits));
+}
+
+std::uint64_t word(const char* data)
+{
+    std::uint64_t value = 0;
+    std::memcpy(&value, data, sizeof(value));
+    return value;
+}
+}
+
+std::uint64_t snapshotChecksum(const char* data, std::size_t size)
+{
+    //the lanes do not depend on each other, thus they run side by side
+    std::uint64_t lanes[4] = {PRIME1, PRIME2, ~PRIME1, ~PRIME2};
+    std::size_t i = 0;
+    for(; i + 32 <= size; i += 32){
+        for(int lane = 0; lane < 4; ++lane){
+            lanes[lane] = rotate(lanes[lane] + word(data + i + 8 * lane)
+                                 * PRIME2, 31) * PRIME1;
+        }
+    }
+    std::uint64_t checksum = rotate(lanes[0], 1) + rotate(lanes[1], 7)
+            + rotate(lanes[2], 12) + rotate(lanes[3], 18);
+    for(; i < size; ++i){
+        checksum = rotate(checksum ^ static_cast<unsigned char>(data[i]), 11)
+                * PRIME1;
+    }
+    checksum ^= size;
+    checksum ^= checksum >> 33;
+    checksum *= PRIME2;
+    checksum ^= checksum >> 29;
+    return checksum;
+}
+
+MappedFile::~MappedFile()
+{
+#ifdef SNAPSHOT_MMAP
+    if(isMapped_){
+        munmap(data_, size_);
+    }
+#endif
+}
+
+bool MappedFile::open(const std::string& path, Mode mode)
+{
+    mode_ = mode;
+#ifdef SNAPSHOT_MMAP
+    int file = ::open(path.c_str(), O_RDONLY);
+    if(file < 0){
+        return false;
+    }
+    struct stat status;
+    if(fstat(file, &status) != 0 or status.st_size <= 0){
+        ::close(file);
+        return false;
+    }
+    size_ = static_cast<std::size_t>(status.st_size);
+    //shared: the processes mapping the same file use the same pages
+    void* mapping = mode == SHARED
+            ? mmap(nullptr, size_, PROT_READ, MAP_SHARED, file, 0)
+            : mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+                   file, 0);
+    ::close(file);
+    if(mapping == MAP_FAILED){
+        size_ = 0;
+        return false;
+    }
+    data_ = static_cast<char*>(mapping);
+    isMapped_ = true;
+    return true;
+#else
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if(!file){
+        return false;
+    }
+    size_ = static_cast<std::size_t>(file.tellg());
+    //the words keep the sections aligned
+    buffer_.resize((size_ + sizeof(std::uint64_t) - 1)
+                   / sizeof(std::uint64_t));
+    file.seekg(0);
+    file.read(reinterpret_cast<char*>(buffer_.data()),
+              static_cast<std::streamsize>(size_));
+    data_ = reinterpret_cast<char*>(buffer_.data());
+    return static_cast<bool>(file);
+#endif
+}
@@ -0,0 +1,125 @@
+//Description:
+/* This file defines the binary snapshot file of a FamilyGraph, and the
+ * class MappedFile for reading it.
+ *   A snapshot holds the arrays of a frozen graph as they are in memory,
+ * so that a graph can be queried right in the mapped file, without
+ * parsing or copying anything; several processes mapping the same file
+ * share its pages. The file is:
+ *   SnapshotHeader (SNAPSHOT_HEADER_SIZE bytes)
+ *   the sections, each starting at a multiple of SNAPSHOT_ALIGNMENT:
+ *     NAME_BEGIN  - uint64 x (persons + 1), the offsets of the names
+ *     HEIGHTS     - int32 x persons
+ *     PARENTS     - uint32 x 2 x persons (father, mother)
+ *     CHILD_BEGIN - uint32 x (persons + 1), the children CSR offsets
+ *     CHILDREN    - uint32 x children
+ *     BY_NAME     - uint32 x persons, the ids in the alphabetical order
+ *     RANKS       - uint32 x persons
+ *     NAME_CHARS  - the characters of all the names
+ * The numbers are in the byte order of the machine that wrote the file;
+ * another byte order, another version, a wrong size or a wrong checksum
+ * makes the file rejected.
+ *
+ * File author
+ * Name: Ruowen Liu
+ * Student number: -
+ * UserID: -
+ * E-Mail: ruowen.liu@tuni.fi
+ * */
+
+#ifndef SNAPSHOT_HH
+#define SNAPSHOT_HH
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/* The first byte is not text (0x89 cannot start a UTF-8 character),
+ * thus no datafile starts like a snapshot; the line ends and the ^Z show
+ * a file damaged by a text mode transfer, as in the PNG signature */
+const char SNAPSHOT_MAGIC[8] = {'\x89', 'F', 'A', 'M', '\r', '\n', '\x1a',
+                                '\n'};
+const std::uint32_t SNAPSHOT_VERSION = 1;
+//written as is; read back in another byte order, it is 0x04030201
+const std::uint32_t SNAPSHOT_BYTE_ORDER = 0x01020304;
+const std::size_t SNAPSHOT_ALIGNMENT = 64;
+
+//a relation was given again for a child who had parents (see Familytree)
+const std::uint32_t SNAPSHOT_RELATION_REPLACED = 1;
+
+enum SnapshotSection
+{
+    NAME_BEGIN, HEIGHTS, PARENTS, CHILD_BEGIN, CHILDREN, BY_NAME, RANKS,
+    NAME_CHARS, SNAPSHOT_SECTIONS
+};
+
+struct SnapshotHeader
+{
+    char magic_[8];
+    std::uint32_t version_;
+    std::uint32_t byteOrder_;
+    std::uint64_t persons_;
+    std::uint64_t children_;
+    std::uint64_t nameBytes_;
+    std::uint32_t flags_;
+    std::uint32_t reserved_;
+    //the place and the size of every section, in bytes
+    std::uint64_t offsets_[SNAPSHOT_SECTIONS];
+    std::uint64_t sizes_[SNAPSHOT_SECTIONS];
+    //snapshotChecksum of all the bytes after the header
+    std::uint64_t payloadChecksum_;
+    //snapshotChecksum of the header before this field
+    std::uint64_t headerChecksum_;
+};
+
+const std::size_t SNAPSHOT_HEADER_SIZE = sizeof(SnapshotHeader);
+
+/**
+ * @brief snapshotChecksum
+ * @param data
+ * @param size
+ * @return a 64-bit checksum of the bytes, 8 bytes at a time in four
+ *         independent lanes
+ */
+std::uint64_t snapshotChecksum(const char* data, std::size_t size);
+
+/**
+ * @brief The MappedFile class - a whole file mapped into memory, shared
+ *        or private (read into a buffer where mapping is not available)
+ */
+class MappedFile
+{
+public:
+    //SHARED: read-only, the pages shared with the other processes;
+    //PRIVATE: writable, a page written is copied, the file never changes
+    enum Mode { SHARED, PRIVATE };
+
+    MappedFile() = default;
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    /**
+     * @brief open
+     * @param path
+     * @param mode
+     * @return true if the file could be opened and mapped (an empty file
+     *         cannot be)
+     */
+    bool open(const std::string& path, Mode mode = SHARED);
+
+    const char* data() const { return data_; }
+    //the bytes to change in a PRIVATE file, nullptr in a SHARED one
+    char* privateData() { return mode_ == PRIVATE ? data_ : nullptr; }
+    std::size_t size() const { return size_; }
+
+private:
+    char* data_ = nullptr;
+    Mode mode_ = SHARED;
+    std::size_t size_ = 0;
+    bool isMapped_ = false;
+    //the contents, if not mapped
+    std::vector<std::uint64_t> buffer_;
+};
+
+#endif // SNAPSHOT_HH